@@ -0,0 +1,154 @@
+/**
+ *@file ArtifactStore.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Append-only artifact storage in memory mapped segment files
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef ARTIFACT_STORE_HPP
+#define ARTIFACT_STORE_HPP
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class ArtifactType : uint8_t {
+    Screenshot = 1,
+    PageSource = 2,
+    Pdf = 3,
+    Other = 255
+};
+
+struct ArtifactRecord {
+    std::string sessionId;
+    std::string url;
+    int64_t timestampMs{0};
+    ArtifactType type{ArtifactType::Other};
+    bool compressed{false};
+    uint32_t segment{0};
+    uint64_t offset{0};
+    /**
+     * @brief Bytes stored in the segment, compressed when compressed is set
+     */
+    uint64_t length{0};
+    uint64_t originalLength{0};
+};
+
+struct ArtifactStoreOptions {
+    /**
+     * @brief Size each segment file is preallocated to, larger artifacts get a
+     * segment of their own
+     */
+    size_t segmentSize{256 * 1024 * 1024};
+    bool compress{false};
+    /**
+     * @brief Artifacts smaller than this are stored uncompressed
+     */
+    size_t compressMinSize{4096};
+    int compressionLevel{6};
+};
+
+namespace artifact_detail {
+struct MappedSegment;
+}
+
+/**
+ * @brief Read only view of an artifact directory, the stored bytes are
+ * returned straight from the mapped segments
+ */
+class ArtifactReader {
+  public:
+    explicit ArtifactReader(std::filesystem::path directory);
+    ~ArtifactReader();
+
+    ArtifactReader(const ArtifactReader &) = delete;
+    auto operator=(const ArtifactReader &) -> ArtifactReader & = delete;
+
+    /**
+     * @brief Load the records appended to the index since the last call
+     * @return Number of new records
+     */
+    auto refresh() -> size_t;
+
+    auto records() const -> const std::vector<ArtifactRecord> & {
+        return index;
+    }
+
+    /**
+     * @brief Stored bytes, compressed when record.compressed is set. Valid
+     * while the reader is alive
+     */
+    auto view(const ArtifactRecord &record) -> std::string_view;
+
+    /**
+     * @brief Original bytes of the artifact, decompressed when needed
+     */
+    auto read(const ArtifactRecord &record) -> std::string;
+
+  private:
+    std::filesystem::path directory;
+    std::vector<ArtifactRecord> index;
+    uint64_t indexOffset{0};
+    std::vector<std::unique_ptr<artifact_detail::MappedSegment>> segments;
+    /**
+     * @brief Mappings replaced by a remap, kept so the views handed out from
+     * them stay valid
+     */
+    std::vector<std::unique_ptr<artifact_detail::MappedSegment>> retired;
+};
+
+/**
+ * @brief Writes artifacts back to back in large preallocated segment files and
+ * records them in an append-only index, instead of one file per artifact.
+ * The index is little endian, so a store can be read on any host. Thread safe
+ */
+class ArtifactStore {
+  public:
+    explicit ArtifactStore(std::filesystem::path directory,
+                           ArtifactStoreOptions options = {});
+    ~ArtifactStore();
+
+    ArtifactStore(const ArtifactStore &) = delete;
+    auto operator=(const ArtifactStore &) -> ArtifactStore & = delete;
+
+    auto append(const std::string &sessionId, const std::string &url,
+                ArtifactType type, std::string_view data) -> ArtifactRecord;
+
+    /**
+     * @brief Decode a base64 WebDriver response (screenshots, PDFs) and append
+     * the bytes
+     */
+    auto appendBase64(const std::string &sessionId, const std::string &url,
+                      ArtifactType type, const std::string &base64)
+        -> ArtifactRecord;
+
+    auto records() const -> std::vector<ArtifactRecord>;
+
+    auto view(const ArtifactRecord &record) const -> std::string_view;
+    auto read(const ArtifactRecord &record) const -> std::string;
+
+    /**
+     * @brief msync the segments and fsync the index
+     */
+    void flush();
+
+  private:
+    auto reserve(uint64_t length, uint32_t &segment) -> uint64_t;
+    void writeIndex(const ArtifactRecord &record);
+
+    std::filesystem::path directory;
+    ArtifactStoreOptions options;
+
+    mutable std::mutex mtx;
+    std::vector<ArtifactRecord> index;
+    std::vector<std::unique_ptr<artifact_detail::MappedSegment>> segments;
+    uint64_t segmentUsed{0};
+    int indexFd{-1};
+};
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ *@file Base64Sink.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Response sinks decoding a base64 string of a JSON response
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef BASE64_SINK_HPP
+#define BASE64_SINK_HPP
+#include "Transport.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Decodes the base64 string under key in a JSON response as it
+ * arrives, e.g. the PDF of the print command or the zip of a file download.
+ * The decoded bytes are passed on in pieces and never held whole, the rest
+ * of the JSON is kept to report errors
+ */
+class Base64ResponseSink : public ResponseSink {
+  public:
+    /**
+     * @param[in] key Name of the string, the first one found at any depth
+     */
+    explicit Base64ResponseSink(std::string key);
+
+    void write(const char *data, size_t len) final;
+
+    /**
+     * @brief Response JSON with an empty string under key
+     */
+    auto envelope() const -> const std::string & { return json; }
+
+    /**
+     * @brief The whole string arrived
+     */
+    auto complete() const -> bool { return jsonState == JsonState::Done; }
+
+  protected:
+    /**
+     * @brief Next decoded bytes, throwing aborts the transfer
+     */
+    virtual void decoded(const char *data, size_t len) = 0;
+
+  private:
+    enum class JsonState { Outside, InString, Contents, Done };
+
+    void decodeBase64(const char *data, size_t len);
+    void flushDecoded(bool last);
+
+    std::string key;
+    std::string json;
+    JsonState jsonState{JsonState::Outside};
+    bool escaped{false};
+    std::string lastString;
+    /**
+     * @brief Progress through "key" : " after the key, 0 when not in it
+     */
+    int keyProgress{0};
+
+    uint32_t quad{0};
+    int quadLength{0};
+    std::string buffer;
+};
+
+/**
+ * @brief Writes the decoded string to a stream
+ */
+class Base64StreamSink : public Base64ResponseSink {
+  public:
+    explicit Base64StreamSink(std::ostream &out, std::string key = "value");
+
+    /**
+     * @brief Flush out, throws std::runtime_error when the string did not
+     * arrive whole
+     */
+    void finish();
+
+    auto bytesWritten() const -> uint64_t { return written; }
+
+  protected:
+    void decoded(const char *data, size_t len) override;
+
+  private:
+    std::ostream &out;
+    uint64_t written{0};
+};
+
+#endif
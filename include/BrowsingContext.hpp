@@ -0,0 +1,150 @@
+/**
+ *@file BrowsingContext.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Client side tracking of the window and frame a session targets
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef BROWSING_CONTEXT_HPP
+#define BROWSING_CONTEXT_HPP
+#include <Poco/Dynamic/Var.h>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Window handle and frame path the session commands currently go to,
+ * as far as the client knows. Anything not confirmed by a successful command
+ * is unknown, so a switch is only skipped when it certainly changes nothing.
+ * Safe to share between the threads sending commands for the same session
+ */
+class BrowsingContext {
+  public:
+    using frame_path_t = std::vector<Poco::Dynamic::Var>;
+
+    BrowsingContext() = default;
+
+    BrowsingContext(const BrowsingContext &other) {
+        std::lock_guard<std::mutex> lck(other.mtx);
+        handle = other.handle;
+        frames = other.frames;
+    }
+
+    auto operator=(const BrowsingContext &other) -> BrowsingContext & {
+        if (this != &other) {
+            std::scoped_lock lck(mtx, other.mtx);
+            handle = other.handle;
+            frames = other.frames;
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief Comparable key of a frame id: null, an index or an element
+     * reference
+     */
+    static auto frameKey(const Poco::Dynamic::Var &frameId) -> std::string {
+        if (frameId.isEmpty()) {
+            return "null";
+        }
+
+        return (frameId.isString() ? "s:" : "") + frameId.toString();
+    }
+
+    auto windowHandle() const -> std::optional<std::string> {
+        std::lock_guard<std::mutex> lck(mtx);
+        return handle;
+    }
+
+    /**
+     * @brief Frames entered from the top level document, nullopt when unknown
+     */
+    auto framePath() const -> std::optional<frame_path_t> {
+        std::lock_guard<std::mutex> lck(mtx);
+        return frames;
+    }
+
+    auto atTopLevel() const -> bool {
+        std::lock_guard<std::mutex> lck(mtx);
+        return frames && frames->empty();
+    }
+
+    /**
+     * @brief A new session starts in the top level document of a window not
+     * queried yet
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lck(mtx);
+        handle.reset();
+        frames.emplace();
+    }
+
+    /**
+     * @brief Switching to a window also selects its top level document
+     */
+    void enteredWindow(const std::string &windowHandle) {
+        std::lock_guard<std::mutex> lck(mtx);
+        handle = windowHandle;
+        frames.emplace();
+    }
+
+    /**
+     * @brief The current window was queried, the frames are unchanged
+     */
+    void learnedWindow(const std::string &windowHandle) {
+        std::lock_guard<std::mutex> lck(mtx);
+        handle = windowHandle;
+    }
+
+    /**
+     * @brief Switched to frameId from the current document, null selects the
+     * top level document
+     */
+    void enteredFrame(const Poco::Dynamic::Var &frameId) {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (frameId.isEmpty()) {
+            frames.emplace();
+        } else if (frames) {
+            frames->push_back(frameId);
+        }
+    }
+
+    void leftFrame() {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (frames && !frames->empty()) {
+            frames->pop_back();
+        }
+    }
+
+    /**
+     * @brief Navigation and refresh select the top level document
+     */
+    void resetToTopLevel() {
+        std::lock_guard<std::mutex> lck(mtx);
+        frames.emplace();
+    }
+
+    void forgetFrames() {
+        std::lock_guard<std::mutex> lck(mtx);
+        frames.reset();
+    }
+
+    void forget() {
+        std::lock_guard<std::mutex> lck(mtx);
+        handle.reset();
+        frames.reset();
+    }
+
+  private:
+    mutable std::mutex mtx;
+    std::optional<std::string> handle;
+    std::optional<frame_path_t> frames{std::in_place};
+};
+
+#endif
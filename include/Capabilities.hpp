@@ -0,0 +1,185 @@
+/**
+ *@file Capabilities.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Typed builder for the new session capabilities
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef CAPABILITIES_HPP
+#define CAPABILITIES_HPP
+#include "ResourceBlocking.hpp"
+#include <Poco/Dynamic/Var.h>
+#include <Poco/JSON/Array.h>
+#include <Poco/JSON/Object.h>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief W3C pageLoadStrategy, when navigation commands return
+ */
+enum class PageLoadStrategy {
+    /**
+     * @brief Wait for the load event
+     */
+    Normal,
+    /**
+     * @brief Wait for DOMContentLoaded
+     */
+    Eager,
+    /**
+     * @brief Return right after the navigation starts
+     */
+    None,
+};
+
+/**
+ * @brief Builder for the POST /session body. The request is serialized on the
+ * first serialize() after a change and cached, so many sessions and threads
+ * can share one object once it is built
+ */
+class Capabilities {
+  public:
+    Capabilities() = default;
+
+    auto browserName(const std::string &name) -> Capabilities &;
+    auto pageLoadStrategy(PageLoadStrategy strategy) -> Capabilities &;
+
+    /**
+     * @brief Session timeouts in milliseconds
+     */
+    auto implicitTimeout(int ms) -> Capabilities &;
+    auto pageLoadTimeout(int ms) -> Capabilities &;
+    auto scriptTimeout(int ms) -> Capabilities &;
+
+    /**
+     * @brief Chrome command line switch, e.g. "--headless"
+     */
+    auto arg(const std::string &chromeArg) -> Capabilities &;
+    auto args(const Poco::JSON::Array::Ptr &chromeArgs) -> Capabilities &;
+
+    /**
+     * @brief Headless switches for the fastest startup: extensions, sync,
+     * component updates, background networking and throttling disabled.
+     * Switches already present keep their value, --headless is not followed
+     * by --headless=new, and the --disable-features lists are merged
+     */
+    auto leanHeadless() -> Capabilities &;
+
+    /**
+     * @brief Chrome profile preference, e.g. "download.default_directory"
+     */
+    auto pref(const std::string &name, const Poco::Dynamic::Var &value)
+        -> Capabilities &;
+
+    /**
+     * @brief Remove a default chromedriver switch, e.g. "enable-automation"
+     */
+    auto excludeSwitch(const std::string &name) -> Capabilities &;
+
+    auto userDataDir(const std::string &path) -> Capabilities &;
+
+    /**
+     * @brief Manual proxy for http and https
+     * @param[in] hostPort e.g. "127.0.0.1:3128"
+     * @param[in] noProxy Hosts that bypass the proxy
+     */
+    auto proxy(const std::string &hostPort,
+               const std::vector<std::string> &noProxy = {})
+        -> Capabilities &;
+
+    /**
+     * @brief Ask a Selenium grid to expose the "se:cdp" endpoint
+     */
+    auto enableDevTools(bool enable = true) -> Capabilities &;
+
+    /**
+     * @brief Resource blocking prefs, the CDP part is applied by
+     * WebDriver::connect after the session starts
+     */
+    auto blockResources(const ResourceBlockPolicy &policy) -> Capabilities &;
+
+    /**
+     * @brief Any other capability, e.g. "acceptInsecureCerts"
+     */
+    auto set(const std::string &name, const Poco::Dynamic::Var &value)
+        -> Capabilities &;
+
+    /**
+     * @brief Any other goog:chromeOptions entry, e.g. "binary"
+     */
+    auto chromeOption(const std::string &name, const Poco::Dynamic::Var &value)
+        -> Capabilities &;
+
+    auto resourceBlockPolicy() const -> const ResourceBlockPolicy & {
+        return blockPolicy;
+    }
+
+    /**
+     * @brief {"capabilities": {"alwaysMatch": {...}}} request body
+     */
+    auto toJson() const -> Poco::JSON::Object::Ptr;
+
+    /**
+     * @brief toJson() as a string, valid until the next change
+     */
+    auto serialize() const -> const std::string &;
+
+  private:
+    static void setOrReplace(
+        std::vector<std::pair<std::string, Poco::Dynamic::Var>> &entries,
+        const std::string &name, const Poco::Dynamic::Var &value);
+
+    void invalidate();
+
+    std::string browser{"chrome"};
+    std::optional<PageLoadStrategy> loadStrategy;
+    std::optional<int> implicitMs;
+    std::optional<int> pageLoadMs;
+    std::optional<int> scriptMs;
+    std::vector<std::string> chromeArgs;
+    std::vector<std::string> excludedSwitches;
+    std::vector<std::pair<std::string, Poco::Dynamic::Var>> chromePrefs;
+    std::vector<std::pair<std::string, Poco::Dynamic::Var>> chromeOptions;
+    std::vector<std::pair<std::string, Poco::Dynamic::Var>> extra;
+    std::string proxyHostPort;
+    std::vector<std::string> noProxyHosts;
+    bool devTools{false};
+    ResourceBlockPolicy blockPolicy;
+
+    /*
+     Filled by the first serialize() after a change, the builder calls only
+     mark it stale
+     */
+    struct SerializedCache {
+        SerializedCache() = default;
+
+        SerializedCache(const SerializedCache &other) {
+            std::lock_guard<std::mutex> lck(other.mtx);
+            body = other.body;
+            stale = other.stale;
+        }
+
+        auto operator=(const SerializedCache &other) -> SerializedCache & {
+            if (this != &other) {
+                std::scoped_lock lck(mtx, other.mtx);
+                body = other.body;
+                stale = other.stale;
+            }
+
+            return *this;
+        }
+
+        mutable std::mutex mtx;
+        std::string body;
+        bool stale{true};
+    };
+
+    mutable SerializedCache serialized;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ *@file Cookie.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Typed WebDriver cookie and binary cookie jar
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef COOKIE_HPP
+#define COOKIE_HPP
+#include <Poco/JSON/Object.h>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Compact typed representation of a WebDriver cookie
+ */
+struct Cookie {
+    std::string name;
+    std::string value;
+    std::string path;
+    std::string domain;
+    /**
+     * @brief Lax, Strict or None, empty lets the browser decide
+     */
+    std::string sameSite;
+    /**
+     * @brief Expiry in seconds since the epoch, empty for session cookies
+     */
+    std::optional<int64_t> expiry;
+    bool secure{false};
+    bool httpOnly{false};
+
+    /**
+     * @brief Build a cookie from the W3C "cookie" JSON object
+     */
+    static auto fromJson(const Poco::JSON::Object::Ptr &obj) -> Cookie;
+
+    /**
+     * @brief Build a cookie from the CDP Network.Cookie JSON object
+     */
+    static auto fromCdpJson(const Poco::JSON::Object::Ptr &obj) -> Cookie;
+
+    /**
+     * @brief W3C "cookie" JSON object, as expected by addCookie
+     */
+    auto toJson() const -> Poco::JSON::Object::Ptr;
+
+    /**
+     * @brief CDP Network.CookieParam JSON object, as expected by
+     * Network.setCookies
+     */
+    auto toCdpJson() const -> Poco::JSON::Object::Ptr;
+};
+
+/**
+ * @brief Binary on-disk cookie jar
+ *
+ * Layout (little endian): "WDCJ", uint16 version, uint32 count, then per
+ * cookie a flags byte, an int64 expiry and the length prefixed (uint32)
+ * name, value, path, domain and sameSite strings.
+ */
+class CookieJar {
+  public:
+    static constexpr uint16_t version = 1;
+
+    static void save(const std::filesystem::path &path,
+                     std::span<const Cookie> cookies);
+
+    static auto load(const std::filesystem::path &path) -> std::vector<Cookie>;
+
+    static auto serialize(std::span<const Cookie> cookies) -> std::string;
+
+    static auto deserialize(std::string_view data) -> std::vector<Cookie>;
+};
+
+#endif
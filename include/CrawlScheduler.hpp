@@ -0,0 +1,139 @@
+/**
+ *@file CrawlScheduler.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Visits a stream of URLs across many WebDriver sessions
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef CRAWL_SCHEDULER_HPP
+#define CRAWL_SCHEDULER_HPP
+#include "WebDriverClient.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct CrawlResult {
+    std::string url;
+    std::string title;
+    std::string pageSource;
+    /**
+     * @brief Empty when the page was visited and extracted
+     */
+    std::string error;
+    std::chrono::milliseconds navigationTime{0};
+    std::chrono::milliseconds extractionTime{0};
+    size_t sessionIndex{0};
+};
+
+/**
+ * @brief Destination of the crawled pages. consume is called from the sink
+ * threads, it must be thread safe when CrawlOptions::sinkThreads > 1
+ */
+class CrawlSink {
+  public:
+    virtual ~CrawlSink() = default;
+    virtual void consume(CrawlResult &&result) = 0;
+};
+
+class CallbackCrawlSink : public CrawlSink {
+  public:
+    explicit CallbackCrawlSink(std::function<void(CrawlResult &&)> callback)
+        : callback(std::move(callback)) {}
+
+    void consume(CrawlResult &&result) override {
+        callback(std::move(result));
+    }
+
+  private:
+    std::function<void(CrawlResult &&)> callback;
+};
+
+struct CrawlOptions {
+    /**
+     * @brief Pages of the same host being visited at the same time
+     */
+    size_t perHostConcurrency{2};
+    /**
+     * @brief Minimum delay between two navigations to the same host
+     */
+    std::chrono::milliseconds perHostInterval{0};
+    /**
+     * @brief Threads delivering results to the sink, so the sessions move on
+     * to the next page while the previous one is being written
+     */
+    size_t sinkThreads{1};
+    /**
+     * @brief Results waiting for the sink before the sessions are paused
+     */
+    size_t resultQueueLimit{64};
+};
+
+struct CrawlStats {
+    /**
+     * @brief Pages crawled successfully, failed ones are only counted in
+     * failures
+     */
+    uint64_t pages{0};
+    uint64_t failures{0};
+    double elapsedSeconds{0.0};
+
+    auto pagesPerSecond() const -> double {
+        if (elapsedSeconds <= 0.0) {
+            return 0.0;
+        }
+
+        return static_cast<double>(pages) / elapsedSeconds;
+    }
+};
+
+/**
+ * @brief Distributes URLs across connected sessions, one worker thread per
+ * session, enforcing per host concurrency and rate limits
+ */
+class CrawlScheduler {
+  public:
+    /**
+     * @brief Called with the scheduler lock held, never concurrently. An
+     * exception ends the URLs, run() throws it once the URLs already read
+     * are visited
+     * @return Next URL or empty when there are no more
+     */
+    using UrlSource = std::function<std::optional<std::string>()>;
+
+    CrawlScheduler(std::vector<WebDriver *> sessions, CrawlSink &sink,
+                   CrawlOptions options = {});
+
+    /**
+     * @brief Visit every URL of source, blocks until all results reached the
+     * sink. Rethrows the exception of source, if any
+     */
+    auto run(const UrlSource &source) -> CrawlStats;
+
+    auto run(std::span<const std::string> urls) -> CrawlStats;
+
+    /**
+     * @brief Live counters, can be read from another thread during run
+     */
+    auto stats() const -> CrawlStats;
+
+    static auto hostOf(const std::string &url) -> std::string;
+
+  private:
+    std::vector<WebDriver *> sessions;
+    CrawlSink &sink;
+    CrawlOptions options;
+
+    std::atomic<uint64_t> pages{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<int64_t> startedAtNs{0};
+    std::atomic<int64_t> finishedAtNs{0};
+};
+
+#endif
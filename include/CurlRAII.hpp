@@ -9,9 +9,11 @@
 #pragma once
 #ifndef CURL_RAII_HPP
 #define CURL_RAII_HPP
+#include <array>
 #include <curl/curl.h>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -76,6 +78,12 @@ class curlCallBack {
     curlCallBack() : response_code(0), curl_perfm_res(CURLE_OK) {}
 };
 
+/**
+ * @brief Process wide cURL state. Safe to use from many threads: each thread
+ * reuses its own easy handle (and so its own keep-alive connections) and
+ * every handle shares the DNS and TLS session caches through a lock protected
+ * CURLSH
+ */
 class CurlRAII {
     CurlRAII();
     ~CurlRAII();
@@ -83,6 +91,13 @@ class CurlRAII {
     CurlRAII(const CurlRAII &) = delete;
     CurlRAII(CurlRAII &&) = delete;
 
+    static void lockShare(CURL *handle, curl_lock_data data,
+                          curl_lock_access access, void *userptr);
+    static void unlockShare(CURL *handle, curl_lock_data data, void *userptr);
+
+    CURLSH *share{nullptr};
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> shareLocks;
+
   public:
     /**
      * @brief similar to make_unique but with cURL curl_easy_init and curlraii_
@@ -126,6 +141,12 @@ class CurlRAII {
      */
     static CurlRAII &instance();
 
+    /**
+     * @brief Easy handle cached for the calling thread, reset and attached to
+     * the shared caches. Valid until the thread exits
+     */
+    auto easyHandle() -> CURL *;
+
     auto postJson(const std::string &url, const std::string &json)
         -> curlCallBack;
 
@@ -0,0 +1,143 @@
+/**
+ *@file DevToolsSession.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Chrome DevTools Protocol client over a persistent WebSocket
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef DEVTOOLS_SESSION_HPP
+#define DEVTOOLS_SESSION_HPP
+#include <Poco/Dynamic/Var.h>
+#include <Poco/JSON/Object.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace Poco::Net {
+class HTTPClientSession;
+class WebSocket;
+} // namespace Poco::Net
+
+/**
+ * @brief Error returned by the browser for a CDP command
+ */
+class DevToolsError : public std::runtime_error {
+  public:
+    DevToolsError(int64_t code, const std::string &message)
+        : std::runtime_error("CDP error " + std::to_string(code) + ": " +
+                             message),
+          code(code) {}
+
+    int64_t code;
+};
+
+/**
+ * @brief One long lived WebSocket to the browser DevTools endpoint. Commands
+ * are multiplexed by message id, so many can be in flight at the same time,
+ * and events are dispatched to subscribers from the reader thread. A handler
+ * blocks the reader while it runs, so it may send() but must not call()
+ */
+class DevToolsSession {
+  public:
+    using EventHandler =
+        std::function<void(const Poco::JSON::Object::Ptr &params,
+                            const std::string &sessionId)>;
+
+    /**
+     * @brief Connect to a ws:// DevTools URL
+     * @param[in] webSocketUrl e.g. ws://127.0.0.1:9222/devtools/browser/<id>
+     */
+    explicit DevToolsSession(const std::string &webSocketUrl);
+    ~DevToolsSession();
+
+    DevToolsSession(const DevToolsSession &) = delete;
+    DevToolsSession(DevToolsSession &&) = delete;
+
+    /**
+     * @brief Find the browser WebSocket URL from a debugger address
+     * (host:port) using the /json/version endpoint
+     */
+    static auto resolveWebSocketUrl(const std::string &debuggerAddress)
+        -> std::string;
+
+    /**
+     * @brief Send a command without waiting for the answer
+     * @param[in] sessionId Target session for flattened sessions, empty for
+     * the browser target
+     * @return Future with the "result" object, or DevToolsError
+     */
+    auto send(const std::string &method,
+              const Poco::JSON::Object::Ptr &params = {},
+              const std::string &sessionId = "")
+        -> std::future<Poco::Dynamic::Var>;
+
+    /**
+     * @brief Send a command and wait for the answer. Throws std::logic_error
+     * from an event handler, the answer could never be read
+     */
+    auto call(const std::string &method,
+              const Poco::JSON::Object::Ptr &params = {},
+              const std::string &sessionId = "",
+              std::chrono::milliseconds timeout = std::chrono::seconds(30))
+        -> Poco::Dynamic::Var;
+
+    /**
+     * @brief Register a handler for an event, e.g. "Network.requestWillBeSent"
+     * @return Subscription id for unsubscribe
+     */
+    auto subscribe(const std::string &method, EventHandler handler) -> size_t;
+
+    /**
+     * @brief Remove a handler, once it returns the handler is not running and
+     * will not be called again
+     */
+    void unsubscribe(size_t subscriptionId);
+
+    /**
+     * @brief Stop the reader thread and close the socket, pending commands
+     * fail with an exception
+     */
+    void close();
+
+    auto isOpen() const -> bool { return running.load(); }
+
+  private:
+    /**
+     * @brief send() returning the message id too
+     */
+    auto post(const std::string &method, const Poco::JSON::Object::Ptr &params,
+              const std::string &sessionId)
+        -> std::pair<int64_t, std::future<Poco::Dynamic::Var>>;
+
+    void readLoop();
+    void dispatch(const std::string &message);
+    void failPending(const std::string &reason);
+
+    std::unique_ptr<Poco::Net::HTTPClientSession> http;
+    std::unique_ptr<Poco::Net::WebSocket> webSocket;
+    std::thread reader;
+    std::atomic<std::thread::id> readerId;
+    std::atomic<bool> running{false};
+    std::atomic<int64_t> nextMessageId{1};
+
+    std::mutex sendMutex;
+    std::mutex stateMutex;
+    std::recursive_mutex dispatchMutex;
+    std::unordered_map<int64_t, std::promise<Poco::Dynamic::Var>> pending;
+    std::multimap<std::string, std::pair<size_t, EventHandler>> handlers;
+    size_t nextSubscriptionId{1};
+};
+
+#endif
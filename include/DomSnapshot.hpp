@@ -0,0 +1,146 @@
+/**
+ *@file DomSnapshot.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Flat element tree snapshot taken with a single script call
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef DOM_SNAPSHOT_HPP
+#define DOM_SNAPSHOT_HPP
+#include <Poco/Dynamic/Var.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Every element of the document in document order (the same order as
+ * document.getElementsByTagName('*')), stored as structure of arrays. Tag
+ * names and attributes are indexes in a shared string table
+ */
+class DomSnapshot {
+  public:
+    struct Rect {
+        int32_t x{0};
+        int32_t y{0};
+        int32_t width{0};
+        int32_t height{0};
+    };
+
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /**
+     * @brief Script that builds the encoded snapshot in the browser
+     */
+    static auto script() -> const std::string &;
+
+    /**
+     * @brief Decode the value returned by script()
+     */
+    static auto decode(const Poco::Dynamic::Var &value) -> DomSnapshot;
+
+    auto size() const -> size_t { return tags.size(); }
+
+    auto tag(uint32_t node) const -> std::string_view {
+        return strings[tags[node]];
+    }
+
+    /**
+     * @brief Parent element index, npos for the root element
+     */
+    auto parent(uint32_t node) const -> uint32_t { return parents[node]; }
+
+    auto attribute(uint32_t node, std::string_view name) const
+        -> std::optional<std::string_view>;
+
+    auto isVisible(uint32_t node) const -> bool { return visible[node] != 0; }
+
+    auto rect(uint32_t node) const -> Rect { return rects[node]; }
+
+    /**
+     * @brief Matches compound selectors made of tag, #id, .class, [attr] and
+     * [attr=value], joined by descendant (space) and child (>) combinators
+     * @return Matching node indexes in document order
+     */
+    auto querySelectorAll(std::string_view selector) const
+        -> std::vector<uint32_t>;
+
+    auto querySelector(std::string_view selector) const
+        -> std::optional<uint32_t>;
+
+  private:
+    /**
+     * @brief Tag or attribute name of a selector resolved as written and
+     * lower cased. HTML names are stored lower case and the names of SVG and
+     * other foreign elements as is, so each matches one of the two
+     */
+    struct Name {
+        uint32_t exact{npos};
+        uint32_t html{npos};
+
+        auto empty() const -> bool { return exact == npos && html == npos; }
+
+        auto matches(uint32_t index) const -> bool {
+            return index == exact || index == html;
+        }
+    };
+
+    /**
+     * @brief One compound selector with its names already resolved to string
+     * table indexes, so matching a node only compares integers
+     */
+    struct Compound {
+        /**
+         * @brief Empty matches any tag
+         */
+        Name tag;
+        std::vector<uint32_t> ids;
+        std::vector<std::string> classes;
+        /**
+         * @brief Attribute name and required value, npos value only tests
+         * presence
+         */
+        std::vector<std::pair<Name, uint32_t>> attrs;
+        /**
+         * @brief true when joined to the previous compound with '>'
+         */
+        bool child{false};
+    };
+
+    /**
+     * @brief Parse and resolve a selector
+     * @return false when it names a string absent from the snapshot, nothing
+     * can match then
+     */
+    auto compile(std::string_view selector,
+                 std::vector<Compound> &compounds) const -> bool;
+
+    auto lookup(std::string_view str) const -> uint32_t;
+    auto attributeValue(uint32_t node, uint32_t name) const -> uint32_t;
+    auto attributeValue(uint32_t node, const Name &name) const -> uint32_t;
+    auto matches(uint32_t node, const Compound &compound) const -> bool;
+    auto matchesFrom(uint32_t node, const std::vector<Compound> &compounds,
+                     size_t index) const -> bool;
+
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> stringIndex;
+    uint32_t idName{npos};
+    uint32_t className{npos};
+
+    std::vector<uint32_t> tags;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> attrOffsets;
+    /**
+     * @brief name, value string index pairs of every element, the attributes
+     * of node n are in [attrOffsets[n], attrOffsets[n + 1])
+     */
+    std::vector<uint32_t> attrPairs;
+    std::vector<uint8_t> visible;
+    std::vector<Rect> rects;
+};
+
+#endif
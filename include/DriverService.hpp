@@ -0,0 +1,106 @@
+/**
+ *@file DriverService.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Local chromedriver process manager
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef DRIVER_SERVICE_HPP
+#define DRIVER_SERVICE_HPP
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+struct DriverServiceOptions {
+    std::string executable{"chromedriver"};
+    std::vector<std::string> extraArgs;
+    /**
+     * @brief Drivers that take sessions from the start
+     */
+    size_t instances{1};
+    /**
+     * @brief Started and ready drivers kept aside, promoted when every active
+     * driver is full so a new one never has to be waited for
+     */
+    size_t warmSpares{1};
+    size_t maxSessionsPerDriver{16};
+    std::chrono::milliseconds readyTimeout{std::chrono::seconds(10)};
+    std::chrono::milliseconds monitorInterval{std::chrono::milliseconds(500)};
+};
+
+/**
+ * @brief Spawns chromedriver processes with posix_spawn, waits for /status to
+ * report ready, restarts crashed instances and shards sessions across them
+ */
+class DriverService {
+  public:
+    explicit DriverService(DriverServiceOptions options = {});
+    ~DriverService();
+
+    DriverService(const DriverService &) = delete;
+    DriverService(DriverService &&) = delete;
+
+    /**
+     * @brief Spawn the instances and spares and start the monitor thread,
+     * nothing to do when already started
+     */
+    void start();
+
+    /**
+     * @brief Terminate every driver process
+     */
+    void stop();
+
+    /**
+     * @brief Reserve a slot for a new session on the least loaded driver
+     * @return Driver URL, e.g. http://127.0.0.1:40123
+     */
+    auto acquire() -> std::string;
+
+    /**
+     * @brief Give back a slot reserved with acquire
+     */
+    void release(const std::string &url);
+
+    auto driverUrls() const -> std::vector<std::string>;
+
+    /**
+     * @brief Ask the OS for a free TCP port on the loopback interface
+     */
+    static auto findFreePort() -> uint16_t;
+
+    /**
+     * @brief GET /status and check value.ready
+     */
+    static auto isReady(const std::string &url) -> bool;
+
+  private:
+    struct Instance {
+        pid_t pid{-1};
+        uint16_t port{0};
+        std::string url;
+        size_t sessions{0};
+        bool spare{false};
+    };
+
+    auto spawn(uint16_t port) const -> Instance;
+    static void terminate(Instance &instance);
+    void monitorLoop();
+
+    DriverServiceOptions options;
+
+    mutable std::mutex mtx;
+    std::condition_variable wakeMonitor;
+    std::vector<Instance> instances;
+    std::thread monitor;
+    bool running{false};
+};
+
+#endif
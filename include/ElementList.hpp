@@ -0,0 +1,192 @@
+/**
+ *@file ElementList.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Element references of a find command, parsed without a JSON tree
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef ELEMENT_LIST_HPP
+#define ELEMENT_LIST_HPP
+#include <Poco/JSON/Object.h>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Element ids stored back to back in one string, with the end offset
+ * of each id. Iterating yields std::string_view of the ids, valid while the
+ * list lives
+ */
+class ElementList {
+  public:
+    /**
+     * @brief Key of a W3C element reference, {"element-6066-...":"<id>"}
+     */
+    static constexpr std::string_view elementKey =
+        "element-6066-11e4-a52e-4f735466cecf";
+
+    class const_iterator {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        const_iterator() = default;
+        const_iterator(const ElementList *list, size_t index)
+            : list(list), index(index) {}
+
+        auto operator*() const -> std::string_view { return (*list)[index]; }
+
+        auto operator[](difference_type n) const -> std::string_view {
+            return (*list)[static_cast<size_t>(
+                static_cast<difference_type>(index) + n)];
+        }
+
+        auto operator++() -> const_iterator & {
+            ++index;
+            return *this;
+        }
+
+        auto operator++(int) -> const_iterator {
+            auto copy = *this;
+            ++index;
+            return copy;
+        }
+
+        auto operator--() -> const_iterator & {
+            --index;
+            return *this;
+        }
+
+        auto operator--(int) -> const_iterator {
+            auto copy = *this;
+            --index;
+            return copy;
+        }
+
+        auto operator+=(difference_type n) -> const_iterator & {
+            index =
+                static_cast<size_t>(static_cast<difference_type>(index) + n);
+            return *this;
+        }
+
+        auto operator-=(difference_type n) -> const_iterator & {
+            return *this += -n;
+        }
+
+        friend auto operator+(const_iterator it, difference_type n)
+            -> const_iterator {
+            return it += n;
+        }
+
+        friend auto operator+(difference_type n, const_iterator it)
+            -> const_iterator {
+            return it += n;
+        }
+
+        friend auto operator-(const_iterator it, difference_type n)
+            -> const_iterator {
+            return it -= n;
+        }
+
+        friend auto operator-(const const_iterator &a, const const_iterator &b)
+            -> difference_type {
+            return static_cast<difference_type>(a.index) -
+                   static_cast<difference_type>(b.index);
+        }
+
+        auto operator==(const const_iterator &other) const -> bool {
+            return index == other.index;
+        }
+
+        auto operator<=>(const const_iterator &other) const {
+            return index <=> other.index;
+        }
+
+      private:
+        const ElementList *list{nullptr};
+        size_t index{0};
+    };
+
+    using iterator = const_iterator;
+
+    /**
+     * @brief Every element reference of a command response, in order, e.g.
+     * {"value":[{"element-6066-...":"<id>"},...]}. The body is scanned for
+     * the reference key without building a JSON tree, so it also reads the
+     * references nested in a script result.
+     *
+     * Throws std::invalid_argument when a reference is malformed
+     */
+    static auto parse(std::string_view json) -> ElementList;
+
+    auto size() const -> size_t { return ends.size(); }
+    auto empty() const -> bool { return ends.empty(); }
+
+    auto operator[](size_t index) const -> std::string_view {
+        size_t begin = index == 0 ? 0 : ends[index - 1];
+        return std::string_view(ids).substr(begin, ends[index] - begin);
+    }
+
+    auto front() const -> std::string_view { return (*this)[0]; }
+    auto back() const -> std::string_view { return (*this)[size() - 1]; }
+
+    auto begin() const -> const_iterator { return {this, 0}; }
+    auto end() const -> const_iterator { return {this, size()}; }
+
+    void push_back(std::string_view id);
+
+    /**
+     * @brief Append the ids of another list, e.g. the next page
+     */
+    void append(const ElementList &other);
+
+    void clear();
+
+    /**
+     * @brief Element reference object of an id, to pass an element to a
+     * script
+     */
+    auto reference(size_t index) const -> Poco::JSON::Object::Ptr;
+
+    /**
+     * @brief Copy of the ids, one std::string each
+     */
+    auto toVector() const -> std::vector<std::string>;
+
+  private:
+    std::string ids;
+    std::vector<uint32_t> ends;
+};
+
+/**
+ * @brief One page of the elements matching a selector
+ */
+struct ElementPage {
+    ElementList elements;
+    /**
+     * @brief Offset of the first element of the page
+     */
+    size_t offset{0};
+    /**
+     * @brief Elements matching the selector when the page was taken
+     */
+    size_t total{0};
+
+    auto hasMore() const -> bool { return offset + elements.size() < total; }
+
+    /**
+     * @brief Read the "total" number of a page script result, throws
+     * std::invalid_argument when missing
+     */
+    static auto parseTotal(std::string_view json) -> size_t;
+};
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ *@file FileDownload.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Response sink of the file download command, decoded to a stream
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef FILE_DOWNLOAD_HPP
+#define FILE_DOWNLOAD_HPP
+#include "Base64Sink.hpp"
+#include <Poco/Checksum.h>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace Poco {
+class InflatingOutputStream;
+}
+
+/**
+ * @brief Takes the response of POST /session/{id}/se/files,
+ * {"value":{"filename":...,"contents":"<base64 zip>"}}, as it arrives and
+ * writes the file in the zip to out. Only a few buffers are held whatever
+ * the size of the file.
+ *
+ * The decoded contents go through a zip reader. Stored and deflated entries
+ * are supported, the CRC32 and size of the file are checked against the
+ * central directory by finish()
+ */
+class ZipDownloadSink : public Base64ResponseSink {
+  public:
+    explicit ZipDownloadSink(std::ostream &out);
+    ~ZipDownloadSink() override;
+
+    ZipDownloadSink(const ZipDownloadSink &) = delete;
+    auto operator=(const ZipDownloadSink &) -> ZipDownloadSink & = delete;
+
+    /**
+     * @brief Flush the file and check it arrived whole, throws
+     * std::runtime_error otherwise
+     */
+    void finish();
+
+    /**
+     * @brief Name of the file in the zip
+     */
+    auto fileName() const -> const std::string & { return entryName; }
+
+    auto bytesWritten() const -> uint64_t { return written; }
+
+  protected:
+    /**
+     * @brief Next bytes of the zip
+     */
+    void decoded(const char *data, size_t len) override;
+
+  private:
+    enum class ZipState { LocalHeader, EntryName, Data, Trailer };
+
+    void writeFile(const char *data, size_t len);
+
+    class FileBuf;
+
+    std::ostream &out;
+    std::unique_ptr<FileBuf> fileBuf;
+    std::unique_ptr<std::ostream> file;
+    std::unique_ptr<Poco::InflatingOutputStream> inflater;
+    Poco::Checksum checksum{Poco::Checksum::TYPE_CRC32};
+    uint64_t written{0};
+
+    ZipState zipState{ZipState::LocalHeader};
+    std::string header;
+    std::string entryName;
+    uint16_t flags{0};
+    uint16_t method{0};
+    uint64_t dataLeft{0};
+    bool sizeKnown{false};
+    /**
+     * @brief Last bytes of the zip, where the central directory is
+     */
+    std::string tail;
+    uint64_t tailOffset{0};
+    uint64_t zipOffset{0};
+};
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ *@file FileUpload.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Request body of the file upload command, encoded from disk
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef FILE_UPLOAD_HPP
+#define FILE_UPLOAD_HPP
+#include "Transport.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+/**
+ * @brief {"file":"<base64 zip>"} body of POST /session/{id}/se/file, zipped
+ * and base64 encoded while it is sent. Only a few buffers are held whatever
+ * the size of the file.
+ *
+ * The file is read twice: once on construction for the CRC32 the zip headers
+ * carry before the data, and once while sending. The entry is stored without
+ * compression, so the body size is known before the first byte is sent
+ */
+class ZipUploadBody : public RequestBody {
+  public:
+    /**
+     * @brief Throws std::runtime_error when the file cannot be read or is too
+     * big for a zip without zip64 extensions (4 GiB)
+     */
+    explicit ZipUploadBody(std::filesystem::path file);
+
+    auto size() const -> uint64_t override;
+    auto read(char *out, size_t len) -> size_t override;
+    void rewind() override;
+
+    /**
+     * @brief Size of the zip before base64 encoding
+     */
+    auto zipSize() const -> uint64_t;
+
+    auto crc32() const -> uint32_t { return crc; }
+
+    static auto base64Size(uint64_t len) -> uint64_t {
+        return (len + 2) / 3 * 4;
+    }
+
+  private:
+    enum class Stage { Prefix, Data, Suffix, Done };
+
+    /**
+     * @brief Next zip bytes: local header, file content, central directory
+     * and end record
+     */
+    auto readZip(char *out, size_t len) -> size_t;
+    void refill();
+
+    std::filesystem::path path;
+    std::ifstream file;
+    uint64_t fileSize{0};
+    uint32_t crc{0};
+
+    std::string localHeader;
+    std::string trailer;
+    uint64_t zipOffset{0};
+
+    Stage stage{Stage::Prefix};
+    std::string pending;
+    size_t pendingPos{0};
+    /**
+     * @brief Zip bytes left over from the last chunk, base64 encodes groups
+     * of 3
+     */
+    std::string carry;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ *@file LittleEndian.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Little endian integers and length prefixed strings of the binary
+ * files: cookie jars, traffic logs and the artifact index
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef LITTLE_ENDIAN_CODEC_HPP
+#define LITTLE_ENDIAN_CODEC_HPP
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace little_endian {
+/**
+ * @brief Append an integer byte by byte, whatever the host byte order
+ */
+template <class T> void appendRaw(std::string &out, T val) {
+    static_assert(std::is_integral_v<T>);
+    auto bits = static_cast<std::make_unsigned_t<T>>(val);
+
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out.push_back(static_cast<char>(bits & 0xFFU));
+        bits = static_cast<std::make_unsigned_t<T>>(bits >> 8U);
+    }
+}
+
+/**
+ * @brief uint32 length followed by the bytes
+ */
+inline void appendString(std::string &out, std::string_view str) {
+    appendRaw(out, static_cast<uint32_t>(str.size()));
+    out.append(str);
+}
+
+/**
+ * @brief Reads back what appendRaw and appendString wrote, reading past the
+ * end throws std::runtime_error with the message given
+ */
+class Reader {
+  public:
+    Reader(std::string_view data, const char *truncated)
+        : data(data), truncated(truncated) {}
+
+    template <class T> auto read() -> T {
+        static_assert(std::is_integral_v<T>);
+        std::make_unsigned_t<T> bits = 0;
+        need(sizeof(T));
+
+        for (size_t i = sizeof(T); i-- > 0;) {
+            bits = static_cast<std::make_unsigned_t<T>>(
+                (bits << 8U) | static_cast<unsigned char>(data[pos + i]));
+        }
+
+        pos += sizeof(T);
+        return static_cast<T>(bits);
+    }
+
+    auto readString() -> std::string {
+        auto len = read<uint32_t>();
+        need(len);
+        std::string result(data.substr(pos, len));
+        pos += len;
+        return result;
+    }
+
+    auto remaining() const -> size_t { return data.size() - pos; }
+
+    auto atEnd() const -> bool { return pos >= data.size(); }
+
+  private:
+    void need(size_t len) const {
+        if (data.size() - pos < len) {
+            throw std::runtime_error(truncated);
+        }
+    }
+
+    std::string_view data;
+    const char *truncated;
+    size_t pos{0};
+};
+} // namespace little_endian
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ *@file PageText.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Visible text blocks of a page, extracted with a single script call
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef PAGE_TEXT_HPP
+#define PAGE_TEXT_HPP
+#include <Poco/JSON/Array.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TextExtractionOptions {
+    /**
+     * @brief CSS selector of the element whose text is extracted
+     */
+    std::string root{"body"};
+    /**
+     * @brief Only the blocks at least partly inside the viewport
+     */
+    bool viewportOnly{false};
+    /**
+     * @brief Blocks shorter than this, in UTF-16 code units after collapsing
+     * the white space, are left out
+     */
+    uint32_t minLength{1};
+    /**
+     * @brief Stop after this many blocks, 0 for no limit
+     */
+    uint32_t maxBlocks{0};
+
+    /**
+     * @brief Arguments of PageText::script()
+     */
+    auto scriptArgs() const -> Poco::JSON::Array::Ptr;
+};
+
+/**
+ * @brief Text of the visible elements in document order, one block per run
+ * of text with the same block level element, with white space collapsed.
+ * Shadow trees are not entered.
+ *
+ * The script returns one string of records "x,y,width,height,length:text",
+ * length being the UTF-8 size of text. The records are decoded from the raw
+ * response, the texts are views in a single buffer
+ */
+class PageText {
+  public:
+    struct Rect {
+        int32_t x{0};
+        int32_t y{0};
+        int32_t width{0};
+        int32_t height{0};
+    };
+
+    static auto script() -> const std::string &;
+
+    /**
+     * @brief Decode the string returned by script()
+     */
+    static auto decode(std::string encoded) -> PageText;
+
+    /**
+     * @brief Decode a raw execute/sync response body, {"value":"<records>"},
+     * without building a JSON tree. A null value, when the root element is
+     * missing, gives no blocks
+     */
+    static auto fromResponse(std::string_view body) -> PageText;
+
+    auto size() const -> size_t { return rects.size(); }
+    auto empty() const -> bool { return rects.empty(); }
+
+    auto text(size_t block) const -> std::string_view {
+        return std::string_view(buffer).substr(offsets[block],
+                                               lengths[block]);
+    }
+
+    auto rect(size_t block) const -> Rect { return rects[block]; }
+
+    /**
+     * @brief Every block, separator between each
+     */
+    auto joined(std::string_view separator = "\n") const -> std::string;
+
+  private:
+    std::string buffer;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<Rect> rects;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ *@file PrintOptions.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Typed parameters of the print command
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef PRINT_OPTIONS_HPP
+#define PRINT_OPTIONS_HPP
+#include <Poco/JSON/Object.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class PrintOrientation {
+    Portrait,
+    Landscape,
+};
+
+/**
+ * @brief W3C print parameters. Unset sizes keep the driver defaults: US
+ * letter paper and 1 cm margins. Lengths are in centimeters
+ */
+struct PrintOptions {
+    PrintOrientation orientation{PrintOrientation::Portrait};
+    /**
+     * @brief From 0.1 to 2
+     */
+    double scale{1.0};
+    /**
+     * @brief Print background colors and images
+     */
+    bool background{false};
+    bool shrinkToFit{true};
+
+    std::optional<double> pageWidth;
+    std::optional<double> pageHeight;
+
+    std::optional<double> marginTop;
+    std::optional<double> marginBottom;
+    std::optional<double> marginLeft;
+    std::optional<double> marginRight;
+
+    /**
+     * @brief Pages to print, e.g. "1-3" or "5", empty prints every page
+     */
+    std::vector<std::string> pageRanges;
+
+    /**
+     * @brief Same margin on every side
+     */
+    auto margins(double cm) -> PrintOptions &;
+
+    /**
+     * @brief Body of POST /session/{id}/print, throws std::invalid_argument
+     * for values the driver would reject
+     */
+    auto toJson() const -> Poco::JSON::Object::Ptr;
+
+    auto serialize() const -> std::string;
+};
+
+#endif
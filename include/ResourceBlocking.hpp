@@ -0,0 +1,111 @@
+/**
+ *@file ResourceBlocking.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Resource blocking policy applied at session start
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef RESOURCE_BLOCKING_HPP
+#define RESOURCE_BLOCKING_HPP
+#include "DevToolsSession.hpp"
+#include <Poco/JSON/Array.h>
+#include <Poco/JSON/Object.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Which resources the browser must not fetch. Types are translated to
+ * URL wildcard patterns for CDP Network.setBlockedURLs, images are also
+ * disabled through Chrome content settings prefs
+ */
+struct ResourceBlockPolicy {
+    bool blockImages{false};
+    bool blockFonts{false};
+    bool blockMedia{false};
+    bool blockStylesheets{false};
+    /**
+     * @brief Block a built-in list of common analytics and ads hosts
+     */
+    bool blockTrackers{false};
+    /**
+     * @brief Extra CDP wildcard patterns, e.g. "*example.com/ads*"
+     */
+    std::vector<std::string> urlPatterns;
+
+    auto empty() const -> bool {
+        return !blockImages && !blockFonts && !blockMedia &&
+               !blockStylesheets && !blockTrackers && urlPatterns.empty();
+    }
+
+    /**
+     * @brief Every pattern to pass to Network.setBlockedURLs
+     */
+    auto blockedUrlPatterns() const -> std::vector<std::string>;
+
+    /**
+     * @brief Parameters object for Network.setBlockedURLs
+     */
+    auto toCdpParams() const -> Poco::JSON::Object::Ptr;
+
+    /**
+     * @brief Add the Chrome prefs for this policy to a goog:chromeOptions
+     * "prefs" object
+     */
+    void applyPrefs(const Poco::JSON::Object::Ptr &prefs) const;
+};
+
+/**
+ * @brief Snapshot of the counters collected by ResourceBlockMonitor
+ */
+struct ResourceBlockStats {
+    uint64_t blockedRequests{0};
+    uint64_t blockedImages{0};
+    uint64_t blockedFonts{0};
+    uint64_t blockedMedia{0};
+    uint64_t blockedStylesheets{0};
+    uint64_t finishedRequests{0};
+    /**
+     * @brief Bytes received for requests that were not blocked, the size of
+     * a blocked resource is never known because it is never fetched
+     */
+    uint64_t transferredBytes{0};
+};
+
+/**
+ * @brief Applies a policy on a page through its own DevTools session and
+ * counts the blocked requests from the Network domain events
+ */
+class ResourceBlockMonitor {
+  public:
+    /**
+     * @brief Attach to the first page target of the browser, enable the
+     * Network domain and apply the policy
+     */
+    ResourceBlockMonitor(DevToolsSession &devtools,
+                         const ResourceBlockPolicy &policy);
+    ~ResourceBlockMonitor();
+
+    ResourceBlockMonitor(const ResourceBlockMonitor &) = delete;
+    ResourceBlockMonitor(ResourceBlockMonitor &&) = delete;
+
+    auto stats() const -> ResourceBlockStats;
+
+  private:
+    DevToolsSession &devtools;
+    std::string targetSessionId;
+    std::vector<size_t> subscriptions;
+
+    std::atomic<uint64_t> blockedRequests{0};
+    std::atomic<uint64_t> blockedImages{0};
+    std::atomic<uint64_t> blockedFonts{0};
+    std::atomic<uint64_t> blockedMedia{0};
+    std::atomic<uint64_t> blockedStylesheets{0};
+    std::atomic<uint64_t> finishedRequests{0};
+    std::atomic<uint64_t> transferredBytes{0};
+};
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ *@file RetryPolicy.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Retry policy for WebDriver commands
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef RETRY_POLICY_HPP
+#define RETRY_POLICY_HPP
+#include "WebDriverError.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Which failed commands are sent again and how long to wait between
+ * attempts. The default policy never retries
+ */
+struct RetryPolicy {
+    /**
+     * @brief Attempts per command including the first one, 1 disables retries
+     */
+    unsigned maxAttempts{1};
+    std::chrono::milliseconds baseDelay{50};
+    std::chrono::milliseconds maxDelay{2000};
+    /**
+     * @brief Only retry GET and DELETE, a retried POST may run twice
+     */
+    bool idempotentOnly{true};
+    /**
+     * @brief Retries allowed for the whole session, shared by every command
+     */
+    unsigned sessionBudget{100};
+    std::vector<ErrorCode> retryOn{ErrorCode::Transport,
+                                   ErrorCode::UnknownError};
+
+    static auto isIdempotent(const std::string &verb) -> bool {
+        return verb == "GET" || verb == "DELETE" || verb == "HEAD";
+    }
+
+    auto shouldRetry(const std::string &verb, ErrorCode code) const -> bool {
+        if (idempotentOnly && !isIdempotent(verb)) {
+            return false;
+        }
+
+        return std::find(retryOn.begin(), retryOn.end(), code) !=
+               retryOn.end();
+    }
+
+    /**
+     * @brief Exponential backoff with full jitter, a random delay between 0
+     * and min(maxDelay, baseDelay * 2^attempt)
+     */
+    auto delayFor(unsigned attempt) const -> std::chrono::milliseconds {
+        thread_local std::mt19937 rng{std::random_device{}()};
+
+        auto cap = baseDelay.count() << std::min(attempt, 20U);
+        cap = std::min<decltype(cap)>(cap, maxDelay.count());
+
+        std::uniform_int_distribution<decltype(cap)> dist(0, cap);
+        return std::chrono::milliseconds(dist(rng));
+    }
+};
+
+/**
+ * @brief Retries already spent by a session, safe to share between the
+ * threads sending commands for the same session
+ */
+class RetryBudget {
+  public:
+    RetryBudget() = default;
+    RetryBudget(const RetryBudget &other) : used(other.used.load()) {}
+
+    auto operator=(const RetryBudget &other) -> RetryBudget & {
+        used = other.used.load();
+        return *this;
+    }
+
+    /**
+     * @brief Take one retry from the budget
+     * @return false when the limit was already reached
+     */
+    auto tryConsume(unsigned limit) -> bool {
+        auto current = used.load();
+
+        while (current < limit) {
+            if (used.compare_exchange_weak(current, current + 1)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    auto spent() const -> unsigned { return used.load(); }
+
+    void reset() { used = 0; }
+
+  private:
+    std::atomic<unsigned> used{0};
+};
+
+#endif
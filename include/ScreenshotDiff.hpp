@@ -0,0 +1,115 @@
+/**
+ *@file ScreenshotDiff.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Screenshot PNG decoding and tiled pixel comparison
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef SCREENSHOT_DIFF_HPP
+#define SCREENSHOT_DIFF_HPP
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief 8 bit RGBA pixels, rows stored top to bottom without padding
+ */
+struct Image {
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<uint8_t> rgba;
+
+    auto row(uint32_t y) const -> const uint8_t * {
+        return rgba.data() + static_cast<size_t>(y) * width * 4;
+    }
+
+    /**
+     * @brief Decode a non interlaced PNG with 8 bit channels (grayscale, RGB,
+     * palette, with or without alpha), the formats WebDriver screenshots use
+     */
+    static auto fromPng(std::string_view png) -> Image;
+
+    /**
+     * @brief Decode the base64 PNG returned by screenshot() and
+     * elementScreenshot()
+     */
+    static auto fromBase64Png(const std::string &base64) -> Image;
+};
+
+struct DiffRegion {
+    uint32_t x{0};
+    uint32_t y{0};
+    uint32_t width{0};
+    uint32_t height{0};
+};
+
+struct DiffOptions {
+    uint32_t tileSize{64};
+    /**
+     * @brief Largest luma weighted channel distance still considered equal,
+     * (77 |dR| + 150 |dG| + 29 |dB|) / 256, 0 compares exactly
+     */
+    uint32_t pixelTolerance{8};
+    /**
+     * @brief Stop comparing once more pixels than this differ, 0 compares
+     * everything
+     */
+    uint64_t maxDifferentPixels{0};
+    /**
+     * @brief Ignored regions, like clocks, ads or carousels
+     */
+    std::vector<DiffRegion> masks;
+    /**
+     * @brief Worker threads comparing tiles, 0 uses hardware_concurrency
+     */
+    unsigned threads{0};
+};
+
+struct TileDiff {
+    DiffRegion region;
+    uint64_t differentPixels{0};
+    uint64_t comparedPixels{0};
+
+    auto ratio() const -> double {
+        return comparedPixels == 0 ? 0.0
+                                   : static_cast<double>(differentPixels) /
+                                         static_cast<double>(comparedPixels);
+    }
+};
+
+struct DiffResult {
+    uint64_t differentPixels{0};
+    uint64_t comparedPixels{0};
+    /**
+     * @brief Set when maxDifferentPixels was exceeded and the comparison
+     * stopped early, the counters are partial then
+     */
+    bool thresholdExceeded{false};
+    /**
+     * @brief Tiles with at least one different pixel, in row major order
+     */
+    std::vector<TileDiff> tiles;
+
+    auto identical() const -> bool { return differentPixels == 0; }
+
+    auto ratio() const -> double {
+        return comparedPixels == 0 ? 0.0
+                                   : static_cast<double>(differentPixels) /
+                                         static_cast<double>(comparedPixels);
+    }
+};
+
+class ScreenshotDiff {
+  public:
+    /**
+     * @brief Compare two images of the same size tile by tile, using SSE2 on
+     * x86-64 and in parallel across tiles
+     */
+    static auto compare(const Image &before, const Image &after,
+                        const DiffOptions &options = {}) -> DiffResult;
+};
+
+#endif
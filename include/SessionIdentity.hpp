@@ -0,0 +1,117 @@
+/**
+ *@file SessionIdentity.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Id, request and capabilities of the session a client talks to
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef SESSION_IDENTITY_HPP
+#define SESSION_IDENTITY_HPP
+#include <Poco/JSON/Object.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Duration of each phase of the last connect()
+ */
+struct StartupTimings {
+    /**
+     * @brief Driver answering GET /status, only with measureStartup
+     */
+    std::chrono::microseconds driverReady{0};
+    /**
+     * @brief POST /session, mostly the browser process starting
+     */
+    std::chrono::microseconds sessionCreated{0};
+    /**
+     * @brief First about:blank load, only with measureStartup
+     */
+    std::chrono::microseconds firstNavigation{0};
+    std::chrono::microseconds total{0};
+};
+
+/**
+ * @brief The session commands are sent to. A recovery replaces it while
+ * other threads build command URLs from it, so it is only read as a copy.
+ * Safe to share between the threads sending commands for the same session
+ */
+class SessionIdentity {
+  public:
+    SessionIdentity() = default;
+
+    SessionIdentity(const SessionIdentity &other) {
+        std::lock_guard<std::mutex> lck(other.mtx);
+        sessionId = other.sessionId;
+        sessionRequest = other.sessionRequest;
+        sessionCapabilities = other.sessionCapabilities;
+        startupTimings = other.startupTimings;
+    }
+
+    auto operator=(const SessionIdentity &other) -> SessionIdentity & {
+        if (this != &other) {
+            std::scoped_lock lck(mtx, other.mtx);
+            sessionId = other.sessionId;
+            sessionRequest = other.sessionRequest;
+            sessionCapabilities = other.sessionCapabilities;
+            startupTimings = other.startupTimings;
+        }
+
+        return *this;
+    }
+
+    auto id() const -> std::string {
+        std::lock_guard<std::mutex> lck(mtx);
+        return sessionId;
+    }
+
+    /**
+     * @brief POST /session body the session was created with, empty when it
+     * was not created by this client
+     */
+    auto request() const -> std::string {
+        std::lock_guard<std::mutex> lck(mtx);
+        return sessionRequest;
+    }
+
+    /**
+     * @brief Capabilities returned by the driver on session creation, never
+     * modified once set
+     */
+    auto capabilities() const -> Poco::JSON::Object::Ptr {
+        std::lock_guard<std::mutex> lck(mtx);
+        return sessionCapabilities;
+    }
+
+    auto timings() const -> StartupTimings {
+        std::lock_guard<std::mutex> lck(mtx);
+        return startupTimings;
+    }
+
+    /**
+     * @brief Commands go to the new session from now on
+     */
+    void replace(std::string id, std::string request,
+                 Poco::JSON::Object::Ptr capabilities) {
+        std::lock_guard<std::mutex> lck(mtx);
+        sessionId = std::move(id);
+        sessionRequest = std::move(request);
+        sessionCapabilities = std::move(capabilities);
+    }
+
+    void setTimings(const StartupTimings &timings) {
+        std::lock_guard<std::mutex> lck(mtx);
+        startupTimings = timings;
+    }
+
+  private:
+    mutable std::mutex mtx;
+    std::string sessionId;
+    std::string sessionRequest;
+    Poco::JSON::Object::Ptr sessionCapabilities;
+    StartupTimings startupTimings;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ *@file SessionPool.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Reusable WebDriver sessions leased to one user at a time
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef SESSION_POOL_HPP
+#define SESSION_POOL_HPP
+#include "Capabilities.hpp"
+#include "PrintOptions.hpp"
+#include "WebDriverClient.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SessionPoolOptions {
+    /**
+     * @brief Most sessions open at the same time, they are started on demand
+     */
+    size_t size{2};
+    std::string webDriverUrl = "http://localhost:9515";
+    Capabilities capabilities;
+    /**
+     * @brief Transport of the sessions, the shared CurlTransport when unset
+     */
+    std::shared_ptr<Transport> transport;
+    /**
+     * @brief Clean a returned session before it is leased again, see
+     * SessionPool::resetSession()
+     */
+    bool resetOnRelease{true};
+    std::string resetUrl = "about:blank";
+    /**
+     * @brief Time every startup phase, see WebDriver::measureStartup
+     */
+    bool measureStartup{false};
+    /**
+     * @brief Recovery of the sessions, applied both when a command finds its
+     * session lost and by the health checks. onRecovery is called for the
+     * recoveries of every session
+     */
+    SessionRecoveryOptions recovery;
+    /**
+     * @brief Check the idle sessions this often from a background thread, 0
+     * disables the checks. See SessionPool::checkIdleSessions()
+     */
+    std::chrono::milliseconds healthCheckInterval{0};
+};
+
+/**
+ * @brief Page to load and print to a PDF file
+ */
+struct PrintJob {
+    std::string url;
+    std::filesystem::path output;
+    PrintOptions options;
+};
+
+/**
+ * @brief Page whose load starts a download, saved to a file once the session
+ * lists it
+ */
+struct DownloadJob {
+    std::string url;
+    std::string fileId;
+    std::filesystem::path output;
+    /**
+     * @brief Wait for fileId to show up in getDownloadableFiles()
+     */
+    std::chrono::milliseconds timeout{std::chrono::seconds(30)};
+};
+
+struct SessionPoolStats {
+    uint64_t created{0};
+    uint64_t leases{0};
+    uint64_t discarded{0};
+    /**
+     * @brief Sum of the connect() time of the created sessions
+     */
+    std::chrono::microseconds startupTime{0};
+    /**
+     * @brief Lost sessions replaced by a new one, from a command or a health
+     * check
+     */
+    uint64_t recovered{0};
+    uint64_t recoveryFailures{0};
+    /**
+     * @brief Idle sessions the health checks found lost
+     */
+    uint64_t lost{0};
+};
+
+/**
+ * @brief Keeps browser sessions open across users, so each one does not pay
+ * the browser startup. Thread safe
+ */
+class SessionPool {
+  public:
+    /**
+     * @brief Exclusive use of a session, returned to the pool on destruction
+     */
+    class Lease {
+      public:
+        Lease(Lease &&other) noexcept;
+        auto operator=(Lease &&other) noexcept -> Lease &;
+        ~Lease();
+
+        Lease(const Lease &) = delete;
+        auto operator=(const Lease &) -> Lease & = delete;
+
+        auto operator*() const -> WebDriver & { return *session; }
+        auto operator->() const -> WebDriver * { return session.get(); }
+
+        /**
+         * @brief The session is broken, quit it instead of reusing it
+         */
+        void discard() { broken = true; }
+
+      private:
+        friend class SessionPool;
+
+        Lease(SessionPool *pool, std::unique_ptr<WebDriver> session);
+
+        void release();
+
+        SessionPool *pool{nullptr};
+        std::unique_ptr<WebDriver> session;
+        bool broken{false};
+    };
+
+    explicit SessionPool(SessionPoolOptions options = {});
+
+    /**
+     * @brief Stops the health checks and quits the idle sessions, every
+     * lease must be returned before
+     */
+    ~SessionPool();
+
+    SessionPool(const SessionPool &) = delete;
+    auto operator=(const SessionPool &) -> SessionPool & = delete;
+
+    /**
+     * @brief Take an idle session, start a new one while below size or wait
+     * for a lease to be returned
+     */
+    auto acquire() -> Lease;
+
+    /**
+     * @brief Start up to count sessions at once, without going over size,
+     * and keep them idle. Used to scale up before the load arrives
+     * @return Sessions started
+     */
+    auto warmUp(size_t count) -> size_t;
+
+    auto stats() const -> SessionPoolStats;
+
+    /**
+     * @brief Check every idle session with WebDriver::checkHealth(). A lost
+     * session is recovered when recovery.enabled is set and quit otherwise,
+     * so a crashed browser is never leased. Only the session being checked
+     * is out of the pool. Stops when the driver is down
+     * @return Sessions found lost
+     */
+    auto checkIdleSessions() -> size_t;
+
+    /**
+     * @brief Load and print the pages on up to size sessions at once, each
+     * PDF streamed to its file. The jobs given to a session run one after
+     * the other on the same lease, without a reset between them
+     * @return Error of each job, empty when it was printed
+     */
+    auto printPages(const std::vector<PrintJob> &jobs)
+        -> std::vector<std::string>;
+
+    /**
+     * @brief Load the pages and download their files on up to size sessions
+     * at once, each file unzipped into its output while it arrives. Leased
+     * like printPages()
+     * @return Error of each job, empty when it was downloaded
+     */
+    auto downloadFiles(const std::vector<DownloadJob> &jobs)
+        -> std::vector<std::string>;
+
+    /**
+     * @brief Bring a session back to a blank state: timeouts of the session
+     * start, extra windows closed, alert dismissed, cookies and storage
+     * cleared and url loaded
+     */
+    static void resetSession(WebDriver &session,
+                             const std::string &url = "about:blank");
+
+  private:
+    auto startSession() -> std::unique_ptr<WebDriver>;
+    void release(std::unique_ptr<WebDriver> session, bool broken);
+    void monitorLoop();
+
+    /**
+     * @brief Run jobs 0 to count - 1 on up to size leased sessions, a session
+     * failing a job is discarded
+     * @return Error of each job
+     */
+    auto runLeased(size_t count,
+                   const std::function<void(WebDriver &, size_t)> &job)
+        -> std::vector<std::string>;
+
+    SessionPoolOptions options;
+
+    mutable std::mutex mtx;
+    std::condition_variable available;
+    std::vector<std::unique_ptr<WebDriver>> idle;
+    size_t open{0};
+    SessionPoolStats counters;
+
+    std::condition_variable wakeMonitor;
+    std::thread monitor;
+    bool monitoring{false};
+};
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ *@file SessionRecovery.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Health checks and recreation of crashed sessions
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef SESSION_RECOVERY_HPP
+#define SESSION_RECOVERY_HPP
+#include "Cookie.hpp"
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class SessionHealth {
+    Alive,
+    /**
+     * @brief The driver answers but the session is gone, e.g. the browser
+     * crashed or the driver restarted
+     */
+    SessionLost,
+    /**
+     * @brief The driver does not answer /status, nothing can be recovered
+     * until it is back
+     */
+    DriverDown
+};
+
+/**
+ * @brief Outcome of one recovery, successful or not
+ */
+struct RecoveryEvent {
+    std::string previousSessionId;
+    /**
+     * @brief Session that replaced it, empty when none could be created
+     */
+    std::string sessionId;
+    std::string reason;
+    unsigned attempts{0};
+    size_t cookiesRestored{0};
+    /**
+     * @brief Page loaded again, empty when none was
+     */
+    std::string url;
+    std::chrono::microseconds duration{0};
+    /**
+     * @brief Why no session could be created, empty on success
+     */
+    std::string error;
+    /**
+     * @brief The new session works but the cookies or page could not be
+     * restored
+     */
+    std::string restoreError;
+
+    auto succeeded() const -> bool { return error.empty(); }
+};
+
+struct SessionRecoveryOptions {
+    /**
+     * @brief Recreate the session when a command finds it gone, then send
+     * the command again once
+     */
+    bool enabled{false};
+    /**
+     * @brief Set the cookies of the last checkpoint in the new session
+     */
+    bool restoreCookies{false};
+    /**
+     * @brief Load the last page loaded with get() or seen by a checkpoint
+     */
+    bool restoreUrl{false};
+    /**
+     * @brief Session creations tried per recovery
+     */
+    unsigned maxAttempts{3};
+    std::chrono::milliseconds retryDelay{1000};
+    /**
+     * @brief Called on the thread that recovered, after every recovery
+     */
+    std::function<void(const RecoveryEvent &)> onRecovery;
+};
+
+/**
+ * @brief Page and cookies a recreated session is brought back to, and
+ * whether a recovery is running. Safe to share between the threads sending
+ * commands for the same session
+ */
+class SessionCheckpoint {
+  public:
+    SessionCheckpoint() = default;
+
+    SessionCheckpoint(const SessionCheckpoint &other) {
+        std::lock_guard<std::mutex> lck(other.mtx);
+        lastUrl = other.lastUrl;
+        savedCookies = other.savedCookies;
+    }
+
+    auto operator=(const SessionCheckpoint &other) -> SessionCheckpoint & {
+        if (this != &other) {
+            std::scoped_lock lck(mtx, other.mtx);
+            lastUrl = other.lastUrl;
+            savedCookies = other.savedCookies;
+        }
+
+        return *this;
+    }
+
+    auto url() const -> std::string {
+        std::lock_guard<std::mutex> lck(mtx);
+        return lastUrl;
+    }
+
+    auto cookies() const -> std::vector<Cookie> {
+        std::lock_guard<std::mutex> lck(mtx);
+        return savedCookies;
+    }
+
+    void saveUrl(const std::string &url) {
+        std::lock_guard<std::mutex> lck(mtx);
+        lastUrl = url;
+    }
+
+    void saveCookies(std::vector<Cookie> cookies) {
+        std::lock_guard<std::mutex> lck(mtx);
+        savedCookies = std::move(cookies);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lck(mtx);
+        lastUrl.clear();
+        savedCookies.clear();
+    }
+
+    /**
+     * @brief Claim the recovery, false when one is already running. The
+     * commands of a running recovery fail instead of starting another
+     */
+    auto beginRecovery() -> bool {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (recovering) {
+            return false;
+        }
+
+        recovering = true;
+        return true;
+    }
+
+    void endRecovery() {
+        std::lock_guard<std::mutex> lck(mtx);
+        recovering = false;
+    }
+
+  private:
+    mutable std::mutex mtx;
+    std::string lastUrl;
+    std::vector<Cookie> savedCookies;
+    bool recovering{false};
+};
+
+#endif
@@ -0,0 +1,220 @@
+/**
+ *@file SessionTimeouts.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Client side cache of the session timeouts
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef SESSION_TIMEOUTS_HPP
+#define SESSION_TIMEOUTS_HPP
+#include <Poco/JSON/Object.h>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+/**
+ * @brief Timeouts the driver applies to the session, as far as the client
+ * knows, and the implicit wait the next element lookup must run with. A value
+ * is only trusted after a successful command, so an update is only skipped
+ * when it certainly changes nothing. Safe to share between the threads
+ * sending commands for the same session
+ */
+class SessionTimeouts {
+  public:
+    /**
+     * @brief Timeouts in milliseconds, unset when unknown or unchanged. A
+     * null script timeout (never interrupt) stays unknown
+     */
+    struct Values {
+        std::optional<int64_t> implicit;
+        std::optional<int64_t> pageLoad;
+        std::optional<int64_t> script;
+
+        auto empty() const -> bool { return !implicit && !pageLoad && !script; }
+
+        auto complete() const -> bool { return implicit && pageLoad && script; }
+
+        static auto fromJson(const Poco::JSON::Object::Ptr &obj) -> Values {
+            Values values;
+
+            if (obj.isNull()) {
+                return values;
+            }
+
+            auto read = [&obj](const char *key, std::optional<int64_t> &out) {
+                if (obj->has(key) && !obj->isNull(key)) {
+                    out = obj->getValue<int64_t>(key);
+                }
+            };
+
+            read("implicit", values.implicit);
+            read("pageLoad", values.pageLoad);
+            read("script", values.script);
+            return values;
+        }
+
+        /**
+         * @brief Timeouts of a new session when the driver does not report
+         * them
+         */
+        static auto w3cDefaults() -> Values {
+            return {0, 300000, 30000};
+        }
+
+        auto toJson() const -> Poco::JSON::Object::Ptr {
+            Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+
+            if (implicit) {
+                obj->set("implicit", *implicit);
+            }
+
+            if (pageLoad) {
+                obj->set("pageLoad", *pageLoad);
+            }
+
+            if (script) {
+                obj->set("script", *script);
+            }
+
+            return obj;
+        }
+    };
+
+    SessionTimeouts() = default;
+
+    SessionTimeouts(const SessionTimeouts &other) {
+        std::lock_guard<std::mutex> lck(other.mtx);
+        server = other.server;
+        wantedImplicit = other.wantedImplicit;
+        initial = other.initial;
+    }
+
+    auto operator=(const SessionTimeouts &other) -> SessionTimeouts & {
+        if (this != &other) {
+            std::scoped_lock lck(mtx, other.mtx);
+            server = other.server;
+            wantedImplicit = other.wantedImplicit;
+            initial = other.initial;
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief Timeouts as the session commands see them, the implicit wait is
+     * the one the next element lookup runs with
+     */
+    auto current() const -> Values {
+        std::lock_guard<std::mutex> lck(mtx);
+        Values values = server;
+
+        if (wantedImplicit) {
+            values.implicit = wantedImplicit;
+        }
+
+        return values;
+    }
+
+    /**
+     * @brief The values of wanted the driver may not have yet
+     */
+    auto changed(const Values &wanted) const -> Values {
+        std::lock_guard<std::mutex> lck(mtx);
+        Values values;
+
+        if (wanted.implicit != server.implicit) {
+            values.implicit = wanted.implicit;
+        }
+
+        if (wanted.pageLoad != server.pageLoad) {
+            values.pageLoad = wanted.pageLoad;
+        }
+
+        if (wanted.script != server.script) {
+            values.script = wanted.script;
+        }
+
+        return values;
+    }
+
+    /**
+     * @brief Implicit wait to send before the next element lookup, nullopt
+     * when the driver already has it
+     */
+    auto pendingImplicit() const -> std::optional<int64_t> {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (!wantedImplicit || wantedImplicit == server.implicit) {
+            return std::nullopt;
+        }
+
+        return wantedImplicit;
+    }
+
+    /**
+     * @brief The next element lookup must run with this implicit wait,
+     * nothing is sent until then
+     */
+    void wantImplicit(int64_t milliseconds) {
+        std::lock_guard<std::mutex> lck(mtx);
+        wantedImplicit = milliseconds;
+    }
+
+    /**
+     * @brief The driver accepted or reported these values
+     */
+    void learned(const Values &values) {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (values.implicit) {
+            server.implicit = values.implicit;
+        }
+
+        if (values.pageLoad) {
+            server.pageLoad = values.pageLoad;
+        }
+
+        if (values.script) {
+            server.script = values.script;
+        }
+    }
+
+    /**
+     * @brief A timeouts update failed, what the driver applies is unknown
+     */
+    void forget() {
+        std::lock_guard<std::mutex> lck(mtx);
+        server = {};
+    }
+
+    /**
+     * @brief A new session starts with the timeouts it reports
+     * @param[in] defaults Timeouts the session started with, as far as
+     * known, see defaults()
+     */
+    void reset(const Values &reported = {},
+               const Values &defaults = Values::w3cDefaults()) {
+        std::lock_guard<std::mutex> lck(mtx);
+        server = reported;
+        wantedImplicit.reset();
+        initial = defaults;
+    }
+
+    /**
+     * @brief Timeouts the session started with, to go back to them
+     */
+    auto defaults() const -> Values {
+        std::lock_guard<std::mutex> lck(mtx);
+        return initial;
+    }
+
+  private:
+    mutable std::mutex mtx;
+    Values server;
+    std::optional<int64_t> wantedImplicit;
+    Values initial{Values::w3cDefaults()};
+};
+
+#endif
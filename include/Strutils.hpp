@@ -3,32 +3,57 @@
 #define Strutils_hpp
 
 #include <algorithm>
+#include <array>
 #include <cstring>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <optional>
-#include <regex>
 #include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <vector>
 
+/*
+ The search, case conversion, digit filter and decoders are implemented in
+ Strutils.cpp with SSE2 and AVX2 (selected at runtime) and a scalar fallback
+ for other architectures
+ */
 class Strutils {
   public:
+    /**
+     * @brief string_view::find with a vectorized scan for the first and last
+     * bytes of term
+     */
+    static auto find(std::string_view str, std::string_view term,
+                     size_t pos = 0) -> size_t;
+
+    /**
+     * @brief ASCII only conversion, other bytes are left untouched
+     */
+    static void ascii_to_upper(char *data, size_t size);
+    static void ascii_to_lower(char *data, size_t size);
+
     static inline void to_upper(std::string &str) {
-        std::transform(str.begin(), str.end(), str.begin(),
-                       [](unsigned char c) -> unsigned char {
-                           return static_cast<unsigned char>(std::toupper(c));
-                       });
+        ascii_to_upper(str.data(), str.size());
     }
 
     static inline void to_lower(std::string &str) {
-        std::transform(str.begin(), str.end(), str.begin(),
-                       [](unsigned char c) -> unsigned char {
-                           return static_cast<unsigned char>(std::tolower(c));
-                       });
+        ascii_to_lower(str.data(), str.size());
     }
 
+    /**
+     * @brief Copy of the ASCII digits of str
+     */
+    static auto digits_only(std::string_view str) -> std::string;
+
+    /**
+     * @brief Decode an even length string of hex digits (either case)
+     * @return nullopt when the length is odd or a character is not a hex
+     * digit
+     */
+    static auto hex_decode(std::string_view str) -> std::optional<std::string>;
+
     static inline void replace_chr(std::string &str, char chin, char chout) {
         for (auto &ch : str) {
             if (ch == chin) {
@@ -62,8 +87,7 @@ class Strutils {
     }
 
     static inline auto getCNPJNumbers(const std::string &cnpj) -> std::string {
-        return std::regex_replace(cnpj, std::regex("[^0-9]*"),
-                                  std::string("$1"));
+        return digits_only(cnpj);
     }
 
     static inline auto join(const std::span<const std::string> &vec,
@@ -86,89 +110,14 @@ class Strutils {
     template <class StrType = std::string>
     static auto explode(std::string_view strview, std::string_view term)
         -> std::vector<StrType> {
-        size_t current = 0;
-        std::vector<StrType> result;
-
-        if (strview.empty()) {
-            return result;
-        }
-
-        if (term.empty()) {
-            result.emplace_back(strview);
-            return result;
-        }
-
-        do {
-            auto sep = strview.find(term, current);
-
-            result.emplace_back(strview.substr(
-                current,
-                (sep == std::string_view::npos) ? sep : (sep - current)));
-
-            if (sep == std::string_view::npos) {
-                break;
-            }
-
-            current = sep + term.size();
-        } while (current < strview.size());
-
-        return result;
+        return split<StrType>(strview, term);
     }
 
-    static auto url_decode(const std::string &str) -> std::string {
-        std::string result;
-        result.reserve(str.size());
-
-        std::unordered_map<char, int> arrmap = {
-            std::pair<char, int>('0', 0),   std::pair<char, int>('1', 1),
-            std::pair<char, int>('2', 2),   std::pair<char, int>('3', 3),
-            std::pair<char, int>('4', 4),   std::pair<char, int>('5', 5),
-            std::pair<char, int>('6', 6),   std::pair<char, int>('7', 7),
-            std::pair<char, int>('8', 8),   std::pair<char, int>('9', 9),
-            std::pair<char, int>('A', 0xA), std::pair<char, int>('B', 0xB),
-            std::pair<char, int>('C', 0xC), std::pair<char, int>('D', 0xD),
-            std::pair<char, int>('E', 0xE), std::pair<char, int>('F', 0xF),
-        };
-
-        int chrsize = 0;
-        unsigned int tempchchr = 0;
-        bool inchr = false;
-
-        for (const auto &c : str) {
-            if (chrsize == 2) {
-                result.append(1U, static_cast<char>(tempchchr));
-                inchr = false;
-                chrsize = 0;
-                tempchchr = 0;
-            }
-
-            if (c == '%') {
-                inchr = true;
-                chrsize = 0;
-                tempchchr = 0;
-                continue;
-            }
-
-            if (inchr) {
-                if (chrsize == 0) {
-                    tempchchr = 0;
-                    tempchchr |= static_cast<unsigned>(arrmap[c]) << 4U;
-                    ++chrsize;
-                } else {
-                    tempchchr |= static_cast<unsigned>(arrmap[c]);
-                    ++chrsize;
-                }
-            } else {
-                result.append(1U, c);
-            }
-        }
-
-        if (chrsize == 2) {
-            result.append(1U, static_cast<char>(tempchchr));
-        }
-
-        return result;
-    }
+    /**
+     * @brief Decode %XX escapes (either case), an invalid escape is copied as
+     * is
+     */
+    static auto url_decode(std::string_view str) -> std::string;
 
     template <class... Types>
     static auto multi_concat(const Types &...args) -> std::string {
@@ -190,34 +139,102 @@ class Strutils {
         return result;
     }
 
-    template <class StrType = std::string>
-    static auto split(std::string_view strview, std::string_view term)
-        -> std::vector<StrType> {
-        size_t current = 0;
-        std::vector<StrType> result;
+    /**
+     * @brief Lazy split, yields string_views into the original string
+     * without allocating. Same pieces as split: a trailing separator does not
+     * produce an empty last piece
+     */
+    class SplitIterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view *;
+        using reference = const std::string_view &;
+
+        SplitIterator() = default;
+
+        SplitIterator(std::string_view str, std::string_view term)
+            : str(str), term(term) {
+            if (str.empty()) {
+                return;
+            }
 
-        if (strview.empty()) {
-            return result;
+            done = false;
+            locate(0);
         }
 
-        if (term.empty()) {
-            result.emplace_back(strview);
-            return result;
-        }
+        auto operator*() const -> reference { return piece; }
+        auto operator->() const -> pointer { return &piece; }
 
-        do {
-            auto sep = strview.find(term, current);
+        auto operator++() -> SplitIterator & {
+            if (sep == std::string_view::npos) {
+                done = true;
+                return *this;
+            }
 
-            result.emplace_back(strview.substr(
-                current,
-                (sep == std::string_view::npos) ? sep : (sep - current)));
+            auto next = sep + term.size();
 
-            if (sep == std::string_view::npos) {
-                break;
+            if (next >= str.size()) {
+                done = true;
+                return *this;
             }
 
-            current = sep + term.size();
-        } while (current < strview.size());
+            locate(next);
+            return *this;
+        }
+
+        auto operator++(int) -> SplitIterator {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        auto operator==(const SplitIterator &other) const -> bool {
+            if (done || other.done) {
+                return done == other.done;
+            }
+
+            return piece.data() == other.piece.data();
+        }
+
+      private:
+        void locate(size_t current) {
+            sep = term.empty() ? std::string_view::npos
+                               : Strutils::find(str, term, current);
+            piece = str.substr(current, sep == std::string_view::npos
+                                            ? sep
+                                            : sep - current);
+        }
+
+        std::string_view str;
+        std::string_view term;
+        std::string_view piece;
+        size_t sep{std::string_view::npos};
+        bool done{true};
+    };
+
+    struct SplitRange {
+        std::string_view str;
+        std::string_view term;
+
+        auto begin() const -> SplitIterator { return {str, term}; }
+        auto end() const -> SplitIterator { return {}; }
+    };
+
+    static auto split_view(std::string_view strview, std::string_view term)
+        -> SplitRange {
+        return {strview, term};
+    }
+
+    template <class StrType = std::string>
+    static auto split(std::string_view strview, std::string_view term)
+        -> std::vector<StrType> {
+        std::vector<StrType> result;
+
+        for (auto piece : split_view(strview, term)) {
+            result.emplace_back(piece);
+        }
 
         return result;
     }
@@ -0,0 +1,118 @@
+/**
+ *@file TrafficLog.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Recording and replay of WebDriver HTTP traffic
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef TRAFFIC_LOG_HPP
+#define TRAFFIC_LOG_HPP
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TrafficEntry {
+    std::string verb;
+    /**
+     * @brief Path and query without scheme and host, so a log replays
+     * against a driver listening on another address
+     */
+    std::string path;
+    std::string body;
+    std::string response;
+    int64_t responseCode{0};
+    /**
+     * @brief CURLcode of the request, 0 when it reached the driver
+     */
+    int32_t transportError{0};
+    /**
+     * @brief Microseconds between the start of the recording and the request
+     */
+    int64_t startUs{0};
+    int64_t durationUs{0};
+};
+
+/**
+ * @brief Appends every exchange to a binary, little endian log file. Thread
+ * safe
+ */
+class TrafficRecorder {
+  public:
+    explicit TrafficRecorder(const std::filesystem::path &path);
+
+    /**
+     * @brief Record one exchange, started is when the request was sent
+     */
+    void record(TrafficEntry entry,
+                std::chrono::steady_clock::time_point started);
+
+    void flush();
+
+    auto count() const -> size_t;
+
+    /**
+     * @brief Strip the scheme and host of url
+     */
+    static auto pathOf(const std::string &url) -> std::string;
+
+  private:
+    mutable std::mutex mtx;
+    std::ofstream file;
+    std::chrono::steady_clock::time_point epoch;
+    size_t entries{0};
+};
+
+/**
+ * @brief Serves the responses of a recorded log instead of a driver. Each
+ * verb and path pair is answered in recorded order, so requests issued from
+ * several threads still receive matching responses. Thread safe
+ */
+class TrafficReplayer {
+  public:
+    explicit TrafficReplayer(const std::filesystem::path &path);
+    explicit TrafficReplayer(std::vector<TrafficEntry> entries);
+
+    static auto load(const std::filesystem::path &path)
+        -> std::vector<TrafficEntry>;
+
+    /**
+     * @brief Recorded exchange for the request, waiting the recorded duration
+     * first when simulateLatency is set
+     * @return nullopt when the log has no more responses for the request
+     */
+    auto next(const std::string &verb, const std::string &url)
+        -> std::optional<TrafficEntry>;
+
+    /**
+     * @brief Exchanges not served yet
+     */
+    auto remaining() const -> size_t;
+
+    auto entries() const -> const std::vector<TrafficEntry> & { return log; }
+
+    /**
+     * @brief Reproduce the recorded response times, off to measure only the
+     * client side overhead
+     */
+    bool simulateLatency{false};
+
+  private:
+    void index();
+
+    std::vector<TrafficEntry> log;
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, std::deque<size_t>> pending;
+    size_t served{0};
+};
+
+#endif
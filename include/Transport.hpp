@@ -0,0 +1,316 @@
+/**
+ *@file Transport.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief HTTP transports used to talk to the WebDriver server
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+#include "TrafficLog.hpp"
+#include <chrono>
+#include <cstdint>
+#include <curl/curl.h>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct HttpResponse {
+    std::string body;
+    long code{0};
+    /**
+     * @brief Transport failure reported with the closest CURLcode, so every
+     * transport is recorded and reported the same way
+     */
+    CURLcode error{CURLE_OK};
+    /**
+     * @brief Details of the failure, curl_easy_strerror(error) when empty
+     */
+    std::string message;
+
+    auto ok() const -> bool { return error == CURLE_OK; }
+};
+
+/**
+ * @brief Request body produced while it is sent, so a large upload is never
+ * held in memory whole
+ */
+class RequestBody {
+  public:
+    virtual ~RequestBody() = default;
+
+    /**
+     * @brief Exact size, sent as Content-Length
+     */
+    virtual auto size() const -> uint64_t = 0;
+
+    /**
+     * @brief Fill up to len bytes of out
+     * @return Bytes written, 0 at the end of the body
+     */
+    virtual auto read(char *out, size_t len) -> size_t = 0;
+
+    /**
+     * @brief Start over, for a transport sending the body again
+     */
+    virtual void rewind() = 0;
+};
+
+/**
+ * @brief Receives a response body as it arrives, so a large download is
+ * never held in memory whole
+ */
+class ResponseSink {
+  public:
+    virtual ~ResponseSink() = default;
+
+    /**
+     * @brief Next bytes of the body, throwing aborts the transfer
+     */
+    virtual void write(const char *data, size_t len) = 0;
+};
+
+/**
+ * @brief Sends the requests of a WebDriver, implementations must be safe to
+ * use from many threads
+ */
+class Transport {
+  public:
+    virtual ~Transport() = default;
+
+    /**
+     * @param[in] url Absolute URL, scheme and host included
+     * @param[in] body JSON body, empty sends no body
+     */
+    virtual auto send(const std::string &verb, const std::string &url,
+                      const std::string &body) -> HttpResponse = 0;
+
+    /**
+     * @brief Asynchronous send, runs send() on another thread unless the
+     * transport has a better way
+     */
+    virtual auto sendAsync(std::string verb, std::string url, std::string body)
+        -> std::future<HttpResponse>;
+
+    /**
+     * @brief Send a JSON body read from body while sending. The default reads
+     * the whole body and calls send(), streaming transports override it
+     */
+    virtual auto sendBody(const std::string &verb, const std::string &url,
+                          RequestBody &body) -> HttpResponse;
+
+    /**
+     * @brief Send a request and pass the response body to sink as it
+     * arrives, the returned body stays empty. The default calls send() and
+     * passes the whole body, streaming transports override it
+     */
+    virtual auto sendInto(const std::string &verb, const std::string &url,
+                          const std::string &body, ResponseSink &sink)
+        -> HttpResponse;
+
+    /**
+     * @brief Process wide CurlTransport used by a WebDriver without transport
+     */
+    static auto defaultTransport() -> std::shared_ptr<Transport>;
+};
+
+/**
+ * @brief Transport over the per-thread handles of CurlRAII
+ */
+class CurlTransport : public Transport {
+  public:
+    auto send(const std::string &verb, const std::string &url,
+              const std::string &body) -> HttpResponse override;
+
+    auto sendBody(const std::string &verb, const std::string &url,
+                  RequestBody &body) -> HttpResponse override;
+
+    auto sendInto(const std::string &verb, const std::string &url,
+                  const std::string &body, ResponseSink &sink)
+        -> HttpResponse override;
+};
+
+/**
+ * @brief Minimal keep-alive HTTP/1.1 client over TCP or a Unix socket. Skips
+ * the per-request setup of libcurl, meant for the plain HTTP loopback
+ * connection to a local driver: no TLS, proxies or redirects
+ */
+class SocketTransport : public Transport {
+  public:
+    /**
+     * @brief Connect over TCP to the host and port of each URL
+     */
+    SocketTransport() = default;
+
+    /**
+     * @brief Connect to a Unix socket, the host of the URLs only goes in the
+     * Host header
+     */
+    explicit SocketTransport(std::filesystem::path unixSocket);
+
+    ~SocketTransport() override;
+
+    SocketTransport(const SocketTransport &) = delete;
+    auto operator=(const SocketTransport &) -> SocketTransport & = delete;
+
+    auto send(const std::string &verb, const std::string &url,
+              const std::string &body) -> HttpResponse override;
+
+    auto sendBody(const std::string &verb, const std::string &url,
+                  RequestBody &body) -> HttpResponse override;
+
+    auto sendInto(const std::string &verb, const std::string &url,
+                  const std::string &body, ResponseSink &sink)
+        -> HttpResponse override;
+
+    /**
+     * @brief Idle connections kept per host
+     */
+    size_t maxIdleConnections{8};
+
+    /**
+     * @brief Give up on a response after this long, 0 waits forever
+     */
+    std::chrono::milliseconds timeout{0};
+
+  private:
+    struct Target {
+        std::string authority;
+        std::string host;
+        std::string port;
+        std::string path;
+    };
+
+    static auto parseUrl(const std::string &url) -> Target;
+
+    static auto requestHead(const std::string &verb, const Target &target,
+                            uint64_t contentLength, bool hasBody)
+        -> std::string;
+
+    auto connectTo(const Target &target, HttpResponse &res) -> int;
+    auto acquire(const Target &target) -> int;
+    void release(const std::string &authority, int fd);
+
+    /**
+     * @brief Send the request on a pooled or new connection, once more on a
+     * new connection when the pooled one was closed by the server
+     */
+    auto perform(const std::string &url, const std::string &verb,
+                 const std::string &body, RequestBody *stream,
+                 ResponseSink *sink) -> HttpResponse;
+
+    auto sendAll(int fd, const char *data, size_t len, HttpResponse &res)
+        -> bool;
+
+    /**
+     * @brief One request and its response, the body goes to sink when set
+     */
+    auto exchange(int fd, const std::string &request, RequestBody *stream,
+                  ResponseSink *sink, HttpResponse &res, bool &keepAlive)
+        -> bool;
+
+    std::filesystem::path unixSocket;
+
+    std::mutex mtx;
+    std::unordered_map<std::string, std::vector<int>> idle;
+};
+
+/**
+ * @brief In memory transport answering from a handler, for tests and to
+ * measure the client without any I/O
+ */
+class MockTransport : public Transport {
+  public:
+    using handler_t = std::function<HttpResponse(
+        const std::string &verb, const std::string &url,
+        const std::string &body)>;
+
+    MockTransport() = default;
+    explicit MockTransport(handler_t handler);
+
+    auto send(const std::string &verb, const std::string &url,
+              const std::string &body) -> HttpResponse override;
+
+    /**
+     * @brief Answer every request with the same response
+     */
+    static auto always(HttpResponse response) -> std::shared_ptr<MockTransport>;
+
+    auto requestCount() const -> size_t;
+
+  private:
+    handler_t handler;
+
+    mutable std::mutex mtx;
+    size_t requests{0};
+};
+
+/**
+ * @brief Records every exchange of another transport
+ */
+class RecordingTransport : public Transport {
+  public:
+    RecordingTransport(std::shared_ptr<Transport> inner,
+                       std::shared_ptr<TrafficRecorder> recorder);
+
+    auto send(const std::string &verb, const std::string &url,
+              const std::string &body) -> HttpResponse override;
+
+    /**
+     * @brief Streamed bodies are recorded empty, replay only matches the
+     * verb and path
+     */
+    auto sendBody(const std::string &verb, const std::string &url,
+                  RequestBody &body) -> HttpResponse override;
+
+    /**
+     * @brief Streamed responses are recorded as passed to sink
+     */
+    auto sendInto(const std::string &verb, const std::string &url,
+                  const std::string &body, ResponseSink &sink)
+        -> HttpResponse override;
+
+  private:
+    void record(const std::string &verb, const std::string &url,
+                const std::string &body, const HttpResponse &res,
+                std::chrono::steady_clock::time_point started);
+
+    std::shared_ptr<Transport> inner;
+    std::shared_ptr<TrafficRecorder> recorder;
+};
+
+/**
+ * @brief Answers from a recorded traffic log, nothing is sent
+ */
+class ReplayTransport : public Transport {
+  public:
+    explicit ReplayTransport(std::shared_ptr<TrafficReplayer> replayer);
+
+    auto send(const std::string &verb, const std::string &url,
+              const std::string &body) -> HttpResponse override;
+
+    auto sendBody(const std::string &verb, const std::string &url,
+                  RequestBody &body) -> HttpResponse override;
+
+    /**
+     * @brief Passes the recorded response to sink
+     */
+    auto sendInto(const std::string &verb, const std::string &url,
+                  const std::string &body, ResponseSink &sink)
+        -> HttpResponse override;
+
+  private:
+    auto replay(const std::string &verb, const std::string &url)
+        -> HttpResponse;
+
+    std::shared_ptr<TrafficReplayer> replayer;
+};
+
+#endif
@@ -12,16 +12,41 @@
  * or guarantees of any kind. Users assume all risks associated with its use.
  */
 
+#include "ArtifactStore.hpp"
+#include "BrowsingContext.hpp"
+#include "Capabilities.hpp"
+#include "Cookie.hpp"
 #include "CurlRAII.hpp"
+#include "DevToolsSession.hpp"
+#include "DomSnapshot.hpp"
+#include "ElementList.hpp"
+#include "FileDownload.hpp"
+#include "FileUpload.hpp"
+#include "PageText.hpp"
+#include "PrintOptions.hpp"
+#include "ResourceBlocking.hpp"
+#include "RetryPolicy.hpp"
+#include "SessionIdentity.hpp"
+#include "SessionRecovery.hpp"
+#include "SessionTimeouts.hpp"
+#include "ScreenshotDiff.hpp"
+#include "Transport.hpp"
+#include "WebDriverError.hpp"
 #include <Poco/Dynamic/Var.h>
 #include <Poco/JSON/Array.h>
 #include <Poco/JSON/Object.h>
 #include <Poco/JSON/Parser.h>
+#include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string_view>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 struct WebDriver {
     using elementType = Poco::Dynamic::Var;
@@ -53,6 +78,24 @@ chrome=129.0.6668.70)", "stacktrace": "#0 0x5dd8a5bff10a \u003Cunknown>\n#1
     }
 }
         */
+        CommandResult result;
+        parseError(obj, result);
+
+        if (result) {
+            return;
+        }
+
+        std::cerr << "Error: " << result.message << std::endl;
+        throw WebDriverError(result.error, result.message,
+                             result.errorString);
+    }
+
+    /**
+     * @brief Fill error and message of result from a response object, without
+     * throwing
+     */
+    static void parseError(const Poco::JSON::Object::Ptr &obj,
+                           CommandResult &result) {
         if (!obj->has("value") || obj->isNull("value")) {
             return;
         }
@@ -67,36 +110,151 @@ chrome=129.0.6668.70)", "stacktrace": "#0 0x5dd8a5bff10a \u003Cunknown>\n#1
             return;
         }
 
-        auto error = value->getValue<std::string>("error");
-
-        auto message = value->get("message").toString();
-        std::cerr << "Error: " << message << std::endl;
-        throw std::runtime_error("Error: " + error + "\n" + message);
+        result.errorString = value->getValue<std::string>("error");
+        result.error = errorCodeFromString(result.errorString);
+        result.message = value->get("message").toString();
     }
 
     void connect(const Poco::JSON::Array::Ptr &args = {}) {
-        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
-        Poco::JSON::Object::Ptr capabilities = new Poco::JSON::Object();
-        Poco::JSON::Object::Ptr alwaysMatch = new Poco::JSON::Object();
-        alwaysMatch->set("browserName", "chrome");
+        Capabilities caps;
+        caps.args(args)
+            .blockResources(resourceBlockPolicy)
+            .enableDevTools(enableDevTools);
 
-        if (!args.isNull() && args->size() > 0) {
-            Poco::JSON::Object::Ptr chromeOptions = new Poco::JSON::Object();
-            chromeOptions->set("args", args);
-            alwaysMatch->set("goog:chromeOptions", chromeOptions);
+        connect(caps);
+    }
+
+    /**
+     * @brief Start a session with prebuilt capabilities, the same
+     * Capabilities object can be shared by every session of a pool
+     */
+    void connect(const Capabilities &caps) {
+        connectSerialized(caps.serialize());
+        sessionBlockPolicy = caps.resourceBlockPolicy();
+
+        if (!sessionBlockPolicy.empty()) {
+            applyResourceBlockPolicy(sessionBlockPolicy);
         }
+    }
 
-        capabilities->set("alwaysMatch", alwaysMatch);
-        obj->set("capabilities", capabilities);
+    /**
+     * @brief Start a session from a prebuilt POST /session body, such as
+     * Capabilities::serialize() saved by an earlier run, sent as is
+     */
+    void connectSerialized(const std::string &serializedRequest) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        using std::chrono::steady_clock;
 
-        auto reqStr = jsonToString(obj);
+        StartupTimings timings;
+        auto started = steady_clock::now();
 
-        std::cout << reqStr << std::endl;
+        if (measureStartup) {
+            tryCallUrlDriver("GET", webDriverUrl + "/status");
+            timings.driverReady =
+                duration_cast<microseconds>(steady_clock::now() - started);
+        }
 
-        auto URL = webDriverUrl + "/session";
-        auto value = callUrlDriver("POST", URL, reqStr)
+        auto creating = steady_clock::now();
+        auto value = callUrlDriver("POST", webDriverUrl + "/session",
+                                   serializedRequest)
                          .extract<Poco::JSON::Object::Ptr>();
-        sessionId = value->get("sessionId").toString();
+        timings.sessionCreated =
+            duration_cast<microseconds>(steady_clock::now() - creating);
+
+        Poco::JSON::Object::Ptr capabilities;
+
+        if (value->has("capabilities")) {
+            capabilities = value->getObject("capabilities");
+        }
+
+        session.replace(value->get("sessionId").toString(), serializedRequest,
+                        capabilities);
+        browsingContext.reset();
+
+        /*
+         A driver not reporting the timeouts is assumed to start from the
+         W3C defaults, but nothing is skipped based on that
+         */
+        if (!capabilities.isNull() && capabilities->has("timeouts")) {
+            auto reported = SessionTimeouts::Values::fromJson(
+                capabilities->getObject("timeouts"));
+            sessionTimeouts.reset(reported, reported);
+        } else {
+            sessionTimeouts.reset();
+        }
+
+        if (measureStartup) {
+            auto navigating = steady_clock::now();
+            get("about:blank");
+            timings.firstNavigation =
+                duration_cast<microseconds>(steady_clock::now() - navigating);
+        }
+
+        timings.total =
+            duration_cast<microseconds>(steady_clock::now() - started);
+        session.setTimings(timings);
+    }
+
+    auto sessionId() const -> std::string { return session.id(); }
+
+    /**
+     * @brief Capabilities returned by the driver on session creation
+     */
+    auto sessionCapabilities() const -> Poco::JSON::Object::Ptr {
+        return session.capabilities();
+    }
+
+    auto startupTimings() const -> StartupTimings { return session.timings(); }
+
+    /**
+     * @brief "/session/{id}", the start of every session command path
+     */
+    auto sessionPath() const -> std::string {
+        return "/session/" + sessionId();
+    }
+
+    /**
+     * @brief Block resources through chromedriver's CDP connection, connect()
+     * calls it with resourceBlockPolicy. Use ResourceBlockMonitor instead
+     * when the blocked requests must be counted
+     */
+    void applyResourceBlockPolicy(const ResourceBlockPolicy &policy) {
+        executeCdpCommand("Network.enable");
+        executeCdpCommand("Network.setBlockedURLs", policy.toCdpParams());
+    }
+
+    /**
+     * @brief DevTools WebSocket URL of the session browser, from the grid
+     * "se:cdp" capability or from chromedriver's debuggerAddress
+     */
+    auto devToolsWebSocketUrl() -> std::string {
+        auto capabilities = sessionCapabilities();
+
+        if (capabilities.isNull()) {
+            throw std::runtime_error("Session has no capabilities");
+        }
+
+        if (capabilities->has("se:cdp")) {
+            return capabilities->getValue<std::string>("se:cdp");
+        }
+
+        auto chromeOptions = capabilities->getObject("goog:chromeOptions");
+
+        if (chromeOptions.isNull() || !chromeOptions->has("debuggerAddress")) {
+            throw std::runtime_error("Browser did not expose a DevTools "
+                                     "debugger address");
+        }
+
+        return DevToolsSession::resolveWebSocketUrl(
+            chromeOptions->getValue<std::string>("debuggerAddress"));
+    }
+
+    /**
+     * @brief Open a persistent DevTools connection to the session browser
+     */
+    auto openDevTools() -> std::unique_ptr<DevToolsSession> {
+        return std::make_unique<DevToolsSession>(devToolsWebSocketUrl());
     }
 
     void gotoUrl(const std::string &url) {
@@ -107,8 +265,10 @@ chrome=129.0.6668.70)", "stacktrace": "#0 0x5dd8a5bff10a \u003Cunknown>\n#1
 
         std::cout << reqStr << std::endl;
 
-        auto URL = webDriverUrl + "/session/" + sessionId + "/url";
-        callUrlDriver("POST", URL, reqStr);
+        switchContext("POST", sessionPath() + "/url", reqStr, [this, &url]() {
+            browsingContext.resetToTopLevel();
+            checkpoint.saveUrl(url);
+        });
     }
 
     void sendKeysToElement(const std::string &elementId,
@@ -120,7 +280,7 @@ chrome=129.0.6668.70)", "stacktrace": "#0 0x5dd8a5bff10a \u003Cunknown>\n#1
 
         std::cout << reqStr << std::endl;
 
-        auto URL = webDriverUrl + "/session/" + sessionId + "/element/" +
+        auto URL = webDriverUrl + sessionPath() + "/element/" +
                    elementId + "/value";
         callUrlDriver("POST", URL, reqStr);
     }
@@ -148,7 +308,7 @@ chrome=129.0.6668.70)", "stacktrace": "#0 0x5dd8a5bff10a \u003Cunknown>\n#1
 
         std::cout << reqStr << std::endl;
 
-        auto URL = webDriverUrl + "/session/" + sessionId + "/element";
+        auto URL = webDriverUrl + sessionPath() + "/element";
         return callUrlDriver("POST", URL, reqStr);
     }
 
@@ -163,10 +323,65 @@ chrome=129.0.6668.70)", "stacktrace": "#0 0x5dd8a5bff10a \u003Cunknown>\n#1
 
         auto reqStr = jsonToString(obj);
 
-        auto URL = webDriverUrl + "/session/" + sessionId + "/execute/sync";
+        auto URL = webDriverUrl + sessionPath() + "/execute/sync";
         return callUrlDriver("POST", URL, reqStr);
     }
 
+    /**
+     * @brief Every element of the current document with its attributes,
+     * visibility and bounding box, taken with a single script call
+     */
+    auto snapshotDom() -> DomSnapshot {
+        return DomSnapshot::decode(executeSyncScript(DomSnapshot::script()));
+    }
+
+    /**
+     * @brief Element reference of a snapshot node, valid while the document
+     * was not changed since the snapshot
+     */
+    auto snapshotElement(uint32_t node) -> Poco::Dynamic::Var {
+        return executeSyncScript(
+            "return document.getElementsByTagName('*')[arguments[0]];", node);
+    }
+
+    /**
+     * @brief Visible text blocks of the page with their bounding boxes,
+     * computed by a single script call and decoded from the raw response
+     */
+    auto extractText(const TextExtractionOptions &options = {}) -> PageText {
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("script", PageText::script());
+        obj->set("args", options.scriptArgs());
+
+        auto URL = webDriverUrl + sessionPath() + "/execute/sync";
+        auto res = sendRetried("POST", URL, jsonToString(obj));
+        std::string invalid;
+
+        if (res.ok() && res.code < 400) {
+            try {
+                return PageText::fromResponse(res.body);
+            } catch (const std::exception &e) {
+                invalid = e.what();
+            }
+        }
+
+        /*
+         Errors are only parsed as JSON when the records could not be read
+         */
+        auto result = commandResult(res);
+
+        if (result) {
+            result.error = ErrorCode::UnknownError;
+            result.message = invalid.empty()
+                                 ? "HTTP status " + std::to_string(res.code)
+                                 : invalid;
+        }
+
+        std::cerr << "Error: " << result.message << std::endl;
+        throw WebDriverError(result.error, result.message,
+                             result.errorString);
+    }
+
     auto submitElement(const Poco::Dynamic::Var &elementId) {
         std::string script = R"js(/* submitForm */var form = arguments[0];
 while (form.nodeName != "FORM" && form.parentNode) {
@@ -194,20 +409,43 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/se/file";
+        std::string path = sessionPath() + "/se/file";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
+    /**
+     * @brief Upload a local file to the driver machine. The file is zipped
+     * and base64 encoded while it is sent, memory use does not grow with the
+     * file size
+     * @return Path of the file on the driver machine, to type into an
+     * <input type="file">
+     */
+    auto uploadFileStreamed(const std::filesystem::path &file)
+        -> std::string {
+        ZipUploadBody body(file);
+        std::string path = sessionPath() + "/se/file";
+
+        auto result = sendBodyCommand("POST", webDriverUrl + path, body);
+
+        if (!result) {
+            std::cerr << "Error: " << result.message << std::endl;
+            throw WebDriverError(result.error, result.message,
+                                 result.errorString);
+        }
+
+        return result.value.toString();
+    }
+
     auto setUserVerified(const std::string &authenticatorId) {
-        std::string path = "/session/" + sessionId +
+        std::string path = sessionPath() +
                            "/webauthn/authenticator/" + authenticatorId + "/uv";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
     auto removeAllCredentials(const std::string &authenticatorId) {
-        std::string path = "/session/" + sessionId +
+        std::string path = sessionPath() +
                            "/webauthn/authenticator/" + authenticatorId +
                            "/credentials";
 
@@ -215,7 +453,7 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     }
 
     auto getCredentials(const std::string &authenticatorId) {
-        std::string path = "/session/" + sessionId +
+        std::string path = sessionPath() +
                            "/webauthn/authenticator/" + authenticatorId +
                            "/credentials";
 
@@ -223,7 +461,7 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     }
 
     auto addCredential(const std::string &authenticatorId) {
-        std::string path = "/session/" + sessionId +
+        std::string path = sessionPath() +
                            "/webauthn/authenticator/" + authenticatorId +
                            "/credential";
 
@@ -231,101 +469,229 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     }
 
     auto removeVirtualAuthenticator(const std::string &authenticatorId) {
-        std::string path = "/session/" + sessionId +
+        std::string path = sessionPath() +
                            "/webauthn/authenticator/" + authenticatorId;
 
         return callUrlDriver("DELETE", webDriverUrl + path, "{}");
     }
 
     auto printPage() {
-        std::string path = "/session/" + sessionId + "/print";
+        std::string path = sessionPath() + "/print";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
+    /**
+     * @brief Print the page to PDF
+     * @return The PDF in base64
+     */
+    auto printPage(const PrintOptions &options) -> Poco::Dynamic::Var {
+        std::string path = sessionPath() + "/print";
+
+        return callUrlDriver("POST", webDriverUrl + path, options.serialize());
+    }
+
+    /**
+     * @brief Print the page to PDF and write it to out, decoded while the
+     * response arrives instead of held as JSON, base64 and PDF copies
+     * @return Size of the PDF
+     */
+    auto printPageTo(const PrintOptions &options, std::ostream &out)
+        -> uint64_t {
+        std::string path = sessionPath() + "/print";
+
+        Base64StreamSink sink(out);
+        auto result = sendIntoCommand("POST", webDriverUrl + path,
+                                      options.serialize(), sink);
+
+        if (!result) {
+            std::cerr << "Error: " << result.message << std::endl;
+            throw WebDriverError(result.error, result.message,
+                                 result.errorString);
+        }
+
+        sink.finish();
+        return sink.bytesWritten();
+    }
+
+    /**
+     * @brief printPageTo() a new file, removed again when printing fails
+     */
+    auto printPageTo(const PrintOptions &options,
+                     const std::filesystem::path &file) -> uint64_t {
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+
+        if (!out) {
+            throw std::runtime_error("Fail to open " + file.string());
+        }
+
+        try {
+            return printPageTo(options, out);
+        } catch (...) {
+            out.close();
+            std::filesystem::remove(file);
+            throw;
+        }
+    }
+
     auto minimizeWindow() {
-        std::string path = "/session/" + sessionId + "/window/minimize";
+        std::string path = sessionPath() + "/window/minimize";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
     auto fullscreenWindow() {
-        std::string path = "/session/" + sessionId + "/window/fullscreen";
+        std::string path = sessionPath() + "/window/fullscreen";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
     auto getAvailableLogTypes() {
-        std::string path = "/session/" + sessionId + "/se/log/types";
+        std::string path = sessionPath() + "/se/log/types";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getLog() {
-        std::string path = "/session/" + sessionId + "/se/log";
+        std::string path = sessionPath() + "/se/log";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
     auto getNetworkConnection() {
-        std::string path = "/session/" + sessionId + "/network_connection";
+        std::string path = sessionPath() + "/network_connection";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getElementRect(const std::string &id) {
-        std::string path = "/session/" + sessionId + "/element/" + id + "/rect";
+        std::string path = sessionPath() + "/element/" + id + "/rect";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto isElementEnabled(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/enabled";
+        std::string path = sessionPath() + "/element/" + id + "/enabled";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
-    auto setTimeouts(const int implicit, const int pageLoad, const int script) {
-        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
-        obj->set("implicit", implicit);
-        obj->set("pageLoad", pageLoad);
-        obj->set("script", script);
+    /**
+     * @brief Only the values the driver may not have yet are sent, nothing
+     * when it has all three
+     */
+    auto setTimeouts(const int implicit, const int pageLoad, const int script)
+        -> Poco::Dynamic::Var {
+        SessionTimeouts::Values wanted{implicit, pageLoad, script};
+        sessionTimeouts.wantImplicit(implicit);
 
-        auto reqStr = jsonToString(obj);
+        return updateTimeouts(sessionTimeouts.changed(wanted));
+    }
 
-        std::string path = "/session/" + sessionId + "/timeouts";
+    /**
+     * @brief Implicit wait of the next element lookups. Sent right before
+     * the next one and only when the driver has another value, so toggling it
+     * around lookups costs no request when nothing is looked up in between
+     */
+    void setImplicitWait(std::chrono::milliseconds wait) {
+        sessionTimeouts.wantImplicit(wait.count());
+    }
 
-        return callUrlDriver("POST", webDriverUrl + path, reqStr);
+    /**
+     * @brief Implicit wait the next element lookup runs with, asks the driver
+     * when the session did not report it
+     */
+    auto implicitWait() -> std::chrono::milliseconds {
+        auto implicit = sessionTimeouts.current().implicit;
+
+        if (!implicit) {
+            getTimeouts();
+            implicit = sessionTimeouts.current().implicit;
+        }
+
+        if (!implicit) {
+            throw std::runtime_error("Fail to get the implicit wait");
+        }
+
+        return std::chrono::milliseconds(*implicit);
+    }
+
+    auto setPageLoadTimeout(std::chrono::milliseconds timeout)
+        -> Poco::Dynamic::Var {
+        SessionTimeouts::Values wanted;
+        wanted.pageLoad = timeout.count();
+
+        return updateTimeouts(sessionTimeouts.changed(wanted));
+    }
+
+    auto setScriptTimeout(std::chrono::milliseconds timeout)
+        -> Poco::Dynamic::Var {
+        SessionTimeouts::Values wanted;
+        wanted.script = timeout.count();
+
+        return updateTimeouts(sessionTimeouts.changed(wanted));
+    }
+
+    /**
+     * @brief Back to the timeouts the session started with, the implicit
+     * wait included, sending only the ones the driver does not have
+     */
+    auto resetTimeouts() -> Poco::Dynamic::Var {
+        auto defaults = sessionTimeouts.defaults();
+
+        if (defaults.implicit) {
+            sessionTimeouts.wantImplicit(*defaults.implicit);
+        }
+
+        return updateTimeouts(sessionTimeouts.changed(defaults));
     }
 
     auto getElementTagName(const std::string &id) {
-        std::string path = "/session/" + sessionId + "/element/" + id + "/name";
+        std::string path = sessionPath() + "/element/" + id + "/name";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
-    auto getTimeouts() {
-        std::string path = "/session/" + sessionId + "/timeouts";
+    /**
+     * @brief Answered from the cached timeouts when all three are known
+     */
+    auto getTimeouts() -> Poco::Dynamic::Var {
+        auto known = sessionTimeouts.current();
 
-        return callUrlDriver("GET", webDriverUrl + path);
+        if (known.complete()) {
+            return known.toJson();
+        }
+
+        auto value = callUrlDriver("GET", timeoutsUrl());
+
+        if (value.type() == typeid(Poco::JSON::Object::Ptr)) {
+            sessionTimeouts.learned(SessionTimeouts::Values::fromJson(
+                value.extract<Poco::JSON::Object::Ptr>()));
+        }
+
+        known = sessionTimeouts.current();
+
+        if (!known.complete()) {
+            return value;
+        }
+
+        return known.toJson();
     }
 
     auto getDownloadableFiles() {
-        std::string path = "/session/" + sessionId + "/se/files";
+        std::string path = sessionPath() + "/se/files";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto clickElement(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/click";
+        std::string path = sessionPath() + "/element/" + id + "/click";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
     auto screenshot() {
-        std::string path = "/session/" + sessionId + "/screenshot";
+        std::string path = sessionPath() + "/screenshot";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
@@ -339,25 +705,34 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/element";
+        std::string path = sessionPath() + "/element/" + id + "/element";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto w3cGetActiveElement() {
-        std::string path = "/session/" + sessionId + "/element/active";
+        std::string path = sessionPath() + "/element/active";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto elementScreenshot(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/screenshot";
+        std::string path = sessionPath() + "/element/" + id + "/screenshot";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
+    /**
+     * @brief Screenshot decoded to RGBA pixels, ready for ScreenshotDiff
+     */
+    auto screenshotImage() -> Image {
+        return Image::fromBase64Png(screenshot().toString());
+    }
+
+    auto elementScreenshotImage(const std::string &id) -> Image {
+        return Image::fromBase64Png(elementScreenshot(id).toString());
+    }
+
     auto findElements(const std::string &usingSelector,
                       const std::string &value) {
         Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
@@ -366,7 +741,7 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/elements";
+        std::string path = sessionPath() + "/elements";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
@@ -380,12 +755,123 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/elements";
+        std::string path = sessionPath() + "/element/" + id + "/elements";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
+    /**
+     * @brief findElements() as an ElementList, the ids are read from the
+     * response without a JSON object per element
+     */
+    auto findElementList(const std::string &usingSelector,
+                         const std::string &value) -> ElementList {
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("using", usingSelector);
+        obj->set("value", value);
+
+        std::string path = sessionPath() + "/elements";
+
+        return elementListResult(
+            sendRetried("POST", webDriverUrl + path, jsonToString(obj)));
+    }
+
+    auto findChildElementList(const std::string &id,
+                              const std::string &usingSelector,
+                              const std::string &value) -> ElementList {
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("using", usingSelector);
+        obj->set("value", value);
+
+        std::string path = sessionPath() + "/element/" + id + "/elements";
+
+        return elementListResult(
+            sendRetried("POST", webDriverUrl + path, jsonToString(obj)));
+    }
+
+    /**
+     * @brief Up to limit elements matching a CSS selector from offset, in
+     * document order, with the number of matches. The selector is run again
+     * for every page, elements added or removed in between shift the pages
+     */
+    auto findElementPage(const std::string &cssSelector, size_t offset,
+                         size_t limit) -> ElementPage {
+        static const std::string script = R"js(/* findElementPage */
+var all = document.querySelectorAll(arguments[0]);
+return {total: all.length,
+        elements: Array.prototype.slice.call(all, arguments[1],
+                                             arguments[1] + arguments[2])};
+)js";
+
+        Poco::JSON::Array::Ptr argsjs = new Poco::JSON::Array;
+        argsjs->add(cssSelector);
+        argsjs->add(static_cast<uint64_t>(offset));
+        argsjs->add(static_cast<uint64_t>(limit));
+
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("script", script);
+        obj->set("args", argsjs);
+
+        auto URL = webDriverUrl + sessionPath() + "/execute/sync";
+        auto res = sendRetried("POST", URL, jsonToString(obj));
+
+        ElementPage page;
+        page.offset = offset;
+        page.elements = elementListResult(res);
+
+        try {
+            page.total = ElementPage::parseTotal(res.body);
+        } catch (const std::invalid_argument &e) {
+            std::string message = std::string("Invalid response: ") + e.what();
+            std::cerr << "Error: " << message << std::endl;
+            throw WebDriverError(ErrorCode::UnknownError, message);
+        }
+
+        return page;
+    }
+
+    /**
+     * @brief Call fn with each page of pageSize elements matching a CSS
+     * selector, so a large match is never held whole. Stops early when fn
+     * returns false
+     * @return Elements passed to fn
+     */
+    template <class Fn>
+    auto forEachElementPage(const std::string &cssSelector, size_t pageSize,
+                            Fn &&fn) -> size_t {
+        if (pageSize == 0) {
+            throw std::invalid_argument("Page size must not be zero");
+        }
+
+        size_t offset = 0;
+
+        while (true) {
+            auto page = findElementPage(cssSelector, offset, pageSize);
+
+            if (page.elements.empty()) {
+                break;
+            }
+
+            offset += page.elements.size();
+
+            if constexpr (std::is_same_v<std::invoke_result_t<Fn &,
+                                                              ElementPage &>,
+                                         bool>) {
+                if (!fn(page)) {
+                    break;
+                }
+            } else {
+                fn(page);
+            }
+
+            if (!page.hasMore()) {
+                break;
+            }
+        }
+
+        return offset;
+    }
+
     auto findElement(const std::string &usingSelector,
                      const std::string &value) {
         Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
@@ -394,13 +880,30 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/element";
+        std::string path = sessionPath() + "/element";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
+    /**
+     * @brief findElement for polling loops, a missing element is reported as
+     * ErrorCode::NoSuchElement instead of an exception
+     */
+    auto tryFindElement(const std::string &usingSelector,
+                        const std::string &value) -> CommandResult {
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("using", usingSelector);
+        obj->set("value", value);
+
+        auto reqStr = jsonToString(obj);
+
+        std::string path = sessionPath() + "/element";
+
+        return tryCallUrlDriver("POST", webDriverUrl + path, reqStr);
+    }
+
     auto addVirtualAuthenticator() {
-        std::string path = "/session/" + sessionId + "/webauthn/authenticator";
+        std::string path = sessionPath() + "/webauthn/authenticator";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
@@ -411,14 +914,13 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/alert/text";
+        std::string path = sessionPath() + "/alert/text";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getElementAriaRole(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/computedrole";
+        std::string path = sessionPath() + "/element/" + id + "/computedrole";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
@@ -430,21 +932,20 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     }
 
     auto isElementSelected(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/selected";
+        std::string path = sessionPath() + "/element/" + id + "/selected";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getCookie(const std::string &name) {
-        std::string path = "/session/" + sessionId + "/cookie/" + name;
+        std::string path = sessionPath() + "/cookie/" + name;
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto removeCredential(const std::string &authenticatorId,
                           const std::string &credentialId) {
-        std::string path = "/session/" + sessionId +
+        std::string path = sessionPath() +
                            "/webauthn/authenticator/" + authenticatorId +
                            "/credentials/" + credentialId;
 
@@ -452,31 +953,48 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     }
 
     auto w3cGetCurrentWindowHandle() {
-        std::string path = "/session/" + sessionId + "/window";
+        std::string path = sessionPath() + "/window";
 
-        return callUrlDriver("GET", webDriverUrl + path);
+        auto handle = callUrlDriver("GET", webDriverUrl + path);
+        browsingContext.learnedWindow(handle.toString());
+        return handle;
+    }
+
+    /**
+     * @brief Handle of the current window, asks the driver only when it is
+     * not known yet
+     */
+    auto currentWindowHandle() -> std::string {
+        auto handle = browsingContext.windowHandle();
+
+        if (handle) {
+            return *handle;
+        }
+
+        return w3cGetCurrentWindowHandle().toString();
     }
 
     auto w3cDismissAlert() {
-        std::string path = "/session/" + sessionId + "/alert/dismiss";
+        std::string path = sessionPath() + "/alert/dismiss";
 
         return callUrlDriver("POST", webDriverUrl + path, "{}");
     }
 
     auto goBack() {
-        std::string path = "/session/" + sessionId + "/back";
+        std::string path = sessionPath() + "/back";
 
-        return callUrlDriver("POST", webDriverUrl + path, "{}");
+        return switchContext("POST", path, "{}",
+                             [this]() { browsingContext.forgetFrames(); });
     }
 
     auto w3cGetWindowHandles() {
-        std::string path = "/session/" + sessionId + "/window/handles";
+        std::string path = sessionPath() + "/window/handles";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getCurrentContextHandle() {
-        std::string path = "/session/" + sessionId + "/context";
+        std::string path = sessionPath() + "/context";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
@@ -487,27 +1005,30 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/orientation";
+        std::string path = sessionPath() + "/orientation";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto goForward() {
-        std::string path = "/session/" + sessionId + "/forward";
+        std::string path = sessionPath() + "/forward";
 
-        return callUrlDriver("POST", webDriverUrl + path, "{}");
+        return switchContext("POST", path, "{}",
+                             [this]() { browsingContext.forgetFrames(); });
     }
 
     auto close() {
-        std::string path = "/session/" + sessionId + "/window";
+        std::string path = sessionPath() + "/window";
 
-        return callUrlDriver("DELETE", webDriverUrl + path, "{}");
+        return switchContext("DELETE", path, "{}",
+                             [this]() { browsingContext.forget(); });
     }
 
     auto refresh() {
-        std::string path = "/session/" + sessionId + "/refresh";
+        std::string path = sessionPath() + "/refresh";
 
-        return callUrlDriver("POST", webDriverUrl + path, "{}");
+        return switchContext("POST", path, "{}",
+                             [this]() { browsingContext.resetToTopLevel(); });
     }
 
     auto switchToContext(const std::string &name) {
@@ -516,19 +1037,19 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/context";
+        std::string path = sessionPath() + "/context";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getWindowRect() {
-        std::string path = "/session/" + sessionId + "/window/rect";
+        std::string path = sessionPath() + "/window/rect";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getCurrentUrl() {
-        std::string path = "/session/" + sessionId + "/url";
+        std::string path = sessionPath() + "/url";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
@@ -544,13 +1065,13 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/execute/sync";
+        std::string path = sessionPath() + "/execute/sync";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getElementText(const std::string &id) {
-        std::string path = "/session/" + sessionId + "/element/" + id + "/text";
+        std::string path = sessionPath() + "/element/" + id + "/text";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
@@ -572,47 +1093,227 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/execute/async";
+        std::string path = sessionPath() + "/execute/async";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getTitle() {
-        std::string path = "/session/" + sessionId + "/title";
+        std::string path = sessionPath() + "/title";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
-    auto get(const std::string &url) {
+    auto get(const std::string &url) -> Poco::Dynamic::Var {
         Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
         obj->set("url", url);
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/url";
-        return callUrlDriver("POST", webDriverUrl + path, reqStr);
+        std::string path = sessionPath() + "/url";
+        return switchContext("POST", path, reqStr, [this, &url]() {
+            browsingContext.resetToTopLevel();
+            checkpoint.saveUrl(url);
+        });
+    }
+
+    /**
+     * @brief GET /status, then the session URL, which the browser answers
+     * without running anything in the page. The URL goes to the checkpoint
+     */
+    auto checkHealth() -> SessionHealth {
+        if (!sendCommand("GET", webDriverUrl + "/status")) {
+            return SessionHealth::DriverDown;
+        }
+
+        auto ping = sendCommand("GET", webDriverUrl + sessionPath() + "/url");
+
+        if (ping) {
+            if (ping.value.isString()) {
+                checkpoint.saveUrl(ping.value.toString());
+            }
+
+            return SessionHealth::Alive;
+        }
+
+        if (isSessionLost(ping)) {
+            return SessionHealth::SessionLost;
+        }
+
+        return ping.error == ErrorCode::Transport ? SessionHealth::DriverDown
+                                                  : SessionHealth::Alive;
+    }
+
+    /**
+     * @brief Errors of a command sent to a session that is gone, chromedriver
+     * reports a crashed browser as an unknown error at first
+     */
+    static auto isSessionLost(const CommandResult &result) -> bool {
+        if (result.error == ErrorCode::InvalidSessionId) {
+            return true;
+        }
+
+        if (result.error != ErrorCode::UnknownError) {
+            return false;
+        }
+
+        for (const char *sign : {"session deleted", "chrome not reachable",
+                                 "not connected to DevTools"}) {
+            if (result.message.find(sign) != std::string::npos) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Save the current page, and the cookies of every domain with
+     * recovery.restoreCookies, for a recovered session to start from
+     */
+    void saveCheckpoint() {
+        checkpoint.saveUrl(getCurrentUrl().toString());
+
+        if (recovery.restoreCookies) {
+            checkpoint.saveCookies(exportCookies());
+        }
+    }
+
+    /**
+     * @brief Replace a lost session with a new one from the same session
+     * request, restore the checkpoint as set in recovery and report the
+     * outcome to recovery.onRecovery
+     * @param[in] lostSessionId Session the failed command went to, nothing
+     * is done when another thread already replaced it
+     * @return Whether a new session was created, false also when a recovery
+     * is already running
+     */
+    auto recoverSession(const std::string &reason,
+                        const std::string &lostSessionId) -> bool {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        using std::chrono::steady_clock;
+
+        if (!checkpoint.beginRecovery()) {
+            return false;
+        }
+
+        RecoveryEvent event;
+        event.previousSessionId = sessionId();
+        event.reason = reason;
+
+        if (event.previousSessionId != lostSessionId) {
+            checkpoint.endRecovery();
+            return false;
+        }
+
+        auto started = steady_clock::now();
+        auto request = session.request();
+
+        /*
+         The driver may still hold the session of a crashed browser
+         */
+        sendCommand("DELETE",
+                    webDriverUrl + "/session/" + event.previousSessionId);
+
+        if (request.empty()) {
+            event.error = "Session was not started with connect()";
+        }
+
+        /*
+         connectSerialized() starts the cache over from the new session
+         */
+        auto timeouts = sessionTimeouts.current();
+        auto attempts = std::max(recovery.maxAttempts, 1U);
+
+        for (unsigned attempt = 1;
+             event.error.empty() && attempt <= attempts; attempt++) {
+            event.attempts = attempt;
+
+            try {
+                connectSerialized(request);
+                break;
+            } catch (const std::exception &e) {
+                event.error = e.what();
+            }
+
+            if (attempt < attempts) {
+                event.error.clear();
+                std::this_thread::sleep_for(recovery.retryDelay);
+            }
+        }
+
+        if (event.succeeded()) {
+            event.sessionId = sessionId();
+
+            try {
+                restoreCheckpoint(event, timeouts);
+            } catch (const std::exception &e) {
+                event.restoreError = e.what();
+            }
+        }
+
+        event.duration =
+            duration_cast<microseconds>(steady_clock::now() - started);
+        checkpoint.endRecovery();
+
+        if (event.succeeded()) {
+            std::cerr << "Recovered session " << event.previousSessionId
+                      << " as " << event.sessionId << ": " << reason
+                      << std::endl;
+        } else {
+            std::cerr << "Fail to recover session " << event.previousSessionId
+                      << ": " << event.error << std::endl;
+        }
+
+        if (recovery.onRecovery) {
+            recovery.onRecovery(event);
+        }
+
+        return event.succeeded();
+    }
+
+    /**
+     * @brief Recover the current session, see recoverSession()
+     */
+    auto recoverSession(const std::string &reason) -> bool {
+        return recoverSession(reason, sessionId());
     }
 
     auto getElementAriaLabel(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/computedlabel";
+        std::string path = sessionPath() + "/element/" + id + "/computedlabel";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getPageSource() {
-        std::string path = "/session/" + sessionId + "/source";
+        std::string path = sessionPath() + "/source";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
+    /**
+     * @brief Save a screenshot of the current page in the store
+     */
+    auto storeScreenshot(ArtifactStore &store) -> ArtifactRecord {
+        auto url = getCurrentUrl().toString();
+        return store.appendBase64(sessionId(), url, ArtifactType::Screenshot,
+                                  screenshot().toString());
+    }
+
+    auto storePageSource(ArtifactStore &store) -> ArtifactRecord {
+        auto url = getCurrentUrl().toString();
+        return store.append(sessionId(), url, ArtifactType::PageSource,
+                            getPageSource().toString());
+    }
+
     auto newWindow(const std::string &type) {
         Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
         obj->set("type", type);
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/window/new";
+        std::string path = sessionPath() + "/window/new";
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
@@ -625,29 +1326,75 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/window/rect";
+        std::string path = sessionPath() + "/window/rect";
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getShadowRoot(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/shadow";
+        std::string path = sessionPath() + "/element/" + id + "/shadow";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
-    auto switchToFrame(const Poco::Dynamic::Var &frameId) {
+    /**
+     * @brief Enter frameId from the current document, a null id selects the
+     * top level document and is skipped when already there
+     */
+    auto switchToFrame(const Poco::Dynamic::Var &frameId)
+        -> Poco::Dynamic::Var {
+        if (frameId.isEmpty() && browsingContext.atTopLevel()) {
+            return {};
+        }
+
         Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
         obj->set("id", frameId);
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/frame";
-        return callUrlDriver("POST", webDriverUrl + path, reqStr);
+        std::string path = sessionPath() + "/frame";
+        return switchContext("POST", path, reqStr, [this, &frameId]() {
+            browsingContext.enteredFrame(frameId);
+        });
+    }
+
+    auto switchToDefaultContent() -> Poco::Dynamic::Var {
+        return switchToFrame(Poco::Dynamic::Var());
+    }
+
+    /**
+     * @brief Select the frame reached by entering each id of path from the
+     * top level document. Only the switches below the frames shared with the
+     * current path are sent, climbing with parent frame or restarting from
+     * the top, whichever takes fewer commands
+     */
+    void switchToFramePath(const BrowsingContext::frame_path_t &path) {
+        auto current = browsingContext.framePath();
+        size_t common = 0;
+
+        if (current) {
+            while (common < current->size() && common < path.size() &&
+                   BrowsingContext::frameKey((*current)[common]) ==
+                       BrowsingContext::frameKey(path[common])) {
+                common++;
+            }
+        }
+
+        if (current && current->size() - common <= 1 + common) {
+            for (size_t i = common; i < current->size(); i++) {
+                switchToParentFrame();
+            }
+        } else {
+            switchToDefaultContent();
+            common = 0;
+        }
+
+        for (size_t i = common; i < path.size(); i++) {
+            switchToFrame(path[i]);
+        }
     }
 
     auto clearActionState() {
-        std::string path = "/session/" + sessionId + "/actions";
+        std::string path = sessionPath() + "/actions";
 
         return callUrlDriver("DELETE", webDriverUrl + path);
     }
@@ -661,26 +1408,25 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path =
-            "/session/" + sessionId + "/shadow/" + shadowId + "/element";
+        std::string path = sessionPath() + "/shadow/" + shadowId + "/element";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getCookies() {
-        std::string path = "/session/" + sessionId + "/cookie";
+        std::string path = sessionPath() + "/cookie";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto deleteCookie(const std::string &name) {
-        std::string path = "/session/" + sessionId + "/cookie/" + name;
+        std::string path = sessionPath() + "/cookie/" + name;
 
         return callUrlDriver("DELETE", webDriverUrl + path);
     }
 
     auto deleteDownloadableFiles() {
-        std::string path = "/session/" + sessionId + "/se/files";
+        std::string path = sessionPath() + "/se/files";
 
         return callUrlDriver("DELETE", webDriverUrl + path);
     }
@@ -694,53 +1440,368 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path =
-            "/session/" + sessionId + "/shadow/" + shadowId + "/elements";
+        std::string path = sessionPath() + "/shadow/" + shadowId + "/elements";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
+    /**
+     * @brief Split a deep selector, CSS selectors joined by ">>>" where each
+     * next one is matched in the shadow roots of the elements of the one
+     * before, e.g. "app-shell >>> nav-menu >>> button.open"
+     */
+    static auto splitDeepSelector(std::string_view selector)
+        -> std::vector<std::string> {
+        constexpr std::string_view separator = ">>>";
+        constexpr std::string_view spaces = " \t\n\r";
+        std::vector<std::string> parts;
+
+        while (true) {
+            auto end = selector.find(separator);
+            auto part = selector.substr(0, end);
+            auto first = part.find_first_not_of(spaces);
+
+            if (first == std::string_view::npos) {
+                throw std::invalid_argument("Empty selector in deep selector");
+            }
+
+            auto length = part.find_last_not_of(spaces) + 1 - first;
+            parts.emplace_back(part.substr(first, length));
+
+            if (end == std::string_view::npos) {
+                return parts;
+            }
+
+            selector.remove_prefix(end + separator.size());
+        }
+    }
+
+    /**
+     * @brief Every element matching a deep selector (see splitDeepSelector())
+     * in document order, from a single script call. Closed shadow roots are
+     * invisible to scripts: when nothing was found and a custom element
+     * without an open shadow root matched on the way, the per-level
+     * endpoints are used instead. The implicit wait does not apply
+     */
+    auto findDeepElements(const std::string &deepSelector) -> ElementList {
+        return findDeepElements(splitDeepSelector(deepSelector), false);
+    }
+
+    /**
+     * @brief First element of findDeepElements(), throws WebDriverError with
+     * ErrorCode::NoSuchElement when none matches
+     * @return Element reference, as returned by findElement()
+     */
+    auto findDeepElement(const std::string &deepSelector)
+        -> Poco::Dynamic::Var {
+        auto found = findDeepElements(splitDeepSelector(deepSelector), true);
+
+        if (found.empty()) {
+            std::string message = "No element matches " + deepSelector;
+            std::cerr << "Error: " << message << std::endl;
+            throw WebDriverError(ErrorCode::NoSuchElement, message);
+        }
+
+        return found.reference(0);
+    }
+
+    auto findDeepElements(const std::vector<std::string> &parts,
+                          bool firstOnly) -> ElementList {
+        static const std::string script = R"js(/* findDeepElements */
+var parts = arguments[0], firstOnly = arguments[1];
+var scopes = [document], closed = false;
+for (var i = 0; i < parts.length; i++) {
+  var last = i + 1 === parts.length, next = [];
+  for (var j = 0; j < scopes.length; j++) {
+    var matches = scopes[j].querySelectorAll(parts[i]);
+    for (var k = 0; k < matches.length; k++) {
+      if (last) {
+        next.push(matches[k]);
+        if (firstOnly) { return next; }
+      } else if (matches[k].shadowRoot) {
+        next.push(matches[k].shadowRoot);
+      } else if (matches[k].localName.indexOf('-') > 0) {
+        closed = true;
+      }
+    }
+  }
+  scopes = next;
+}
+return scopes.length === 0 && closed ? null : scopes;
+)js";
+
+        Poco::JSON::Array::Ptr partsjs = new Poco::JSON::Array;
+
+        for (const auto &part : parts) {
+            partsjs->add(part);
+        }
+
+        Poco::JSON::Array::Ptr argsjs = new Poco::JSON::Array;
+        argsjs->add(partsjs);
+        argsjs->add(firstOnly);
+
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("script", script);
+        obj->set("args", argsjs);
+
+        auto URL = webDriverUrl + sessionPath() + "/execute/sync";
+
+        try {
+            auto res = sendRetried("POST", URL, jsonToString(obj));
+            auto found = elementListResult(res);
+
+            /*
+             null asks for the per-level endpoints
+             */
+            if (!found.empty() || !commandResult(res).value.isEmpty()) {
+                return found;
+            }
+        } catch (const WebDriverError &e) {
+            if (e.code != ErrorCode::JavascriptError &&
+                e.code != ErrorCode::UnsupportedOperation) {
+                throw;
+            }
+
+            std::cerr << "Deep query script failed, querying each level: "
+                      << e.message << std::endl;
+        }
+
+        return findDeepElementsPerLevel(parts, firstOnly);
+    }
+
+    /**
+     * @brief The deep query through findElements, getShadowRoot and
+     * findElementsFromShadowRoot, one request per host and level but able to
+     * enter closed shadow roots
+     */
+    auto findDeepElementsPerLevel(const std::vector<std::string> &parts,
+                                  bool firstOnly) -> ElementList {
+        constexpr std::string_view shadowRootKey =
+            "shadow-6066-11e4-a52e-4f735466cecf";
+
+        auto locator = [this](const std::string &css) {
+            Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+            obj->set("using", "css selector");
+            obj->set("value", css);
+            return jsonToString(obj);
+        };
+
+        auto sessionUrl = webDriverUrl + sessionPath();
+        auto found = elementListResult(sendRetried(
+            "POST", sessionUrl + "/elements", locator(parts[0])));
+
+        for (size_t level = 1; level < parts.size(); level++) {
+            bool last = level + 1 == parts.size();
+            auto body = locator(parts[level]);
+            ElementList next;
+
+            for (auto host : found) {
+                auto root = tryCallUrlDriver(
+                    "GET",
+                    sessionUrl + "/element/" + std::string(host) + "/shadow");
+
+                if (root.error == ErrorCode::NoSuchShadowRoot) {
+                    continue;
+                }
+
+                auto shadowId = root.valueOrThrow()
+                                    .extract<Poco::JSON::Object::Ptr>()
+                                    ->getValue<std::string>(
+                                        std::string(shadowRootKey));
+
+                next.append(elementListResult(sendRetried(
+                    "POST", sessionUrl + "/shadow/" + shadowId + "/elements",
+                    body)));
+
+                if (last && firstOnly && !next.empty()) {
+                    break;
+                }
+            }
+
+            found = std::move(next);
+        }
+
+        return found;
+    }
+
     auto addCookie(const Poco::JSON::Object::Ptr &cookieJson) {
         auto reqStr = jsonToString(cookieJson);
 
-        std::string path = "/session/" + sessionId + "/cookie";
+        std::string path = sessionPath() + "/cookie";
+        return callUrlDriver("POST", webDriverUrl + path, reqStr);
+    }
+
+    auto addCookie(const Cookie &cookie) { return addCookie(cookie.toJson()); }
+
+    /**
+     * @brief Chrome specific, runs a Chrome DevTools Protocol command through
+     * the chromedriver HTTP endpoint
+     */
+    auto executeCdpCommand(const std::string &cmd,
+                           const Poco::JSON::Object::Ptr &params = {})
+        -> Poco::Dynamic::Var {
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("cmd", cmd);
+
+        if (params.isNull()) {
+            obj->set("params",
+                     Poco::JSON::Object::Ptr(new Poco::JSON::Object()));
+        } else {
+            obj->set("params", params);
+        }
+
+        auto reqStr = jsonToString(obj);
+
+        std::string path = sessionPath() + "/goog/cdp/execute";
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
+    /**
+     * @brief Whether a failed CDP command means the driver has no CDP
+     * endpoint. Any other failure keeps cdpAvailable set
+     */
+    static auto cdpUnsupported(const std::exception &e) -> bool {
+        const auto *error = dynamic_cast<const WebDriverError *>(&e);
+
+        return error != nullptr &&
+               (error->code == ErrorCode::UnknownCommand ||
+                error->code == ErrorCode::UnknownMethod ||
+                error->code == ErrorCode::UnsupportedOperation);
+    }
+
+    /**
+     * @brief Restore many cookies at once. Uses a single CDP
+     * Network.setCookies call when the driver supports it, otherwise one
+     * addCookie per cookie
+     */
+    void setCookies(std::span<const Cookie> cookies) {
+        if (cookies.empty()) {
+            return;
+        }
+
+        bool allHaveDomain =
+            std::all_of(cookies.begin(), cookies.end(),
+                        [](const Cookie &c) { return !c.domain.empty(); });
+
+        if (cdpAvailable && allHaveDomain) {
+            Poco::JSON::Array::Ptr cdpCookies = new Poco::JSON::Array;
+            for (const auto &cookie : cookies) {
+                cdpCookies->add(cookie.toCdpJson());
+            }
+
+            Poco::JSON::Object::Ptr params = new Poco::JSON::Object();
+            params->set("cookies", cdpCookies);
+
+            try {
+                executeCdpCommand("Network.setCookies", params);
+                return;
+            } catch (const std::exception &e) {
+                std::cerr << "CDP unavailable, falling back to addCookie: "
+                          << e.what() << std::endl;
+                cdpAvailable = !cdpUnsupported(e);
+            }
+        }
+
+        /*
+         Sequential, the commands of one session are handled one at a time by
+         the driver anyway
+         */
+        for (const auto &cookie : cookies) {
+            addCookie(cookie);
+        }
+    }
+
+    /**
+     * @brief Export every cookie of the browser, from all domains when CDP
+     * is available or from the current document otherwise
+     */
+    auto exportCookies() -> std::vector<Cookie> {
+        std::vector<Cookie> result;
+
+        if (cdpAvailable) {
+            try {
+                auto res = executeCdpCommand("Network.getAllCookies")
+                               .extract<Poco::JSON::Object::Ptr>();
+                auto cdpCookies = res->getArray("cookies");
+
+                result.reserve(cdpCookies->size());
+                for (unsigned int i = 0; i < cdpCookies->size(); i++) {
+                    result.push_back(
+                        Cookie::fromCdpJson(cdpCookies->getObject(i)));
+                }
+                return result;
+            } catch (const std::exception &e) {
+                std::cerr << "CDP unavailable, falling back to getCookies: "
+                          << e.what() << std::endl;
+                cdpAvailable = !cdpUnsupported(e);
+                result.clear();
+            }
+        }
+
+        auto cookies = getCookies().extract<Poco::JSON::Array::Ptr>();
+
+        result.reserve(cookies->size());
+        for (unsigned int i = 0; i < cookies->size(); i++) {
+            result.push_back(Cookie::fromJson(cookies->getObject(i)));
+        }
+
+        return result;
+    }
+
     auto getElementAttribute(const std::string &id, const std::string &name) {
         std::string path =
-            "/session/" + sessionId + "/element/" + id + "/attribute/" + name;
+            sessionPath() + "/element/" + id + "/attribute/" + name;
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto getElementProperty(const std::string &id, const std::string &name) {
         std::string path =
-            "/session/" + sessionId + "/element/" + id + "/property/" + name;
+            sessionPath() + "/element/" + id + "/property/" + name;
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto quit() {
-        std::string path = "/session/" + sessionId;
+        std::string path = sessionPath();
 
-        return callUrlDriver("DELETE", webDriverUrl + path);
+        return switchContext("DELETE", path, "",
+                             [this]() { browsingContext.forget(); });
     }
 
-    auto switchToParentFrame() {
-        std::string path = "/session/" + sessionId + "/frame/parent";
+    /**
+     * @brief Skipped in the top level document, where it changes nothing
+     */
+    auto switchToParentFrame() -> Poco::Dynamic::Var {
+        if (browsingContext.atTopLevel()) {
+            return {};
+        }
+
+        std::string path = sessionPath() + "/frame/parent";
 
-        return callUrlDriver("POST", webDriverUrl + path);
+        return switchContext("POST", path, "{}",
+                             [this]() { browsingContext.leftFrame(); });
     }
 
-    auto switchToWindow(const std::string &handle) {
+    /**
+     * @brief Select the top level document of the window, skipped when it
+     * is already selected
+     */
+    auto switchToWindow(const std::string &handle) -> Poco::Dynamic::Var {
+        if (browsingContext.windowHandle() == handle &&
+            browsingContext.atTopLevel()) {
+            return {};
+        }
+
         Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
         obj->set("handle", handle);
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/window";
-        return callUrlDriver("POST", webDriverUrl + path, reqStr);
+        std::string path = sessionPath() + "/window";
+        return switchContext("POST", path, reqStr, [this, &handle]() {
+            browsingContext.enteredWindow(handle);
+        });
     }
 
     auto setNetworkConnection(int connectionType) {
@@ -749,12 +1810,12 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/network_connection";
+        std::string path = sessionPath() + "/network_connection";
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getScreenOrientation() {
-        std::string path = "/session/" + sessionId + "/orientation";
+        std::string path = sessionPath() + "/orientation";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
@@ -770,20 +1831,19 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/execute_async";
+        std::string path = sessionPath() + "/execute_async";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto getContextHandles() {
-        std::string path = "/session/" + sessionId + "/contexts";
+        std::string path = sessionPath() + "/contexts";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto clearElement(const std::string &id) {
-        std::string path =
-            "/session/" + sessionId + "/element/" + id + "/clear";
+        std::string path = sessionPath() + "/element/" + id + "/clear";
 
         return callUrlDriver("POST", webDriverUrl + path);
     }
@@ -791,13 +1851,13 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     auto getElementValueOfCssProperty(const std::string &id,
                                       const std::string &propertyName) {
         std::string path =
-            "/session/" + sessionId + "/element/" + id + "/css/" + propertyName;
+            sessionPath() + "/element/" + id + "/css/" + propertyName;
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto w3cAcceptAlert() {
-        std::string path = "/session/" + sessionId + "/alert/accept";
+        std::string path = sessionPath() + "/alert/accept";
 
         return callUrlDriver("POST", webDriverUrl + path);
     }
@@ -808,19 +1868,107 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
 
         auto reqStr = jsonToString(obj);
 
-        std::string path = "/session/" + sessionId + "/se/files";
+        std::string path = sessionPath() + "/se/files";
 
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
+    /**
+     * @brief Download a file of the session to out. The response is decoded
+     * and unzipped while it arrives, memory use does not grow with the file
+     * size
+     * @return Name of the file
+     */
+    auto downloadFileTo(const std::string &fileId, std::ostream &out)
+        -> std::string {
+        Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+        obj->set("fileId", fileId);
+
+        auto reqStr = jsonToString(obj);
+        auto url = webDriverUrl + sessionPath() + "/se/files";
+
+        ZipDownloadSink sink(out);
+        auto result = sendIntoCommand("POST", url, reqStr, sink);
+
+        if (!result) {
+            std::cerr << "Error: " << result.message << std::endl;
+            throw WebDriverError(result.error, result.message,
+                                 result.errorString);
+        }
+
+        sink.finish();
+        return sink.fileName();
+    }
+
+    /**
+     * @brief downloadFileTo() a new file, removed again when the download
+     * fails
+     */
+    auto downloadFileTo(const std::string &fileId,
+                        const std::filesystem::path &file) -> std::string {
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+
+        if (!out) {
+            throw std::runtime_error("Fail to open " + file.string());
+        }
+
+        try {
+            return downloadFileTo(fileId, out);
+        } catch (...) {
+            out.close();
+            std::filesystem::remove(file);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Download files of the session into directory, each one named
+     * after its id, one after the other. SessionPool::downloadFiles spreads
+     * downloads across sessions
+     * @return Paths written, in the order of fileIds
+     */
+    auto downloadFilesTo(const std::vector<std::string> &fileIds,
+                         const std::filesystem::path &directory)
+        -> std::vector<std::filesystem::path> {
+        std::vector<std::filesystem::path> paths;
+        paths.reserve(fileIds.size());
+
+        for (const auto &fileId : fileIds) {
+            paths.push_back(directory /
+                            std::filesystem::path(fileId).filename());
+        }
+
+        for (size_t i = 0; i < fileIds.size(); i++) {
+            downloadFileTo(fileIds[i], paths[i]);
+        }
+
+        return paths;
+    }
+
+    /**
+     * @brief Download every file listed by getDownloadableFiles()
+     */
+    auto downloadFilesTo(const std::filesystem::path &directory)
+        -> std::vector<std::filesystem::path> {
+        auto files = getDownloadableFiles().extract<Poco::JSON::Object::Ptr>();
+        auto names = files->getArray("names");
+        std::vector<std::string> fileIds;
+
+        for (unsigned int i = 0; names && i < names->size(); i++) {
+            fileIds.push_back(names->getElement<std::string>(i));
+        }
+
+        return downloadFilesTo(fileIds, directory);
+    }
+
     auto w3cGetAlertText() {
-        std::string path = "/session/" + sessionId + "/alert/text";
+        std::string path = sessionPath() + "/alert/text";
 
         return callUrlDriver("GET", webDriverUrl + path);
     }
 
     auto deleteAllCookies() {
-        std::string path = "/session/" + sessionId + "/cookie";
+        std::string path = sessionPath() + "/cookie";
 
         return callUrlDriver("DELETE", webDriverUrl + path);
     }
@@ -828,57 +1976,541 @@ if (form.dispatchEvent(e)) { HTMLFormElement.prototype.submit.call(form); }
     auto actions(const Poco::JSON::Object::Ptr &actionsJson) {
         auto reqStr = jsonToString(actionsJson);
 
-        std::string path = "/session/" + sessionId + "/actions";
+        std::string path = sessionPath() + "/actions";
         return callUrlDriver("POST", webDriverUrl + path, reqStr);
     }
 
     auto w3cMaximizeWindow() {
-        std::string path = "/session/" + sessionId + "/window/maximize";
+        std::string path = sessionPath() + "/window/maximize";
 
         return callUrlDriver("POST", webDriverUrl + path);
     }
 
-    auto callUrlDriver(const std::string &verb, const std::string &url,
-                       const std::string &body = "") -> Poco::Dynamic::Var {
-        auto &req = CurlRAII::instance();
+    auto activeTransport() const -> std::shared_ptr<Transport> {
+        return transport ? transport : Transport::defaultTransport();
+    }
+
+    /**
+     * @brief Send one request and report WebDriver and transport errors in
+     * the result instead of throwing
+     */
+    auto sendCommand(const std::string &verb, const std::string &url,
+                     const std::string &body = "") -> CommandResult {
+        return commandResult(sendRequest(verb, url, body));
+    }
 
-        auto res =
-            body.empty() ? req.request(verb, url) : req.postJson(url, body);
+    /**
+     * @brief Send one request and return the response as is. An element
+     * lookup is preceded by the implicit wait update it needs, whose failure
+     * is returned instead
+     */
+    auto sendRequest(const std::string &verb, const std::string &url,
+                     const std::string &body = "") -> HttpResponse {
+        if (verb == "POST" && locatesElements(url)) {
+            if (auto implicit = sessionTimeouts.pendingImplicit()) {
+                SessionTimeouts::Values values;
+                values.implicit = implicit;
 
-        std::cout << "Response: " << res.buffer << std::endl;
+                auto res = activeTransport()->send(
+                    "POST", timeoutsUrl(), jsonToString(values.toJson()));
 
-        if (res.curl_perfm_res != CURLE_OK) {
-            throw std::runtime_error("Error: " + std::string(curl_easy_strerror(
-                                                     res.curl_perfm_res)));
+                if (!commandResult(res)) {
+                    sessionTimeouts.forget();
+                    return res;
+                }
+
+                sessionTimeouts.learned(values);
+            }
         }
 
-        if (res.buffer.empty()) {
+        return activeTransport()->send(verb, url, body);
+    }
+
+    /**
+     * @brief Find element commands, the ones the implicit wait applies to
+     */
+    static auto locatesElements(std::string_view url) -> bool {
+        return url.ends_with("/element") || url.ends_with("/elements");
+    }
+
+    auto timeoutsUrl() const -> std::string {
+        return webDriverUrl + sessionPath() + "/timeouts";
+    }
+
+    /**
+     * @brief Send timeouts known to differ, the cache forgets them all when
+     * the driver refuses
+     */
+    auto updateTimeouts(const SessionTimeouts::Values &values)
+        -> Poco::Dynamic::Var {
+        if (values.empty()) {
             return {};
         }
 
-        Poco::JSON::Object::Ptr resObj =
-            Poco::JSON::Parser()
-                .parse(res.buffer)
-                .extract<Poco::JSON::Object::Ptr>();
+        Poco::Dynamic::Var value;
+
+        try {
+            value = callUrlDriver("POST", timeoutsUrl(),
+                                  jsonToString(values.toJson()));
+        } catch (...) {
+            sessionTimeouts.forget();
+            throw;
+        }
+
+        sessionTimeouts.learned(values);
+        return value;
+    }
+
+    /**
+     * @brief Check a response holding element references, the JSON tree is
+     * only built for errors and empty results, which may hide an error
+     */
+    auto elementListResult(const HttpResponse &res) -> ElementList {
+        ElementList list;
+
+        if (res.ok() && res.code < 400) {
+            try {
+                list = ElementList::parse(res.body);
+            } catch (const std::invalid_argument &e) {
+                std::string message = std::string("Invalid response: ") +
+                                      e.what();
+                std::cerr << "Error: " << message << std::endl;
+                throw WebDriverError(ErrorCode::UnknownError, message);
+            }
+
+            if (!list.empty()) {
+                return list;
+            }
+        }
 
-        analyzeError(resObj);
+        auto result = commandResult(res);
 
-        return resObj->get("value");
+        if (result && res.code >= 400) {
+            result.error = ErrorCode::UnknownError;
+            result.message = "HTTP status " + std::to_string(res.code);
+        }
+
+        if (!result) {
+            std::cerr << "Error: " << result.message << std::endl;
+            throw WebDriverError(result.error, result.message,
+                                 result.errorString);
+        }
+
+        return list;
+    }
+
+    /**
+     * @brief sendCommand with a body produced while it is sent. Not retried,
+     * the body may not be cheap to produce again
+     */
+    auto sendBodyCommand(const std::string &verb, const std::string &url,
+                         RequestBody &body) -> CommandResult {
+        return commandResult(activeTransport()->sendBody(verb, url, body));
+    }
+
+    /**
+     * @brief sendCommand with the base64 string of the response decoded by
+     * sink while it arrives
+     */
+    auto sendIntoCommand(const std::string &verb, const std::string &url,
+                         const std::string &body, Base64ResponseSink &sink)
+        -> CommandResult {
+        auto res = activeTransport()->sendInto(verb, url, body, sink);
+
+        /*
+         Errors are reported in the JSON around the decoded string
+         */
+        if (res.ok()) {
+            res.body = sink.envelope();
+        }
+
+        return commandResult(res);
+    }
+
+    auto commandResult(const HttpResponse &res) -> CommandResult {
+        CommandResult result;
+
+        std::cout << "Response: " << res.body << std::endl;
+
+        if (!res.ok()) {
+            result.error = ErrorCode::Transport;
+            result.message = res.message.empty() ? curl_easy_strerror(res.error)
+                                                 : res.message;
+            return result;
+        }
+
+        if (res.body.empty()) {
+            return result;
+        }
+
+        Poco::JSON::Object::Ptr resObj;
+
+        try {
+            resObj = Poco::JSON::Parser()
+                         .parse(res.body)
+                         .extract<Poco::JSON::Object::Ptr>();
+        } catch (const std::exception &e) {
+            result.error = ErrorCode::UnknownError;
+            result.message = std::string("Invalid response: ") + e.what();
+            return result;
+        }
+
+        parseError(resObj, result);
+
+        if (result.error == ErrorCode::NoSuchWindow) {
+            browsingContext.forget();
+        }
+
+        if (result) {
+            result.value = resObj->get("value");
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Send a command changing the window or frame, onSuccess updates
+     * the tracked context and a failure leaves it unknown
+     */
+    template <class Fn>
+    auto switchContext(const std::string &verb, const std::string &path,
+                       const std::string &body, Fn &&onSuccess)
+        -> Poco::Dynamic::Var {
+        Poco::Dynamic::Var value;
+
+        try {
+            value = callUrlDriver(verb, webDriverUrl + path, body);
+        } catch (...) {
+            browsingContext.forget();
+            throw;
+        }
+
+        onSuccess();
+        return value;
+    }
+
+    /**
+     * @brief Non-throwing command path, failed commands are sent again as
+     * allowed by retryPolicy and the session retryBudget
+     */
+    auto tryCallUrlDriver(const std::string &verb, const std::string &url,
+                          const std::string &body = "") -> CommandResult {
+        return commandResult(sendRetried(verb, url, body));
+    }
+
+    /**
+     * @brief sendRequest() sent again as allowed by retryPolicy and the
+     * session retryBudget, and to a recovered session when the session is
+     * lost. Only failed responses are parsed, to decide
+     */
+    auto sendRetried(const std::string &verb, const std::string &url,
+                     const std::string &body = "") -> HttpResponse {
+        for (unsigned attempt = 0;; attempt++) {
+            auto res = sendRequest(verb, url, body);
+
+            if (res.ok() && res.code < 400) {
+                return res;
+            }
+
+            auto result = commandResult(res);
+
+            if (!result && recovery.enabled && isSessionLost(result)) {
+                return resendToRecoveredSession(verb, url, body, result.message)
+                    .value_or(std::move(res));
+            }
+
+            if (result || attempt + 1 >= retryPolicy.maxAttempts ||
+                !retryPolicy.shouldRetry(verb, result.error) ||
+                !retryBudget.tryConsume(retryPolicy.sessionBudget)) {
+                return res;
+            }
+
+            std::cerr << "Retrying " << verb << " " << url << ": "
+                      << result.message << std::endl;
+            std::this_thread::sleep_for(retryPolicy.delayFor(attempt));
+        }
+    }
+
+    /**
+     * @brief Recover the session a command found lost and send the command
+     * once more to the new session. A command failing on a session another
+     * thread already replaced is only sent again
+     * @return Response of the command sent again, nullopt when it was not
+     */
+    auto resendToRecoveredSession(const std::string &verb,
+                                  const std::string &url,
+                                  const std::string &body,
+                                  const std::string &reason)
+        -> std::optional<HttpResponse> {
+        std::string prefix = webDriverUrl + "/session/";
+        auto idEnd = url.find('/', prefix.size());
+
+        /*
+         Commands on the session itself, such as quit(), are not resent
+         */
+        if (!url.starts_with(prefix) || idEnd == std::string::npos) {
+            return std::nullopt;
+        }
+
+        auto lostSessionId = url.substr(prefix.size(), idEnd - prefix.size());
+        recoverSession(reason, lostSessionId);
+
+        /*
+         One snapshot, the session may be replaced again meanwhile
+         */
+        auto current = sessionId();
+
+        if (current == lostSessionId) {
+            return std::nullopt;
+        }
+
+        return sendRequest(verb, prefix + current + url.substr(idEnd), body);
+    }
+
+    /**
+     * @brief Bring a recovered session back to the checkpoint: timeouts of
+     * the lost session, resource blocking, cookies and page
+     */
+    void restoreCheckpoint(RecoveryEvent &event,
+                           const SessionTimeouts::Values &timeouts) {
+        restoreTimeouts(timeouts);
+
+        if (!sessionBlockPolicy.empty()) {
+            applyResourceBlockPolicy(sessionBlockPolicy);
+        }
+
+        auto url = recovery.restoreUrl ? checkpoint.url() : std::string();
+        auto cookies = recovery.restoreCookies ? checkpoint.cookies()
+                                               : std::vector<Cookie>();
+        bool cookiesSet = false;
+
+        /*
+         Through CDP the cookies of every domain are set before the page
+         loads, addCookie needs a page of the cookie domain
+         */
+        if (!cookies.empty() && cdpAvailable) {
+            try {
+                setCookies(cookies);
+                cookiesSet = true;
+            } catch (const std::exception &e) {
+                std::cerr << "Fail to restore cookies before loading the page: "
+                          << e.what() << std::endl;
+            }
+        }
+
+        if (!url.empty()) {
+            get(url);
+            event.url = url;
+        }
+
+        if (!cookies.empty() && !cookiesSet) {
+            setCookies(cookies);
+
+            if (!url.empty()) {
+                get(url);
+            }
+        }
+
+        event.cookiesRestored = cookies.size();
+    }
+
+    /**
+     * @brief Send the timeouts the new session does not have yet, the
+     * implicit wait lazily like setImplicitWait()
+     */
+    void restoreTimeouts(const SessionTimeouts::Values &timeouts) {
+        if (timeouts.implicit) {
+            sessionTimeouts.wantImplicit(*timeouts.implicit);
+        }
+
+        SessionTimeouts::Values others = timeouts;
+        others.implicit.reset();
+        updateTimeouts(sessionTimeouts.changed(others));
+    }
+
+    auto callUrlDriver(const std::string &verb, const std::string &url,
+                       const std::string &body = "") -> Poco::Dynamic::Var {
+        auto result = tryCallUrlDriver(verb, url, body);
+
+        if (!result) {
+            std::cerr << "Error: " << result.message << std::endl;
+            throw WebDriverError(result.error, result.message,
+                                 result.errorString);
+        }
+
+        return result.value;
     }
 
     ~WebDriver() {
-        if (sessionId.empty()) {
+        if (sessionId().empty()) {
             return;
         }
 
-        auto &req = CurlRAII::instance();
-
-        auto res =
-            req.request("DELETE", webDriverUrl + "/session/" + sessionId);
+        /*
+         Through sendCommand so the deletion is recorded and replayed too
+         */
+        auto res = sendCommand("DELETE", webDriverUrl + sessionPath());
 
-        std::cout << "Response: " << res.response_code << std::endl;
+        if (!res) {
+            std::cerr << "Fail to delete session: " << res.message << std::endl;
+        }
     }
 
     std::string webDriverUrl = "http://localhost:9515";
-    std::string sessionId;
+    /**
+     * @brief Session the commands go to, replaced by connect() and by a
+     * recovery
+     */
+    SessionIdentity session;
+    /**
+     * @brief Ask a Selenium grid to expose the "se:cdp" endpoint, chromedriver
+     * always reports goog:chromeOptions.debuggerAddress
+     */
+    bool enableDevTools{false};
+    /**
+     * @brief connect() also times the driver answering and the first
+     * navigation, each costs one more request
+     */
+    bool measureStartup{false};
+    /**
+     * @brief Resources blocked from the session start, see connect()
+     */
+    ResourceBlockPolicy resourceBlockPolicy;
+    /**
+     * @brief Policy applied by the last connect(), applied again to a
+     * recovered session
+     */
+    ResourceBlockPolicy sessionBlockPolicy;
+    SessionRecoveryOptions recovery;
+    /**
+     * @brief Where a recovered session is brought back to, see
+     * saveCheckpoint()
+     */
+    SessionCheckpoint checkpoint;
+    RetryPolicy retryPolicy;
+    RetryBudget retryBudget;
+    /**
+     * @brief Window and frame selected in the session, used to skip switch
+     * commands that change nothing
+     */
+    BrowsingContext browsingContext;
+    /**
+     * @brief Timeouts of the session, used to skip updates that change
+     * nothing
+     */
+    SessionTimeouts sessionTimeouts;
+    /**
+     * @brief How requests reach the driver, the shared CurlTransport when
+     * unset
+     */
+    std::shared_ptr<Transport> transport;
+    /**
+     * @brief Cleared once the driver answers a CDP command as unknown, so the
+     * fallback paths are taken directly
+     */
+    bool cdpAvailable{true};
+};
+
+/**
+ * @brief Select a frame for the lifetime of the scope and go back to the
+ * previous frame afterwards, sending only the switches needed
+ */
+class FrameScope {
+  public:
+    /**
+     * @brief Enter frameId from the current document, null for the top level
+     * document. Left with a single parent frame command when the previous
+     * frame path is unknown
+     */
+    FrameScope(WebDriver &driver, const Poco::Dynamic::Var &frameId)
+        : driver(driver), previous(driver.browsingContext.framePath()),
+          relative(!frameId.isEmpty()) {
+        driver.switchToFrame(frameId);
+    }
+
+    /**
+     * @brief Select the frame path, from the top level document
+     */
+    FrameScope(WebDriver &driver, const BrowsingContext::frame_path_t &path)
+        : driver(driver), previous(driver.browsingContext.framePath()) {
+        driver.switchToFramePath(path);
+    }
+
+    ~FrameScope() {
+        try {
+            if (previous) {
+                driver.switchToFramePath(*previous);
+            } else if (relative) {
+                driver.switchToParentFrame();
+            } else {
+                driver.switchToDefaultContent();
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Fail to restore frame: " << e.what() << std::endl;
+        }
+    }
+
+    FrameScope(const FrameScope &) = delete;
+    auto operator=(const FrameScope &) -> FrameScope & = delete;
+
+  private:
+    WebDriver &driver;
+    std::optional<BrowsingContext::frame_path_t> previous;
+    bool relative{false};
+};
+
+/**
+ * @brief Select a window for the lifetime of the scope and go back to the
+ * previous window and frame afterwards
+ */
+class WindowScope {
+  public:
+    WindowScope(WebDriver &driver, const std::string &handle)
+        : driver(driver), previousHandle(driver.currentWindowHandle()),
+          previousFrames(driver.browsingContext.framePath()) {
+        driver.switchToWindow(handle);
+    }
+
+    ~WindowScope() {
+        try {
+            driver.switchToWindow(previousHandle);
+
+            if (previousFrames) {
+                driver.switchToFramePath(*previousFrames);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Fail to restore window: " << e.what() << std::endl;
+        }
+    }
+
+    WindowScope(const WindowScope &) = delete;
+    auto operator=(const WindowScope &) -> WindowScope & = delete;
+
+  private:
+    WebDriver &driver;
+    std::string previousHandle;
+    std::optional<BrowsingContext::frame_path_t> previousFrames;
+};
+
+/**
+ * @brief Use another implicit wait for the element lookups of the scope. The
+ * previous wait comes back lazily: it is only sent before the next lookup
+ * after the scope, so a polling loop of scopes updates the driver once
+ */
+class ImplicitWaitScope {
+  public:
+    ImplicitWaitScope(WebDriver &driver, std::chrono::milliseconds wait)
+        : driver(driver), previous(driver.implicitWait()) {
+        driver.setImplicitWait(wait);
+    }
+
+    ~ImplicitWaitScope() { driver.setImplicitWait(previous); }
+
+    ImplicitWaitScope(const ImplicitWaitScope &) = delete;
+    auto operator=(const ImplicitWaitScope &)
+        -> ImplicitWaitScope & = delete;
+
+  private:
+    WebDriver &driver;
+    std::chrono::milliseconds previous;
 };
@@ -0,0 +1,121 @@
+/**
+ *@file WebDriverError.hpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Typed W3C WebDriver errors and non-throwing command results
+ * @version 0.1
+ *
+ *
+ */
+#pragma once
+#ifndef WEBDRIVER_ERROR_HPP
+#define WEBDRIVER_ERROR_HPP
+#include <Poco/Dynamic/Var.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief W3C WebDriver error codes
+ * https://www.w3.org/TR/webdriver2/#errors plus Transport for failures before
+ * a response is received, which has no W3C error string
+ */
+enum class ErrorCode {
+    None,
+    DetachedShadowRoot,
+    ElementClickIntercepted,
+    ElementNotInteractable,
+    InsecureCertificate,
+    InvalidArgument,
+    InvalidCookieDomain,
+    InvalidElementState,
+    InvalidSelector,
+    InvalidSessionId,
+    JavascriptError,
+    MoveTargetOutOfBounds,
+    NoSuchAlert,
+    NoSuchCookie,
+    NoSuchElement,
+    NoSuchFrame,
+    NoSuchShadowRoot,
+    NoSuchWindow,
+    ScriptTimeout,
+    SessionNotCreated,
+    StaleElementReference,
+    Timeout,
+    UnableToCaptureScreen,
+    UnableToSetCookie,
+    UnexpectedAlertOpen,
+    UnknownCommand,
+    UnknownError,
+    UnknownMethod,
+    UnsupportedOperation,
+    Transport,
+};
+
+/**
+ * @brief Map the "error" string of a response, unknown strings map to
+ * ErrorCode::UnknownError
+ */
+auto errorCodeFromString(std::string_view error) -> ErrorCode;
+
+/**
+ * @brief W3C error string, e.g. "no such element", empty for
+ * ErrorCode::Transport
+ */
+auto errorCodeName(ErrorCode code) -> std::string_view;
+
+/**
+ * @brief Exception thrown by the throwing WebDriver commands, what() keeps
+ * the "Error: <error>\n<message>" format with the error string the server
+ * sent, or "Transport error: <message>" when no response was received
+ */
+class WebDriverError : public std::runtime_error {
+  public:
+    WebDriverError(ErrorCode code, const std::string &message,
+                   const std::string &errorString = {})
+        : std::runtime_error(describe(code, message, errorString)),
+          code(code), message(message), errorString(errorString) {}
+
+    ErrorCode code;
+    std::string message;
+    /**
+     * @brief "error" of the response as sent, also when it maps to no
+     * ErrorCode. Empty when the error did not come from the server
+     */
+    std::string errorString;
+
+  private:
+    static auto describe(ErrorCode code, const std::string &message,
+                         const std::string &errorString) -> std::string;
+};
+
+/**
+ * @brief Outcome of a command without exceptions, for polling loops where a
+ * "no such element" is the expected answer most of the time
+ */
+struct CommandResult {
+    Poco::Dynamic::Var value;
+    ErrorCode error{ErrorCode::None};
+    std::string message;
+    /**
+     * @brief "error" of the response as sent, see WebDriverError::errorString
+     */
+    std::string errorString;
+
+    explicit operator bool() const { return error == ErrorCode::None; }
+
+    auto ok() const -> bool { return error == ErrorCode::None; }
+
+    /**
+     * @brief The value, or WebDriverError when the command failed
+     */
+    auto valueOrThrow() const -> const Poco::Dynamic::Var & {
+        if (error != ErrorCode::None) {
+            throw WebDriverError(error, message, errorString);
+        }
+
+        return value;
+    }
+};
+
+#endif
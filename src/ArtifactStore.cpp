@@ -0,0 +1,529 @@
+/**
+ *@file ArtifactStore.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief ArtifactStore and ArtifactReader definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "ArtifactStore.hpp"
+#include "LittleEndian.hpp"
+#include <Poco/Base64Decoder.h>
+#include <Poco/DeflatingStream.h>
+#include <Poco/InflatingStream.h>
+#include <Poco/MemoryStream.h>
+#include <Poco/StreamCopier.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace artifact_detail {
+/*
+ A segment file mapped whole. The file is grown with posix_fallocate so a full
+ disk fails here instead of raising SIGBUS on a write through the mapping
+ */
+struct MappedSegment {
+    MappedSegment(const std::filesystem::path &path, uint64_t minSize,
+                  bool writable)
+        : writable(writable) {
+        int fd = ::open(path.c_str(),
+                        (writable ? (O_RDWR | O_CREAT) : O_RDONLY) | O_CLOEXEC,
+                        0644);
+
+        if (fd < 0) {
+            throw std::runtime_error("Fail to open artifact segment " +
+                                     path.string() + ": " +
+                                     std::string(strerror(errno)));
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Fail to stat artifact segment " +
+                                     path.string() + ": " +
+                                     std::string(strerror(err)));
+        }
+
+        size = static_cast<uint64_t>(st.st_size);
+
+        if (writable && size < minSize) {
+            int err = ::posix_fallocate(fd, 0, static_cast<off_t>(minSize));
+
+            if (err != 0) {
+                ::close(fd);
+                throw std::runtime_error("Fail to allocate artifact segment " +
+                                         path.string() + ": " +
+                                         std::string(strerror(err)));
+            }
+
+            size = minSize;
+        }
+
+        if (size == 0) {
+            ::close(fd);
+            return;
+        }
+
+        void *ptr = ::mmap(nullptr, size,
+                           writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                           MAP_SHARED, fd, 0);
+        int err = errno;
+        ::close(fd);
+
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Fail to map artifact segment " +
+                                     path.string() + ": " +
+                                     std::string(strerror(err)));
+        }
+
+        data = static_cast<char *>(ptr);
+    }
+
+    ~MappedSegment() {
+        if (data != nullptr) {
+            ::munmap(data, size);
+        }
+    }
+
+    MappedSegment(const MappedSegment &) = delete;
+    auto operator=(const MappedSegment &) -> MappedSegment & = delete;
+
+    void sync() const {
+        if (data != nullptr && writable) {
+            ::msync(data, size, MS_SYNC);
+        }
+    }
+
+    auto contains(const ArtifactRecord &record) const -> bool {
+        return record.offset <= size && record.length <= size - record.offset;
+    }
+
+    char *data{nullptr};
+    uint64_t size{0};
+    bool writable{false};
+};
+} // namespace artifact_detail
+
+namespace {
+using artifact_detail::MappedSegment;
+
+constexpr char indexMagic[4] = {'W', 'D', 'A', 'I'};
+constexpr uint16_t indexVersion = 2;
+constexpr size_t indexHeaderSize = sizeof(indexMagic) + sizeof(uint16_t);
+
+constexpr uint8_t flagCompressed = 1U;
+
+auto segmentPath(const std::filesystem::path &directory, uint32_t id)
+    -> std::filesystem::path {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%06u.dat", id);
+    return directory / name;
+}
+
+auto indexPath(const std::filesystem::path &directory)
+    -> std::filesystem::path {
+    return directory / "index.bin";
+}
+
+using little_endian::appendRaw;
+using little_endian::appendString;
+
+/*
+ Every record is prefixed with its size, so a record cut by a crash or still
+ being written is detected and left for the next read
+ */
+auto encodeRecord(const ArtifactRecord &record) -> std::string {
+    std::string body;
+    appendRaw(body, record.segment);
+    appendRaw(body, record.offset);
+    appendRaw(body, record.length);
+    appendRaw(body, record.originalLength);
+    appendRaw(body, record.timestampMs);
+    appendRaw(body, static_cast<uint8_t>(record.type));
+    appendRaw(body, static_cast<uint8_t>(record.compressed ? flagCompressed
+                                                           : 0U));
+    appendString(body, record.sessionId);
+    appendString(body, record.url);
+
+    std::string out;
+    out.reserve(body.size() + sizeof(uint32_t));
+    appendRaw(out, static_cast<uint32_t>(body.size()));
+    out.append(body);
+    return out;
+}
+
+/*
+ Decode the complete records of data
+ @return bytes consumed
+ */
+auto parseRecords(std::string_view data, std::vector<ArtifactRecord> &out)
+    -> size_t {
+    size_t pos = 0;
+
+    while (data.size() - pos >= sizeof(uint32_t)) {
+        auto size =
+            little_endian::Reader(data.substr(pos), "Artifact index truncated")
+                .read<uint32_t>();
+
+        if (data.size() - pos - sizeof(uint32_t) < size) {
+            break;
+        }
+
+        little_endian::Reader reader(data.substr(pos + sizeof(uint32_t), size),
+                                     "Artifact index record is corrupted");
+        ArtifactRecord record;
+        record.segment = reader.read<uint32_t>();
+        record.offset = reader.read<uint64_t>();
+        record.length = reader.read<uint64_t>();
+        record.originalLength = reader.read<uint64_t>();
+        record.timestampMs = reader.read<int64_t>();
+        record.type = static_cast<ArtifactType>(reader.read<uint8_t>());
+        record.compressed = (reader.read<uint8_t>() & flagCompressed) != 0;
+        record.sessionId = reader.readString();
+        record.url = reader.readString();
+
+        out.push_back(std::move(record));
+        pos += sizeof(uint32_t) + size;
+    }
+
+    return pos;
+}
+
+/*
+ Read the index file from offset, checking the header when reading from the
+ start
+ @return bytes consumed, counting the header
+ */
+auto loadIndex(const std::filesystem::path &path, uint64_t offset,
+               std::vector<ArtifactRecord> &out) -> uint64_t {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        return offset;
+    }
+
+    file.seekg(0, std::ios::end);
+    auto fileSize = static_cast<uint64_t>(file.tellg());
+
+    if (fileSize < indexHeaderSize) {
+        return offset;
+    }
+
+    if (offset == 0) {
+        char header[indexHeaderSize];
+        file.seekg(0);
+        file.read(header, sizeof(header));
+
+        little_endian::Reader reader(
+            std::string_view(header + sizeof(indexMagic), sizeof(uint16_t)),
+            "Artifact index header truncated");
+        auto version = reader.read<uint16_t>();
+
+        if (std::memcmp(header, indexMagic, sizeof(indexMagic)) != 0 ||
+            version != indexVersion) {
+            throw std::runtime_error("Not an artifact index " + path.string());
+        }
+
+        offset = indexHeaderSize;
+    }
+
+    if (fileSize <= offset) {
+        return offset;
+    }
+
+    std::string data(static_cast<size_t>(fileSize - offset), '\0');
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+    return offset + parseRecords(data, out);
+}
+
+auto nowMs() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+auto deflate(std::string_view data, int level) -> std::string {
+    std::ostringstream out;
+    Poco::DeflatingOutputStream deflater(
+        out, Poco::DeflatingStreamBuf::STREAM_ZLIB, level);
+    deflater.write(data.data(), static_cast<std::streamsize>(data.size()));
+    deflater.close();
+    return out.str();
+}
+
+auto restore(std::string_view stored, const ArtifactRecord &record)
+    -> std::string {
+    if (!record.compressed) {
+        return std::string(stored);
+    }
+
+    Poco::MemoryInputStream in(stored.data(), stored.size());
+    Poco::InflatingInputStream inflater(in,
+                                        Poco::InflatingStreamBuf::STREAM_ZLIB);
+
+    std::string result;
+    result.reserve(static_cast<size_t>(record.originalLength));
+    Poco::StreamCopier::copyToString(inflater, result);
+
+    if (result.size() != record.originalLength) {
+        throw std::runtime_error("Fail to decompress artifact of " +
+                                 record.url);
+    }
+
+    return result;
+}
+
+auto viewOf(const MappedSegment &segment, const ArtifactRecord &record)
+    -> std::string_view {
+    if (!segment.contains(record)) {
+        throw std::runtime_error("Artifact is outside of its segment");
+    }
+
+    return {segment.data + record.offset, static_cast<size_t>(record.length)};
+}
+} // namespace
+
+ArtifactReader::ArtifactReader(std::filesystem::path directory)
+    : directory(std::move(directory)) {
+    refresh();
+}
+
+ArtifactReader::~ArtifactReader() = default;
+
+auto ArtifactReader::refresh() -> size_t {
+    auto before = index.size();
+    indexOffset = loadIndex(indexPath(directory), indexOffset, index);
+    return index.size() - before;
+}
+
+auto ArtifactReader::view(const ArtifactRecord &record) -> std::string_view {
+    if (segments.size() <= record.segment) {
+        segments.resize(record.segment + 1);
+    }
+
+    auto &segment = segments[record.segment];
+
+    /*
+     Remapped when the writer grew the segment after it was mapped here. The
+     old mapping is retired instead of unmapped, views into it may still be
+     held by the caller
+     */
+    if (!segment || !segment->contains(record)) {
+        auto remapped = std::make_unique<MappedSegment>(
+            segmentPath(directory, record.segment), 0, false);
+
+        if (segment) {
+            retired.push_back(std::move(segment));
+        }
+
+        segment = std::move(remapped);
+    }
+
+    return viewOf(*segment, record);
+}
+
+auto ArtifactReader::read(const ArtifactRecord &record) -> std::string {
+    return restore(view(record), record);
+}
+
+ArtifactStore::ArtifactStore(std::filesystem::path directory,
+                             ArtifactStoreOptions options)
+    : directory(std::move(directory)), options(options) {
+    std::filesystem::create_directories(this->directory);
+
+    auto path = indexPath(this->directory);
+    auto consumed = loadIndex(path, 0, index);
+
+    indexFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                     0644);
+
+    if (indexFd < 0) {
+        throw std::runtime_error("Fail to open artifact index " +
+                                 path.string() + ": " +
+                                 std::string(strerror(errno)));
+    }
+
+    if (consumed == 0) {
+        std::string header(indexMagic, sizeof(indexMagic));
+        appendRaw(header, indexVersion);
+
+        if (::ftruncate(indexFd, 0) != 0 ||
+            ::write(indexFd, header.data(), header.size()) !=
+                static_cast<ssize_t>(header.size())) {
+            ::close(indexFd);
+            throw std::runtime_error("Fail to write artifact index " +
+                                     path.string());
+        }
+    } else if (::ftruncate(indexFd, static_cast<off_t>(consumed)) != 0) {
+        /*
+         Drop a partial record left by a crash, new records are appended
+         after the last complete one
+         */
+        ::close(indexFd);
+        throw std::runtime_error("Fail to truncate artifact index " +
+                                 path.string());
+    }
+
+    if (index.empty()) {
+        return;
+    }
+
+    uint32_t lastSegment = 0;
+    for (const auto &record : index) {
+        lastSegment = std::max(lastSegment, record.segment);
+    }
+
+    for (uint32_t id = 0; id <= lastSegment; id++) {
+        segments.push_back(std::make_unique<MappedSegment>(
+            segmentPath(this->directory, id), 0, true));
+    }
+
+    for (const auto &record : index) {
+        if (record.segment == lastSegment) {
+            segmentUsed =
+                std::max(segmentUsed, record.offset + record.length);
+        }
+    }
+}
+
+ArtifactStore::~ArtifactStore() {
+    if (indexFd >= 0) {
+        ::close(indexFd);
+    }
+}
+
+auto ArtifactStore::reserve(uint64_t length, uint32_t &segment) -> uint64_t {
+    if (segments.empty() || segmentUsed + length > segments.back()->size) {
+        auto id = static_cast<uint32_t>(segments.size());
+        auto size = std::max<uint64_t>({options.segmentSize, length, 1});
+        segments.push_back(std::make_unique<MappedSegment>(
+            segmentPath(directory, id), size, true));
+        segmentUsed = 0;
+    }
+
+    segment = static_cast<uint32_t>(segments.size() - 1);
+
+    auto offset = segmentUsed;
+    segmentUsed += length;
+    return offset;
+}
+
+void ArtifactStore::writeIndex(const ArtifactRecord &record) {
+    auto encoded = encodeRecord(record);
+    const char *ptr = encoded.data();
+    size_t remaining = encoded.size();
+
+    while (remaining > 0) {
+        auto written = ::write(indexFd, ptr, remaining);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error("Fail to write artifact index: " +
+                                     std::string(strerror(errno)));
+        }
+
+        ptr += written;
+        remaining -= static_cast<size_t>(written);
+    }
+}
+
+auto ArtifactStore::append(const std::string &sessionId,
+                           const std::string &url, ArtifactType type,
+                           std::string_view data) -> ArtifactRecord {
+    std::string compressed;
+    std::string_view stored = data;
+
+    ArtifactRecord record;
+    record.sessionId = sessionId;
+    record.url = url;
+    record.timestampMs = nowMs();
+    record.type = type;
+    record.originalLength = data.size();
+
+    if (options.compress && data.size() >= options.compressMinSize) {
+        compressed = deflate(data, options.compressionLevel);
+
+        if (compressed.size() < data.size()) {
+            stored = compressed;
+            record.compressed = true;
+        }
+    }
+
+    record.length = stored.size();
+
+    char *dest = nullptr;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        record.offset = reserve(record.length, record.segment);
+        dest = segments[record.segment]->data + record.offset;
+    }
+
+    /*
+     The copy runs unlocked, the range belongs to this call only
+     */
+    std::memcpy(dest, stored.data(), stored.size());
+
+    std::lock_guard<std::mutex> lck(mtx);
+    writeIndex(record);
+    index.push_back(record);
+
+    return record;
+}
+
+auto ArtifactStore::appendBase64(const std::string &sessionId,
+                                 const std::string &url, ArtifactType type,
+                                 const std::string &base64) -> ArtifactRecord {
+    std::istringstream in(base64);
+    Poco::Base64Decoder decoder(in);
+
+    std::string bytes;
+    bytes.reserve(base64.size() / 4 * 3);
+    Poco::StreamCopier::copyToString(decoder, bytes);
+
+    return append(sessionId, url, type, bytes);
+}
+
+auto ArtifactStore::records() const -> std::vector<ArtifactRecord> {
+    std::lock_guard<std::mutex> lck(mtx);
+    return index;
+}
+
+auto ArtifactStore::view(const ArtifactRecord &record) const
+    -> std::string_view {
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (record.segment >= segments.size()) {
+        throw std::runtime_error("Artifact segment does not exist");
+    }
+
+    return viewOf(*segments[record.segment], record);
+}
+
+auto ArtifactStore::read(const ArtifactRecord &record) const -> std::string {
+    return restore(view(record), record);
+}
+
+void ArtifactStore::flush() {
+    std::lock_guard<std::mutex> lck(mtx);
+
+    for (const auto &segment : segments) {
+        segment->sync();
+    }
+
+    ::fsync(indexFd);
+}
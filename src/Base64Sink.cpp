@@ -0,0 +1,198 @@
+/**
+ *@file Base64Sink.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Base64Sink definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "Base64Sink.hpp"
+#include <array>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace {
+constexpr auto base64Values = []() {
+    std::array<int8_t, 256> values{};
+    values.fill(-1);
+    std::string_view alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (size_t i = 0; i < alphabet.size(); i++) {
+        values[static_cast<unsigned char>(alphabet[i])] =
+            static_cast<int8_t>(i);
+    }
+
+    return values;
+}();
+} // namespace
+
+Base64ResponseSink::Base64ResponseSink(std::string key) : key(std::move(key)) {}
+
+void Base64ResponseSink::write(const char *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len) {
+        char c = data[i];
+
+        switch (jsonState) {
+        case JsonState::Outside:
+            json.push_back(c);
+            i++;
+
+            if (c == '"') {
+                jsonState = keyProgress == 2 ? JsonState::Contents
+                                             : JsonState::InString;
+                lastString.clear();
+                keyProgress = 0;
+            } else if (c == ':' && keyProgress == 1) {
+                keyProgress = 2;
+            } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                keyProgress = 0;
+            }
+            break;
+
+        case JsonState::InString:
+            json.push_back(c);
+            i++;
+
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+                break;
+            } else if (c == '"') {
+                jsonState = JsonState::Outside;
+                keyProgress = lastString == key ? 1 : 0;
+                continue;
+            }
+
+            /*
+             Only short strings can be the key looked for
+             */
+            if (lastString.size() <= key.size()) {
+                lastString.push_back(c);
+            }
+            break;
+
+        case JsonState::Contents: {
+            if (escaped) {
+                escaped = false;
+                i++;
+
+                if (c == '/') {
+                    decodeBase64(&c, 1);
+                } else if (c != 'n' && c != 'r') {
+                    throw std::runtime_error(
+                        "Fail to decode response: invalid escape in " + key);
+                }
+                break;
+            }
+
+            size_t end = i;
+
+            while (end < len && data[end] != '"' && data[end] != '\\') {
+                end++;
+            }
+
+            decodeBase64(data + i, end - i);
+            i = end;
+
+            if (i == len) {
+                break;
+            }
+
+            if (data[i] == '\\') {
+                escaped = true;
+            } else {
+                flushDecoded(true);
+                json.push_back('"');
+                jsonState = JsonState::Done;
+            }
+
+            i++;
+            break;
+        }
+
+        case JsonState::Done:
+            json.append(data + i, len - i);
+            i = len;
+            break;
+        }
+    }
+}
+
+void Base64ResponseSink::decodeBase64(const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        auto value = base64Values[static_cast<unsigned char>(data[i])];
+
+        if (value < 0) {
+            if (data[i] == '=') {
+                continue;
+            }
+
+            throw std::runtime_error(
+                "Fail to decode response: invalid base64 in " + key);
+        }
+
+        quad = (quad << 6) | static_cast<uint32_t>(value);
+
+        if (++quadLength == 4) {
+            buffer.push_back(static_cast<char>((quad >> 16) & 0xFF));
+            buffer.push_back(static_cast<char>((quad >> 8) & 0xFF));
+            buffer.push_back(static_cast<char>(quad & 0xFF));
+            quad = 0;
+            quadLength = 0;
+        }
+    }
+
+    flushDecoded(false);
+}
+
+void Base64ResponseSink::flushDecoded(bool last) {
+    if (last) {
+        if (quadLength == 1) {
+            throw std::runtime_error(
+                "Fail to decode response: truncated base64 in " + key);
+        }
+
+        if (quadLength >= 2) {
+            quad <<= 6 * (4 - quadLength);
+            buffer.push_back(static_cast<char>((quad >> 16) & 0xFF));
+        }
+
+        if (quadLength == 3) {
+            buffer.push_back(static_cast<char>((quad >> 8) & 0xFF));
+        }
+
+        quad = 0;
+        quadLength = 0;
+    }
+
+    if (!buffer.empty()) {
+        decoded(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+Base64StreamSink::Base64StreamSink(std::ostream &out, std::string key)
+    : Base64ResponseSink(std::move(key)), out(out) {}
+
+void Base64StreamSink::decoded(const char *data, size_t len) {
+    written += len;
+
+    if (!out.write(data, static_cast<std::streamsize>(len))) {
+        throw std::runtime_error("Fail to write the decoded response");
+    }
+}
+
+void Base64StreamSink::finish() {
+    if (!complete()) {
+        throw std::runtime_error("Fail to decode response: truncated");
+    }
+
+    if (!out.flush()) {
+        throw std::runtime_error("Fail to write the decoded response");
+    }
+}
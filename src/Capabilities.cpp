@@ -0,0 +1,334 @@
+/**
+ *@file Capabilities.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Capabilities definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "Capabilities.hpp"
+#include "Strutils.hpp"
+#include <Poco/JSON/Array.h>
+#include <algorithm>
+#include <array>
+#include <sstream>
+
+namespace {
+auto toArray(const std::vector<std::string> &values)
+    -> Poco::JSON::Array::Ptr {
+    Poco::JSON::Array::Ptr arr = new Poco::JSON::Array;
+
+    for (const auto &val : values) {
+        arr->add(val);
+    }
+
+    return arr;
+}
+
+/*
+ Background work Chrome starts with every profile, none of it is needed by an
+ automated session and all of it competes with the first page load
+ */
+constexpr std::array<const char *, 20> leanHeadlessArgs = {
+    "--headless=new",
+    "--disable-gpu",
+    "--disable-dev-shm-usage",
+    "--disable-extensions",
+    "--disable-background-networking",
+    "--disable-component-update",
+    "--disable-default-apps",
+    "--disable-sync",
+    "--disable-client-side-phishing-detection",
+    "--disable-background-timer-throttling",
+    "--disable-backgrounding-occluded-windows",
+    "--disable-renderer-backgrounding",
+    "--disable-hang-monitor",
+    "--disable-features=Translate,MediaRouter,OptimizationHints",
+    "--metrics-recording-only",
+    "--no-first-run",
+    "--no-default-browser-check",
+    "--password-store=basic",
+    "--use-mock-keychain",
+    "--mute-audio",
+};
+
+auto switchName(std::string_view arg) -> std::string_view {
+    return arg.substr(0, arg.find('='));
+}
+
+/*
+ Add the comma separated features missing from the value of arg
+ */
+void mergeFeatures(std::string &arg, std::string_view features) {
+    if (arg.find('=') == std::string::npos) {
+        arg += '=';
+    }
+
+    for (auto feature : Strutils::split_view(features, ",")) {
+        auto list = std::string_view(arg).substr(arg.find('=') + 1);
+        auto present = Strutils::split_view(list, ",");
+
+        if (std::find(present.begin(), present.end(), feature) !=
+            present.end()) {
+            continue;
+        }
+
+        if (arg.back() != '=') {
+            arg += ',';
+        }
+        arg += feature;
+    }
+}
+
+auto strategyName(PageLoadStrategy strategy) -> const char * {
+    switch (strategy) {
+    case PageLoadStrategy::Eager:
+        return "eager";
+    case PageLoadStrategy::None:
+        return "none";
+    case PageLoadStrategy::Normal:
+        break;
+    }
+
+    return "normal";
+}
+} // namespace
+
+auto Capabilities::browserName(const std::string &name) -> Capabilities & {
+    browser = name;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::pageLoadStrategy(PageLoadStrategy strategy)
+    -> Capabilities & {
+    loadStrategy = strategy;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::implicitTimeout(int ms) -> Capabilities & {
+    implicitMs = ms;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::pageLoadTimeout(int ms) -> Capabilities & {
+    pageLoadMs = ms;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::scriptTimeout(int ms) -> Capabilities & {
+    scriptMs = ms;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::arg(const std::string &chromeArg) -> Capabilities & {
+    chromeArgs.push_back(chromeArg);
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::args(const Poco::JSON::Array::Ptr &newArgs)
+    -> Capabilities & {
+    if (newArgs.isNull()) {
+        return *this;
+    }
+
+    for (unsigned int i = 0; i < newArgs->size(); i++) {
+        chromeArgs.push_back(newArgs->get(i).toString());
+    }
+
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::leanHeadless() -> Capabilities & {
+    for (std::string_view flag : leanHeadlessArgs) {
+        auto name = switchName(flag);
+        auto found = std::find_if(chromeArgs.begin(), chromeArgs.end(),
+                                  [name](const std::string &arg) {
+                                      return switchName(arg) == name;
+                                  });
+
+        if (found == chromeArgs.end()) {
+            chromeArgs.emplace_back(flag);
+        } else if (name == "--disable-features") {
+            mergeFeatures(*found, flag.substr(name.size() + 1));
+        }
+    }
+
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::pref(const std::string &name,
+                        const Poco::Dynamic::Var &value) -> Capabilities & {
+    setOrReplace(chromePrefs, name, value);
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::excludeSwitch(const std::string &name) -> Capabilities & {
+    excludedSwitches.push_back(name);
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::userDataDir(const std::string &path) -> Capabilities & {
+    return arg("--user-data-dir=" + path);
+}
+
+auto Capabilities::proxy(const std::string &hostPort,
+                         const std::vector<std::string> &noProxy)
+    -> Capabilities & {
+    proxyHostPort = hostPort;
+    noProxyHosts = noProxy;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::enableDevTools(bool enable) -> Capabilities & {
+    devTools = enable;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::blockResources(const ResourceBlockPolicy &policy)
+    -> Capabilities & {
+    blockPolicy = policy;
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::set(const std::string &name,
+                       const Poco::Dynamic::Var &value) -> Capabilities & {
+    setOrReplace(extra, name, value);
+    invalidate();
+    return *this;
+}
+
+auto Capabilities::chromeOption(const std::string &name,
+                                const Poco::Dynamic::Var &value)
+    -> Capabilities & {
+    setOrReplace(chromeOptions, name, value);
+    invalidate();
+    return *this;
+}
+
+void Capabilities::setOrReplace(
+    std::vector<std::pair<std::string, Poco::Dynamic::Var>> &entries,
+    const std::string &name, const Poco::Dynamic::Var &value) {
+    for (auto &entry : entries) {
+        if (entry.first == name) {
+            entry.second = value;
+            return;
+        }
+    }
+
+    entries.emplace_back(name, value);
+}
+
+auto Capabilities::toJson() const -> Poco::JSON::Object::Ptr {
+    Poco::JSON::Object::Ptr alwaysMatch = new Poco::JSON::Object();
+    alwaysMatch->set("browserName", browser);
+
+    if (loadStrategy) {
+        alwaysMatch->set("pageLoadStrategy", strategyName(*loadStrategy));
+    }
+
+    if (implicitMs || pageLoadMs || scriptMs) {
+        Poco::JSON::Object::Ptr timeouts = new Poco::JSON::Object();
+
+        if (implicitMs) {
+            timeouts->set("implicit", *implicitMs);
+        }
+
+        if (pageLoadMs) {
+            timeouts->set("pageLoad", *pageLoadMs);
+        }
+
+        if (scriptMs) {
+            timeouts->set("script", *scriptMs);
+        }
+
+        alwaysMatch->set("timeouts", timeouts);
+    }
+
+    if (!proxyHostPort.empty()) {
+        Poco::JSON::Object::Ptr proxyObj = new Poco::JSON::Object();
+        proxyObj->set("proxyType", "manual");
+        proxyObj->set("httpProxy", proxyHostPort);
+        proxyObj->set("sslProxy", proxyHostPort);
+
+        if (!noProxyHosts.empty()) {
+            proxyObj->set("noProxy", toArray(noProxyHosts));
+        }
+
+        alwaysMatch->set("proxy", proxyObj);
+    }
+
+    if (devTools) {
+        alwaysMatch->set("se:cdpEnabled", true);
+    }
+
+    Poco::JSON::Object::Ptr chrome = new Poco::JSON::Object();
+
+    if (!chromeArgs.empty()) {
+        chrome->set("args", toArray(chromeArgs));
+    }
+
+    if (!excludedSwitches.empty()) {
+        chrome->set("excludeSwitches", toArray(excludedSwitches));
+    }
+
+    Poco::JSON::Object::Ptr prefs = new Poco::JSON::Object();
+    blockPolicy.applyPrefs(prefs);
+
+    for (const auto &entry : chromePrefs) {
+        prefs->set(entry.first, entry.second);
+    }
+
+    if (prefs->size() > 0) {
+        chrome->set("prefs", prefs);
+    }
+
+    for (const auto &entry : chromeOptions) {
+        chrome->set(entry.first, entry.second);
+    }
+
+    if (chrome->size() > 0) {
+        alwaysMatch->set("goog:chromeOptions", chrome);
+    }
+
+    for (const auto &entry : extra) {
+        alwaysMatch->set(entry.first, entry.second);
+    }
+
+    Poco::JSON::Object::Ptr capabilities = new Poco::JSON::Object();
+    capabilities->set("alwaysMatch", alwaysMatch);
+
+    Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+    obj->set("capabilities", capabilities);
+    return obj;
+}
+
+auto Capabilities::serialize() const -> const std::string & {
+    std::lock_guard<std::mutex> lck(serialized.mtx);
+
+    if (serialized.stale) {
+        std::stringstream ss;
+        toJson()->stringify(ss);
+        serialized.body = ss.str();
+        serialized.stale = false;
+    }
+
+    return serialized.body;
+}
+
+void Capabilities::invalidate() {
+    std::lock_guard<std::mutex> lck(serialized.mtx);
+    serialized.stale = true;
+}
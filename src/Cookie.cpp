@@ -0,0 +1,221 @@
+/**
+ *@file Cookie.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Cookie and CookieJar definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "Cookie.hpp"
+#include "LittleEndian.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+constexpr char jarMagic[4] = {'W', 'D', 'C', 'J'};
+
+constexpr unsigned flagSecure = 1U;
+constexpr unsigned flagHttpOnly = 2U;
+constexpr unsigned flagHasExpiry = 4U;
+
+/*
+ Flags byte, expiry and the five string lengths of a cookie with empty strings
+ */
+constexpr size_t minRecordSize =
+    sizeof(uint8_t) + sizeof(int64_t) + 5 * sizeof(uint32_t);
+
+using little_endian::appendRaw;
+using little_endian::appendString;
+} // namespace
+
+auto Cookie::fromJson(const Poco::JSON::Object::Ptr &obj) -> Cookie {
+    Cookie cookie;
+    cookie.name = obj->optValue<std::string>("name", "");
+    cookie.value = obj->optValue<std::string>("value", "");
+    cookie.path = obj->optValue<std::string>("path", "");
+    cookie.domain = obj->optValue<std::string>("domain", "");
+    cookie.sameSite = obj->optValue<std::string>("sameSite", "");
+    cookie.secure = obj->optValue<bool>("secure", false);
+    cookie.httpOnly = obj->optValue<bool>("httpOnly", false);
+
+    if (obj->has("expiry") && !obj->isNull("expiry")) {
+        cookie.expiry = obj->get("expiry").convert<int64_t>();
+    }
+
+    return cookie;
+}
+
+auto Cookie::fromCdpJson(const Poco::JSON::Object::Ptr &obj) -> Cookie {
+    Cookie cookie;
+    cookie.name = obj->optValue<std::string>("name", "");
+    cookie.value = obj->optValue<std::string>("value", "");
+    cookie.path = obj->optValue<std::string>("path", "");
+    cookie.domain = obj->optValue<std::string>("domain", "");
+    cookie.sameSite = obj->optValue<std::string>("sameSite", "");
+    cookie.secure = obj->optValue<bool>("secure", false);
+    cookie.httpOnly = obj->optValue<bool>("httpOnly", false);
+
+    if (!obj->optValue<bool>("session", false) && obj->has("expires")) {
+        cookie.expiry =
+            static_cast<int64_t>(obj->get("expires").convert<double>());
+    }
+
+    return cookie;
+}
+
+auto Cookie::toJson() const -> Poco::JSON::Object::Ptr {
+    Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+    obj->set("name", name);
+    obj->set("value", value);
+
+    if (!path.empty()) {
+        obj->set("path", path);
+    }
+
+    if (!domain.empty()) {
+        obj->set("domain", domain);
+    }
+
+    if (!sameSite.empty()) {
+        obj->set("sameSite", sameSite);
+    }
+
+    if (expiry) {
+        obj->set("expiry", *expiry);
+    }
+
+    obj->set("secure", secure);
+    obj->set("httpOnly", httpOnly);
+    return obj;
+}
+
+auto Cookie::toCdpJson() const -> Poco::JSON::Object::Ptr {
+    Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+    obj->set("name", name);
+    obj->set("value", value);
+    obj->set("domain", domain);
+    obj->set("path", path.empty() ? std::string("/") : path);
+
+    if (!sameSite.empty()) {
+        obj->set("sameSite", sameSite);
+    }
+
+    if (expiry) {
+        obj->set("expires", static_cast<double>(*expiry));
+    }
+
+    obj->set("secure", secure);
+    obj->set("httpOnly", httpOnly);
+    return obj;
+}
+
+auto CookieJar::serialize(std::span<const Cookie> cookies) -> std::string {
+    std::string out;
+
+    size_t total = sizeof(jarMagic) + sizeof(uint16_t) + sizeof(uint32_t);
+    for (const auto &cookie : cookies) {
+        total += minRecordSize + cookie.name.size() + cookie.value.size() +
+                 cookie.path.size() + cookie.domain.size() +
+                 cookie.sameSite.size();
+    }
+    out.reserve(total);
+
+    out.append(jarMagic, sizeof(jarMagic));
+    appendRaw(out, version);
+    appendRaw(out, static_cast<uint32_t>(cookies.size()));
+
+    for (const auto &cookie : cookies) {
+        auto flags = static_cast<uint8_t>(
+            (cookie.secure ? flagSecure : 0U) |
+            (cookie.httpOnly ? flagHttpOnly : 0U) |
+            (cookie.expiry ? flagHasExpiry : 0U));
+
+        appendRaw(out, flags);
+        appendRaw(out, cookie.expiry.value_or(int64_t{0}));
+        appendString(out, cookie.name);
+        appendString(out, cookie.value);
+        appendString(out, cookie.path);
+        appendString(out, cookie.domain);
+        appendString(out, cookie.sameSite);
+    }
+
+    return out;
+}
+
+auto CookieJar::deserialize(std::string_view data) -> std::vector<Cookie> {
+    if (data.size() < sizeof(jarMagic) ||
+        std::memcmp(data.data(), jarMagic, sizeof(jarMagic)) != 0) {
+        throw std::runtime_error("Not a cookie jar file");
+    }
+
+    little_endian::Reader reader(data.substr(sizeof(jarMagic)),
+                                 "Cookie jar is truncated");
+
+    if (reader.read<uint16_t>() != version) {
+        throw std::runtime_error("Unsupported cookie jar version");
+    }
+
+    auto count = reader.read<uint32_t>();
+
+    /*
+     The count comes from the file, bounded by the records the remaining bytes
+     can hold before anything is reserved for it
+     */
+    if (count > reader.remaining() / minRecordSize) {
+        throw std::runtime_error("Cookie jar is truncated");
+    }
+
+    std::vector<Cookie> cookies;
+    cookies.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        Cookie cookie;
+        auto flags = reader.read<uint8_t>();
+        auto expiry = reader.read<int64_t>();
+
+        cookie.name = reader.readString();
+        cookie.value = reader.readString();
+        cookie.path = reader.readString();
+        cookie.domain = reader.readString();
+        cookie.sameSite = reader.readString();
+        cookie.secure = (flags & flagSecure) != 0U;
+        cookie.httpOnly = (flags & flagHttpOnly) != 0U;
+
+        if ((flags & flagHasExpiry) != 0U) {
+            cookie.expiry = expiry;
+        }
+
+        cookies.push_back(std::move(cookie));
+    }
+
+    return cookies;
+}
+
+void CookieJar::save(const std::filesystem::path &path,
+                     std::span<const Cookie> cookies) {
+    auto data = serialize(cookies);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("Fail to open cookie jar " + path.string());
+    }
+
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+auto CookieJar::load(const std::filesystem::path &path)
+    -> std::vector<Cookie> {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("Fail to open cookie jar " + path.string());
+    }
+
+    std::string data(static_cast<size_t>(std::filesystem::file_size(path)),
+                     '\0');
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+    return deserialize(data);
+}
@@ -0,0 +1,327 @@
+/**
+ *@file CrawlScheduler.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief CrawlScheduler definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "CrawlScheduler.hpp"
+#include <Poco/URI.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+using steady_clock = std::chrono::steady_clock;
+
+auto nowNs() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Hands out URLs whose host is below its concurrency limit and past
+ * its rate limit interval, looking ahead in the source so a busy host does not
+ * block the others
+ */
+class UrlDispatcher {
+  public:
+    struct Job {
+        std::string url;
+        std::string host;
+    };
+
+    UrlDispatcher(const CrawlScheduler::UrlSource &source,
+                  const CrawlOptions &options, size_t lookahead)
+        : source(source), options(options), lookahead(lookahead) {}
+
+    auto next() -> std::optional<Job> {
+        std::unique_lock<std::mutex> lck(mtx);
+
+        while (true) {
+            while (!sourceDone && pending.size() < lookahead) {
+                std::optional<std::string> url;
+
+                try {
+                    url = source();
+                } catch (...) {
+                    sourceError = std::current_exception();
+                }
+
+                if (!url) {
+                    sourceDone = true;
+                    break;
+                }
+
+                pending.push_back({*url, CrawlScheduler::hostOf(*url)});
+            }
+
+            if (pending.empty()) {
+                return std::nullopt;
+            }
+
+            auto now = steady_clock::now();
+            auto earliest = steady_clock::time_point::max();
+            pruneHosts(now);
+
+            for (auto it = pending.begin(); it != pending.end(); ++it) {
+                auto &host = hosts[it->host];
+
+                if (host.active >= options.perHostConcurrency) {
+                    continue;
+                }
+
+                if (host.nextAllowed <= now) {
+                    host.active++;
+                    host.nextAllowed = now + options.perHostInterval;
+
+                    Job job = std::move(*it);
+                    pending.erase(it);
+                    return job;
+                }
+
+                earliest = std::min(earliest, host.nextAllowed);
+            }
+
+            if (earliest == steady_clock::time_point::max()) {
+                changed.wait(lck);
+            } else {
+                changed.wait_until(lck, earliest);
+            }
+        }
+    }
+
+    void done(const Job &job) {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            hosts[job.host].active--;
+        }
+
+        changed.notify_all();
+    }
+
+    /**
+     * @brief Exception thrown by the source, which ended the URLs
+     */
+    auto sourceException() -> std::exception_ptr {
+        std::lock_guard<std::mutex> lck(mtx);
+        return sourceError;
+    }
+
+  private:
+    struct HostState {
+        size_t active{0};
+        steady_clock::time_point nextAllowed{};
+    };
+
+    /*
+     A host with nothing running and no rate limit left is the same as an
+     unknown one, so a long crawl only keeps the hosts in use
+     */
+    void pruneHosts(steady_clock::time_point now) {
+        if (now < nextPrune) {
+            return;
+        }
+
+        std::erase_if(hosts, [now](const auto &entry) {
+            return entry.second.active == 0 && entry.second.nextAllowed <= now;
+        });
+
+        nextPrune = now + options.perHostInterval;
+    }
+
+    const CrawlScheduler::UrlSource &source;
+    const CrawlOptions &options;
+    size_t lookahead;
+
+    std::mutex mtx;
+    std::condition_variable changed;
+    std::deque<Job> pending;
+    std::unordered_map<std::string, HostState> hosts;
+    steady_clock::time_point nextPrune{};
+    bool sourceDone{false};
+    std::exception_ptr sourceError;
+};
+
+/**
+ * @brief Bounded queue between the session workers and the sink threads
+ */
+class ResultQueue {
+  public:
+    explicit ResultQueue(size_t limit) : limit(limit) {}
+
+    void push(CrawlResult &&result) {
+        std::unique_lock<std::mutex> lck(mtx);
+        notFull.wait(lck, [this]() { return results.size() < limit; });
+        results.push_back(std::move(result));
+        notEmpty.notify_one();
+    }
+
+    auto pop() -> std::optional<CrawlResult> {
+        std::unique_lock<std::mutex> lck(mtx);
+        notEmpty.wait(lck, [this]() { return !results.empty() || closed; });
+
+        if (results.empty()) {
+            return std::nullopt;
+        }
+
+        CrawlResult result = std::move(results.front());
+        results.pop_front();
+        notFull.notify_one();
+        return result;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            closed = true;
+        }
+
+        notEmpty.notify_all();
+    }
+
+  private:
+    size_t limit;
+    std::mutex mtx;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<CrawlResult> results;
+    bool closed{false};
+};
+} // namespace
+
+CrawlScheduler::CrawlScheduler(std::vector<WebDriver *> sessions,
+                               CrawlSink &sink, CrawlOptions options)
+    : sessions(std::move(sessions)), sink(sink), options(options) {
+    if (this->sessions.empty()) {
+        throw std::invalid_argument(
+            "CrawlScheduler needs at least one session");
+    }
+
+    this->options.perHostConcurrency =
+        std::max<size_t>(this->options.perHostConcurrency, 1);
+    this->options.sinkThreads = std::max<size_t>(this->options.sinkThreads, 1);
+    this->options.resultQueueLimit =
+        std::max<size_t>(this->options.resultQueueLimit, 1);
+}
+
+auto CrawlScheduler::hostOf(const std::string &url) -> std::string {
+    try {
+        return Poco::URI(url).getHost();
+    } catch (const std::exception &) {
+        return {};
+    }
+}
+
+auto CrawlScheduler::run(std::span<const std::string> urls) -> CrawlStats {
+    size_t pos = 0;
+
+    return run([&urls, &pos]() -> std::optional<std::string> {
+        if (pos >= urls.size()) {
+            return std::nullopt;
+        }
+
+        return urls[pos++];
+    });
+}
+
+auto CrawlScheduler::run(const UrlSource &source) -> CrawlStats {
+    pages = 0;
+    failures = 0;
+    startedAtNs = nowNs();
+    finishedAtNs = 0;
+
+    UrlDispatcher dispatcher(source, options, sessions.size() * 4);
+    ResultQueue queue(options.resultQueueLimit);
+
+    std::vector<std::thread> sinkThreads;
+    for (size_t i = 0; i < options.sinkThreads; i++) {
+        sinkThreads.emplace_back([this, &queue]() {
+            while (auto result = queue.pop()) {
+                try {
+                    sink.consume(std::move(*result));
+                } catch (const std::exception &e) {
+                    std::cerr << "Crawl sink error: " << e.what() << std::endl;
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < sessions.size(); i++) {
+        workers.emplace_back([this, i, &dispatcher, &queue]() {
+            auto &session = *sessions[i];
+
+            while (auto job = dispatcher.next()) {
+                CrawlResult result;
+                result.url = job->url;
+                result.sessionIndex = i;
+
+                auto start = steady_clock::now();
+
+                try {
+                    session.get(job->url);
+                    auto navigated = steady_clock::now();
+
+                    result.pageSource = session.getPageSource().toString();
+                    result.title = session.getTitle().toString();
+
+                    result.navigationTime =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            navigated - start);
+                    result.extractionTime =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            steady_clock::now() - navigated);
+                    pages++;
+                } catch (const std::exception &e) {
+                    result.error = e.what();
+                    failures++;
+                }
+
+                dispatcher.done(*job);
+                queue.push(std::move(result));
+            }
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    queue.close();
+
+    for (auto &thread : sinkThreads) {
+        thread.join();
+    }
+
+    finishedAtNs = nowNs();
+
+    if (auto error = dispatcher.sourceException()) {
+        std::rethrow_exception(error);
+    }
+
+    return stats();
+}
+
+auto CrawlScheduler::stats() const -> CrawlStats {
+    CrawlStats result;
+    result.pages = pages.load();
+    result.failures = failures.load();
+
+    auto start = startedAtNs.load();
+    auto end = finishedAtNs.load();
+
+    if (start != 0) {
+        result.elapsedSeconds =
+            static_cast<double>((end != 0 ? end : nowNs()) - start) / 1e9;
+    }
+
+    return result;
+}
@@ -8,39 +8,94 @@
  */
 #include "CurlRAII.hpp"
 
-CurlRAII::CurlRAII() { curl_global_init(CURL_GLOBAL_DEFAULT); }
+CurlRAII::CurlRAII() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    share = curl_share_init();
+
+    if (share != nullptr) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+
+        /*
+        libcurl does not support sharing the connection cache between
+        concurrent threads, connections stay in each thread's easy handle
+        */
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+}
 
-CurlRAII::~CurlRAII() { curl_global_cleanup(); }
+CurlRAII::~CurlRAII() {
+    if (share != nullptr) {
+        curl_share_cleanup(share);
+    }
+
+    curl_global_cleanup();
+}
 
 CurlRAII &CurlRAII::instance() {
     static CurlRAII inst;
     return inst;
 }
 
+void CurlRAII::lockShare(CURL * /*handle*/, curl_lock_data data,
+                         curl_lock_access /*access*/, void *userptr) {
+    auto *self = static_cast<CurlRAII *>(userptr);
+    self->shareLocks.at(static_cast<size_t>(data)).lock();
+}
+
+void CurlRAII::unlockShare(CURL * /*handle*/, curl_lock_data data,
+                           void *userptr) {
+    auto *self = static_cast<CurlRAII *>(userptr);
+    self->shareLocks.at(static_cast<size_t>(data)).unlock();
+}
+
+auto CurlRAII::easyHandle() -> CURL * {
+    thread_local curlraii_t handle = make_curl_easy();
+
+    if (!handle) {
+        throw std::runtime_error("Curl fail to run curl_easy_init");
+    }
+
+    /*
+    Reset clears the options of the previous request but keeps the
+    connections alive for reuse
+    */
+    curl_easy_reset(handle.get());
+    curl_easy_setopt(handle.get(), CURLOPT_NOSIGNAL, 1L);
+
+    if (share != nullptr) {
+        curl_easy_setopt(handle.get(), CURLOPT_SHARE, share);
+    }
+
+    return handle.get();
+}
+
 auto CurlRAII::postJson(const std::string &url, const std::string &json)
     -> curlCallBack {
 
     curlCallBack result;
-    curlraii_t curl = make_curl_easy();
+    CURL *curl = easyHandle();
 
-    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl.get(), CURLOPT_POST, 1);
-    curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, json.c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json.c_str());
 
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION,
-                     std::addressof(result.cb));
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, std::addressof(result));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, std::addressof(result.cb));
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, std::addressof(result));
 
     curlslitraii_t headers;
 
     CurlRAII::curl_slist_append_raii(headers, "Content-Type: application/json");
 
-    curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers.get());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers.get());
 
-    result.curl_perfm_res = curl_easy_perform(curl.get());
+    result.curl_perfm_res = curl_easy_perform(curl);
 
     if (result.curl_perfm_res == CURLE_OK) {
-        curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE,
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
                           std::addressof(result.response_code));
     }
 
@@ -50,23 +105,22 @@ auto CurlRAII::postJson(const std::string &url, const std::string &json)
 auto CurlRAII::request(const std::string &httpVerb, const std::string &url,
                        const std::string &body) -> curlCallBack {
     curlCallBack result;
-    curlraii_t curl = make_curl_easy();
+    CURL *curl = easyHandle();
 
-    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl.get(), CURLOPT_CUSTOMREQUEST, httpVerb.c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, httpVerb.c_str());
 
     if (!body.empty()) {
-        curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
     }
 
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION,
-                     std::addressof(result.cb));
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, std::addressof(result));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, std::addressof(result.cb));
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, std::addressof(result));
 
-    result.curl_perfm_res = curl_easy_perform(curl.get());
+    result.curl_perfm_res = curl_easy_perform(curl);
 
     if (result.curl_perfm_res == CURLE_OK) {
-        curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE,
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
                           std::addressof(result.response_code));
     }
 
@@ -0,0 +1,299 @@
+/**
+ *@file DevToolsSession.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief DevToolsSession definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "DevToolsSession.hpp"
+#include "CurlRAII.hpp"
+#include <Poco/Buffer.h>
+#include <Poco/Exception.h>
+#include <Poco/JSON/Parser.h>
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/HTTPRequest.h>
+#include <Poco/Net/HTTPResponse.h>
+#include <Poco/Net/WebSocket.h>
+#include <Poco/URI.h>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+DevToolsSession::DevToolsSession(const std::string &webSocketUrl) {
+    Poco::URI uri(webSocketUrl);
+
+    http = std::make_unique<Poco::Net::HTTPClientSession>(uri.getHost(),
+                                                          uri.getPort());
+
+    Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET,
+                                   uri.getPathAndQuery(),
+                                   Poco::Net::HTTPMessage::HTTP_1_1);
+    Poco::Net::HTTPResponse response;
+
+    webSocket =
+        std::make_unique<Poco::Net::WebSocket>(*http, request, response);
+    webSocket->setMaxPayloadSize(std::numeric_limits<int>::max());
+
+    /*
+    The reader wakes up periodically to check if the session was closed
+    */
+    webSocket->setReceiveTimeout(Poco::Timespan(0, 200 * 1000));
+
+    running = true;
+    reader = std::thread(&DevToolsSession::readLoop, this);
+}
+
+DevToolsSession::~DevToolsSession() { close(); }
+
+auto DevToolsSession::resolveWebSocketUrl(const std::string &debuggerAddress)
+    -> std::string {
+    auto res = CurlRAII::instance().request(
+        "GET", "http://" + debuggerAddress + "/json/version");
+
+    if (res.curl_perfm_res != CURLE_OK) {
+        throw std::runtime_error(
+            "Error: " + std::string(curl_easy_strerror(res.curl_perfm_res)));
+    }
+
+    auto obj = Poco::JSON::Parser()
+                   .parse(res.buffer)
+                   .extract<Poco::JSON::Object::Ptr>();
+
+    return obj->getValue<std::string>("webSocketDebuggerUrl");
+}
+
+auto DevToolsSession::send(const std::string &method,
+                           const Poco::JSON::Object::Ptr &params,
+                           const std::string &sessionId)
+    -> std::future<Poco::Dynamic::Var> {
+    return post(method, params, sessionId).second;
+}
+
+auto DevToolsSession::post(const std::string &method,
+                           const Poco::JSON::Object::Ptr &params,
+                           const std::string &sessionId)
+    -> std::pair<int64_t, std::future<Poco::Dynamic::Var>> {
+    auto id = nextMessageId.fetch_add(1);
+
+    Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+    obj->set("id", id);
+    obj->set("method", method);
+
+    if (!params.isNull()) {
+        obj->set("params", params);
+    }
+
+    if (!sessionId.empty()) {
+        obj->set("sessionId", sessionId);
+    }
+
+    std::stringstream ss;
+    obj->stringify(ss);
+    auto message = ss.str();
+
+    std::future<Poco::Dynamic::Var> result;
+
+    {
+        std::lock_guard<std::mutex> lck(stateMutex);
+
+        if (!running) {
+            throw std::runtime_error("DevTools session is closed");
+        }
+
+        result = pending[id].get_future();
+    }
+
+    try {
+        std::lock_guard<std::mutex> lck(sendMutex);
+        webSocket->sendFrame(message.data(), static_cast<int>(message.size()),
+                             Poco::Net::WebSocket::FRAME_TEXT);
+    } catch (...) {
+        std::lock_guard<std::mutex> lck(stateMutex);
+        pending.erase(id);
+        throw;
+    }
+
+    return {id, std::move(result)};
+}
+
+auto DevToolsSession::call(const std::string &method,
+                           const Poco::JSON::Object::Ptr &params,
+                           const std::string &sessionId,
+                           std::chrono::milliseconds timeout)
+    -> Poco::Dynamic::Var {
+    if (std::this_thread::get_id() == readerId.load()) {
+        throw std::logic_error("CDP " + method +
+                               " called from an event handler, use send()");
+    }
+
+    auto [id, result] = post(method, params, sessionId);
+
+    if (result.wait_for(timeout) != std::future_status::ready) {
+        /*
+         Nobody waits for the answer anymore, a late one is dropped
+         */
+        {
+            std::lock_guard<std::mutex> lck(stateMutex);
+            pending.erase(id);
+        }
+
+        throw std::runtime_error("Timeout waiting for CDP " + method);
+    }
+
+    return result.get();
+}
+
+auto DevToolsSession::subscribe(const std::string &method,
+                                EventHandler handler) -> size_t {
+    std::lock_guard<std::mutex> lck(stateMutex);
+    auto id = nextSubscriptionId++;
+    handlers.emplace(method, std::make_pair(id, std::move(handler)));
+    return id;
+}
+
+void DevToolsSession::unsubscribe(size_t subscriptionId) {
+    std::lock_guard<std::recursive_mutex> dispatchLck(dispatchMutex);
+    std::lock_guard<std::mutex> lck(stateMutex);
+
+    for (auto it = handlers.begin(); it != handlers.end(); ++it) {
+        if (it->second.first == subscriptionId) {
+            handlers.erase(it);
+            return;
+        }
+    }
+}
+
+void DevToolsSession::close() {
+    if (running.exchange(false)) {
+        if (reader.joinable()) {
+            reader.join();
+        }
+
+        try {
+            webSocket->shutdown();
+        } catch (const std::exception &e) {
+            std::cerr << "Error closing DevTools session: " << e.what()
+                      << std::endl;
+        }
+    } else if (reader.joinable()) {
+        reader.join();
+    }
+
+    failPending("DevTools session closed");
+}
+
+void DevToolsSession::readLoop() {
+    Poco::Buffer<char> buffer(0);
+    readerId = std::this_thread::get_id();
+
+    while (running) {
+        int flags = 0;
+        buffer.resize(0);
+
+        try {
+            auto len = webSocket->receiveFrame(buffer, flags);
+
+            if (len == 0 || (flags & Poco::Net::WebSocket::FRAME_OP_BITMASK) ==
+                                Poco::Net::WebSocket::FRAME_OP_CLOSE) {
+                break;
+            }
+
+            /*
+             A message that cannot be dispatched is dropped, the connection
+             is still usable
+             */
+            try {
+                dispatch(std::string(buffer.begin(), buffer.size()));
+            } catch (const std::exception &e) {
+                std::cerr << "Ignoring DevTools message: " << e.what()
+                          << std::endl;
+            }
+        } catch (const Poco::TimeoutException &) {
+            continue;
+        } catch (const std::exception &e) {
+            std::cerr << "DevTools reader error: " << e.what() << std::endl;
+            break;
+        }
+    }
+
+    running = false;
+    failPending("DevTools connection lost");
+}
+
+void DevToolsSession::dispatch(const std::string &message) {
+    auto obj =
+        Poco::JSON::Parser().parse(message).extract<Poco::JSON::Object::Ptr>();
+
+    if (obj->has("id")) {
+        auto id = obj->getValue<int64_t>("id");
+        std::promise<Poco::Dynamic::Var> promise;
+
+        {
+            std::lock_guard<std::mutex> lck(stateMutex);
+            auto it = pending.find(id);
+
+            if (it == pending.end()) {
+                return;
+            }
+
+            promise = std::move(it->second);
+            pending.erase(it);
+        }
+
+        if (obj->has("error")) {
+            auto error = obj->getObject("error");
+            promise.set_exception(std::make_exception_ptr(
+                DevToolsError(error->optValue<int64_t>("code", 0),
+                              error->optValue<std::string>("message", ""))));
+        } else {
+            promise.set_value(obj->get("result"));
+        }
+        return;
+    }
+
+    if (!obj->has("method")) {
+        return;
+    }
+
+    auto method = obj->getValue<std::string>("method");
+    auto params = obj->has("params") ? obj->getObject("params")
+                                     : Poco::JSON::Object::Ptr();
+    auto sessionId = obj->optValue<std::string>("sessionId", "");
+
+    std::lock_guard<std::recursive_mutex> dispatchLck(dispatchMutex);
+    std::vector<EventHandler> toCall;
+
+    {
+        std::lock_guard<std::mutex> lck(stateMutex);
+        auto range = handlers.equal_range(method);
+
+        for (auto it = range.first; it != range.second; ++it) {
+            toCall.push_back(it->second.second);
+        }
+    }
+
+    for (auto &handler : toCall) {
+        try {
+            handler(params, sessionId);
+        } catch (const std::exception &e) {
+            std::cerr << "Error in DevTools event handler " << method << ": "
+                      << e.what() << std::endl;
+        }
+    }
+}
+
+void DevToolsSession::failPending(const std::string &reason) {
+    std::unordered_map<int64_t, std::promise<Poco::Dynamic::Var>> toFail;
+
+    {
+        std::lock_guard<std::mutex> lck(stateMutex);
+        toFail.swap(pending);
+    }
+
+    for (auto &entry : toFail) {
+        entry.second.set_exception(
+            std::make_exception_ptr(std::runtime_error(reason)));
+    }
+}
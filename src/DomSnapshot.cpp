@@ -0,0 +1,508 @@
+/**
+ *@file DomSnapshot.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief DomSnapshot definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "DomSnapshot.hpp"
+#include <Poco/JSON/Array.h>
+#include <Poco/JSON/Object.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+/*
+ Integer columns are sent as comma separated strings and the visibility as a
+ string of 0 and 1, one JSON value per column instead of one per number
+ */
+const std::string snapshotScript = R"js(/* snapshotDom */
+var all = document.getElementsByTagName('*');
+var xhtml = 'http://www.w3.org/1999/xhtml';
+var strings = [], index = new Map(), pos = new Map();
+function intern(s) {
+  var i = index.get(s);
+  if (i === undefined) { i = strings.length; strings.push(s); index.set(s, i); }
+  return i;
+}
+var tag = [], parent = [], attrOffsets = [0], attrs = [], visible = [],
+    rect = [];
+for (var i = 0; i < all.length; i++) {
+  var el = all[i];
+  pos.set(el, i);
+  var fold = el.namespaceURI === xhtml;
+  tag.push(intern(fold ? el.localName.toLowerCase() : el.localName));
+  var p = el.parentElement;
+  var pi = p ? pos.get(p) : undefined;
+  parent.push(pi === undefined ? -1 : pi);
+  var at = el.attributes;
+  for (var j = 0; j < at.length; j++) {
+    var name = fold ? at[j].name.toLowerCase() : at[j].name;
+    attrs.push(intern(name), intern(at[j].value));
+  }
+  attrOffsets.push(attrs.length);
+  var r = el.getBoundingClientRect();
+  var shown = el.checkVisibility
+    ? el.checkVisibility({visibilityProperty: true})
+    : (r.width > 0 || r.height > 0);
+  visible.push(shown ? 1 : 0);
+  rect.push(Math.round(r.x), Math.round(r.y), Math.round(r.width),
+            Math.round(r.height));
+}
+return {strings: strings, tag: tag.join(','), parent: parent.join(','),
+        attrOffsets: attrOffsets.join(','), attrs: attrs.join(','),
+        visible: visible.join(''), rect: rect.join(',')};
+)js";
+
+template <class T>
+void parseList(std::string_view str, std::vector<T> &out,
+               const char *column) {
+    out.clear();
+
+    if (str.empty()) {
+        return;
+    }
+
+    out.reserve(static_cast<size_t>(
+                    std::count(str.begin(), str.end(), ',')) +
+                1);
+
+    const char *ptr = str.data();
+    const char *end = str.data() + str.size();
+
+    while (true) {
+        T value{};
+        auto [next, ec] = std::from_chars(ptr, end, value);
+
+        if (ec != std::errc()) {
+            throw std::runtime_error(
+                std::string("Fail to decode DOM snapshot column ") + column);
+        }
+
+        out.push_back(value);
+
+        if (next == end) {
+            break;
+        }
+
+        if (*next != ',') {
+            throw std::runtime_error(
+                std::string("Fail to decode DOM snapshot column ") + column);
+        }
+
+        ptr = next + 1;
+    }
+}
+
+auto isNameChar(char c) -> bool {
+    return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '-' ||
+           c == '_' || c == ':';
+}
+
+auto toLower(std::string_view str) -> std::string {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return result;
+}
+
+auto hasClass(std::string_view classes, std::string_view name) -> bool {
+    size_t pos = 0;
+
+    while (pos < classes.size()) {
+        while (pos < classes.size() &&
+               std::isspace(static_cast<unsigned char>(classes[pos])) != 0) {
+            pos++;
+        }
+
+        size_t start = pos;
+        while (pos < classes.size() &&
+               std::isspace(static_cast<unsigned char>(classes[pos])) == 0) {
+            pos++;
+        }
+
+        if (classes.substr(start, pos - start) == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+} // namespace
+
+auto DomSnapshot::script() -> const std::string & { return snapshotScript; }
+
+auto DomSnapshot::decode(const Poco::Dynamic::Var &value) -> DomSnapshot {
+    auto obj = value.extract<Poco::JSON::Object::Ptr>();
+    auto stringsArr = obj->getArray("strings");
+
+    if (stringsArr.isNull()) {
+        throw std::runtime_error("Fail to decode DOM snapshot: no strings");
+    }
+
+    DomSnapshot snapshot;
+    snapshot.strings.reserve(stringsArr->size());
+
+    for (unsigned int i = 0; i < stringsArr->size(); i++) {
+        snapshot.strings.push_back(stringsArr->getElement<std::string>(i));
+        snapshot.stringIndex.emplace(snapshot.strings.back(),
+                                     static_cast<uint32_t>(i));
+    }
+
+    std::vector<int64_t> parents;
+    std::vector<int32_t> rects;
+
+    parseList(obj->getValue<std::string>("tag"), snapshot.tags, "tag");
+    parseList(obj->getValue<std::string>("parent"), parents, "parent");
+    parseList(obj->getValue<std::string>("attrOffsets"), snapshot.attrOffsets,
+              "attrOffsets");
+    parseList(obj->getValue<std::string>("attrs"), snapshot.attrPairs,
+              "attrs");
+    parseList(obj->getValue<std::string>("rect"), rects, "rect");
+
+    auto visible = obj->getValue<std::string>("visible");
+    size_t count = snapshot.tags.size();
+
+    if (parents.size() != count || visible.size() != count ||
+        rects.size() != count * 4 ||
+        snapshot.attrOffsets.size() != count + 1 ||
+        snapshot.attrOffsets.back() != snapshot.attrPairs.size()) {
+        throw std::runtime_error(
+            "Fail to decode DOM snapshot: column sizes differ");
+    }
+
+    auto stringCount = snapshot.strings.size();
+
+    for (auto idx : snapshot.tags) {
+        if (idx >= stringCount) {
+            throw std::runtime_error(
+                "Fail to decode DOM snapshot: bad tag index");
+        }
+    }
+
+    for (auto idx : snapshot.attrPairs) {
+        if (idx >= stringCount) {
+            throw std::runtime_error(
+                "Fail to decode DOM snapshot: bad attribute index");
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (snapshot.attrOffsets[i] > snapshot.attrOffsets[i + 1]) {
+            throw std::runtime_error(
+                "Fail to decode DOM snapshot: bad attribute offsets");
+        }
+    }
+
+    snapshot.parents.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        /*
+         Parents always come before their children in document order
+         */
+        if (parents[i] >= static_cast<int64_t>(i)) {
+            throw std::runtime_error(
+                "Fail to decode DOM snapshot: bad parent index");
+        }
+
+        snapshot.parents.push_back(
+            parents[i] < 0 ? npos : static_cast<uint32_t>(parents[i]));
+    }
+
+    snapshot.visible.reserve(count);
+    for (char c : visible) {
+        snapshot.visible.push_back(c == '1' ? 1 : 0);
+    }
+
+    snapshot.rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        snapshot.rects.push_back({rects[i * 4], rects[i * 4 + 1],
+                                  rects[i * 4 + 2], rects[i * 4 + 3]});
+    }
+
+    snapshot.idName = snapshot.lookup("id");
+    snapshot.className = snapshot.lookup("class");
+
+    return snapshot;
+}
+
+auto DomSnapshot::lookup(std::string_view str) const -> uint32_t {
+    auto it = stringIndex.find(std::string(str));
+
+    if (it == stringIndex.end()) {
+        return npos;
+    }
+
+    return it->second;
+}
+
+auto DomSnapshot::attributeValue(uint32_t node, uint32_t name) const
+    -> uint32_t {
+    if (name == npos) {
+        return npos;
+    }
+
+    for (auto i = attrOffsets[node]; i < attrOffsets[node + 1]; i += 2) {
+        if (attrPairs[i] == name) {
+            return attrPairs[i + 1];
+        }
+    }
+
+    return npos;
+}
+
+auto DomSnapshot::attributeValue(uint32_t node, const Name &name) const
+    -> uint32_t {
+    for (auto i = attrOffsets[node]; i < attrOffsets[node + 1]; i += 2) {
+        if (name.matches(attrPairs[i])) {
+            return attrPairs[i + 1];
+        }
+    }
+
+    return npos;
+}
+
+auto DomSnapshot::attribute(uint32_t node, std::string_view name) const
+    -> std::optional<std::string_view> {
+    auto value = attributeValue(node, lookup(name));
+
+    if (value == npos) {
+        return std::nullopt;
+    }
+
+    return strings[value];
+}
+
+auto DomSnapshot::compile(std::string_view selector,
+                          std::vector<Compound> &compounds) const -> bool {
+    size_t pos = 0;
+    bool resolved = true;
+    bool child = false;
+
+    auto fail = [&selector]() {
+        throw std::invalid_argument("Invalid selector: " +
+                                    std::string(selector));
+    };
+
+    auto readName = [&]() -> std::string_view {
+        size_t start = pos;
+        while (pos < selector.size() && isNameChar(selector[pos])) {
+            pos++;
+        }
+
+        if (start == pos) {
+            fail();
+        }
+
+        return selector.substr(start, pos - start);
+    };
+
+    auto resolve = [&](std::string_view str) {
+        auto idx = lookup(str);
+        if (idx == npos) {
+            resolved = false;
+        }
+        return idx;
+    };
+
+    auto resolveName = [&](std::string_view str) {
+        Name name{lookup(str), lookup(toLower(str))};
+        if (name.empty()) {
+            resolved = false;
+        }
+        return name;
+    };
+
+    while (pos < selector.size()) {
+        char c = selector[pos];
+
+        if (std::isspace(static_cast<unsigned char>(c)) != 0) {
+            pos++;
+            continue;
+        }
+
+        if (c == '>') {
+            if (compounds.empty() || child) {
+                fail();
+            }
+            child = true;
+            pos++;
+            continue;
+        }
+
+        Compound compound;
+        compound.child = child;
+        child = false;
+
+        if (c == '*') {
+            pos++;
+        } else if (isNameChar(c)) {
+            compound.tag = resolveName(readName());
+        }
+
+        while (pos < selector.size()) {
+            c = selector[pos];
+
+            if (c == '#') {
+                pos++;
+                if (idName == npos) {
+                    resolved = false;
+                }
+                compound.ids.push_back(resolve(readName()));
+            } else if (c == '.') {
+                pos++;
+                if (className == npos) {
+                    resolved = false;
+                }
+                compound.classes.emplace_back(readName());
+            } else if (c == '[') {
+                pos++;
+                auto name = resolveName(readName());
+                uint32_t value = npos;
+
+                if (pos < selector.size() && selector[pos] == '=') {
+                    pos++;
+
+                    if (pos < selector.size() &&
+                        (selector[pos] == '"' || selector[pos] == '\'')) {
+                        char quote = selector[pos++];
+                        auto end = selector.find(quote, pos);
+                        if (end == std::string_view::npos) {
+                            fail();
+                        }
+                        value = resolve(selector.substr(pos, end - pos));
+                        pos = end + 1;
+                    } else {
+                        value = resolve(readName());
+                    }
+                }
+
+                if (pos >= selector.size() || selector[pos] != ']') {
+                    fail();
+                }
+                pos++;
+
+                compound.attrs.emplace_back(name, value);
+            } else {
+                break;
+            }
+        }
+
+        if (pos < selector.size() && selector[pos] != '>' &&
+            std::isspace(static_cast<unsigned char>(selector[pos])) == 0) {
+            fail();
+        }
+
+        compounds.push_back(std::move(compound));
+    }
+
+    if (compounds.empty() || child) {
+        fail();
+    }
+
+    return resolved;
+}
+
+auto DomSnapshot::matches(uint32_t node, const Compound &compound) const
+    -> bool {
+    if (!compound.tag.empty() && !compound.tag.matches(tags[node])) {
+        return false;
+    }
+
+    for (auto id : compound.ids) {
+        if (attributeValue(node, idName) != id) {
+            return false;
+        }
+    }
+
+    if (!compound.classes.empty()) {
+        auto value = attributeValue(node, className);
+        if (value == npos) {
+            return false;
+        }
+
+        for (const auto &name : compound.classes) {
+            if (!hasClass(strings[value], name)) {
+                return false;
+            }
+        }
+    }
+
+    for (const auto &[name, required] : compound.attrs) {
+        auto value = attributeValue(node, name);
+
+        if (value == npos || (required != npos && value != required)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+auto DomSnapshot::matchesFrom(uint32_t node,
+                              const std::vector<Compound> &compounds,
+                              size_t index) const -> bool {
+    if (!matches(node, compounds[index])) {
+        return false;
+    }
+
+    if (index == 0) {
+        return true;
+    }
+
+    if (compounds[index].child) {
+        return parents[node] != npos &&
+               matchesFrom(parents[node], compounds, index - 1);
+    }
+
+    for (auto p = parents[node]; p != npos; p = parents[p]) {
+        if (matchesFrom(p, compounds, index - 1)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto DomSnapshot::querySelectorAll(std::string_view selector) const
+    -> std::vector<uint32_t> {
+    std::vector<uint32_t> result;
+    std::vector<Compound> compounds;
+
+    if (!compile(selector, compounds)) {
+        return result;
+    }
+
+    auto last = compounds.size() - 1;
+    auto count = static_cast<uint32_t>(tags.size());
+
+    for (uint32_t node = 0; node < count; node++) {
+        if (matchesFrom(node, compounds, last)) {
+            result.push_back(node);
+        }
+    }
+
+    return result;
+}
+
+auto DomSnapshot::querySelector(std::string_view selector) const
+    -> std::optional<uint32_t> {
+    std::vector<Compound> compounds;
+
+    if (!compile(selector, compounds)) {
+        return std::nullopt;
+    }
+
+    auto last = compounds.size() - 1;
+    auto count = static_cast<uint32_t>(tags.size());
+
+    for (uint32_t node = 0; node < count; node++) {
+        if (matchesFrom(node, compounds, last)) {
+            return node;
+        }
+    }
+
+    return std::nullopt;
+}
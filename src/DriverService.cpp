@@ -0,0 +1,381 @@
+/**
+ *@file DriverService.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief DriverService definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "DriverService.hpp"
+#include "CurlRAII.hpp"
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Parser.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <future>
+#include <iostream>
+#include <netinet/in.h>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+DriverService::DriverService(DriverServiceOptions options)
+    : options(std::move(options)) {}
+
+DriverService::~DriverService() { stop(); }
+
+void DriverService::start() {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (running) {
+            return;
+        }
+    }
+
+    std::vector<std::future<Instance>> starting;
+    size_t total = options.instances + options.warmSpares;
+
+    for (size_t i = 0; i < total; i++) {
+        starting.push_back(std::async(std::launch::async, [this]() {
+            return spawn(findFreePort());
+        }));
+    }
+
+    std::vector<Instance> started;
+    std::exception_ptr error;
+
+    for (auto &fut : starting) {
+        try {
+            started.push_back(fut.get());
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    if (error) {
+        for (auto &inst : started) {
+            terminate(inst);
+        }
+        std::rethrow_exception(error);
+    }
+
+    for (size_t i = options.instances; i < started.size(); i++) {
+        started[i].spare = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (!running) {
+            instances = std::move(started);
+            running = true;
+            monitor = std::thread(&DriverService::monitorLoop, this);
+            return;
+        }
+    }
+
+    /*
+     A concurrent start() finished first, its drivers are the ones kept
+     */
+    for (auto &inst : started) {
+        terminate(inst);
+    }
+}
+
+void DriverService::stop() {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        running = false;
+    }
+
+    wakeMonitor.notify_all();
+
+    if (monitor.joinable()) {
+        monitor.join();
+    }
+
+    std::lock_guard<std::mutex> lck(mtx);
+
+    for (auto &inst : instances) {
+        terminate(inst);
+    }
+
+    instances.clear();
+}
+
+auto DriverService::acquire() -> std::string {
+    std::unique_lock<std::mutex> lck(mtx);
+    Instance *best = nullptr;
+
+    for (auto &inst : instances) {
+        if (inst.spare || inst.pid <= 0 ||
+            inst.sessions >= options.maxSessionsPerDriver) {
+            continue;
+        }
+
+        if (best == nullptr || inst.sessions < best->sessions) {
+            best = &inst;
+        }
+    }
+
+    if (best == nullptr) {
+        for (auto &inst : instances) {
+            if (inst.spare && inst.pid > 0) {
+                inst.spare = false;
+                best = &inst;
+                wakeMonitor.notify_all();
+                break;
+            }
+        }
+    }
+
+    if (best == nullptr) {
+        /*
+        No spare was ready, start one in place without holding the lock
+        */
+        lck.unlock();
+        auto inst = spawn(findFreePort());
+        lck.lock();
+
+        instances.push_back(std::move(inst));
+        best = &instances.back();
+    }
+
+    best->sessions++;
+    return best->url;
+}
+
+void DriverService::release(const std::string &url) {
+    std::lock_guard<std::mutex> lck(mtx);
+
+    for (auto &inst : instances) {
+        if (inst.url == url && inst.sessions > 0) {
+            inst.sessions--;
+            return;
+        }
+    }
+}
+
+auto DriverService::driverUrls() const -> std::vector<std::string> {
+    std::lock_guard<std::mutex> lck(mtx);
+    std::vector<std::string> result;
+
+    for (const auto &inst : instances) {
+        if (!inst.spare && inst.pid > 0) {
+            result.push_back(inst.url);
+        }
+    }
+
+    return result;
+}
+
+auto DriverService::findFreePort() -> uint16_t {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        throw std::runtime_error("socket: " + std::string(strerror(errno)));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    socklen_t len = sizeof(addr);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        auto err = errno;
+        ::close(fd);
+        throw std::runtime_error("bind: " + std::string(strerror(err)));
+    }
+
+    ::close(fd);
+    return ntohs(addr.sin_port);
+}
+
+auto DriverService::isReady(const std::string &url) -> bool {
+    auto res = CurlRAII::instance().request("GET", url + "/status");
+
+    if (res.curl_perfm_res != CURLE_OK || res.buffer.empty()) {
+        return false;
+    }
+
+    try {
+        auto obj = Poco::JSON::Parser()
+                       .parse(res.buffer)
+                       .extract<Poco::JSON::Object::Ptr>();
+        auto value = obj->getObject("value");
+
+        return !value.isNull() && value->optValue<bool>("ready", false);
+    } catch (const std::exception &e) {
+        std::cerr << "Invalid /status response from " << url << ": "
+                  << e.what() << std::endl;
+    }
+
+    return false;
+}
+
+auto DriverService::spawn(uint16_t port) const -> Instance {
+    std::vector<std::string> args{options.executable,
+                                  "--port=" + std::to_string(port)};
+    args.insert(args.end(), options.extraArgs.begin(), options.extraArgs.end());
+
+    std::vector<char *> argv;
+    argv.reserve(args.size() + 1);
+
+    for (auto &arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    Instance inst;
+    inst.port = port;
+    inst.url = "http://127.0.0.1:" + std::to_string(port);
+
+    /*
+     The driver reads nothing, stdin is /dev/null so it never takes the
+     terminal input of the client
+     */
+    posix_spawn_file_actions_t actions;
+    int res = posix_spawn_file_actions_init(&actions);
+
+    if (res == 0) {
+        res = posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
+                                               "/dev/null", O_RDONLY, 0);
+
+        if (res == 0) {
+            res = posix_spawnp(&inst.pid, options.executable.c_str(),
+                               &actions, nullptr, argv.data(), environ);
+        }
+
+        posix_spawn_file_actions_destroy(&actions);
+    }
+
+    if (res != 0) {
+        throw std::runtime_error("Fail to spawn " + options.executable + ": " +
+                                 strerror(res));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + options.readyTimeout;
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (isReady(inst.url)) {
+            return inst;
+        }
+
+        int status = 0;
+        if (waitpid(inst.pid, &status, WNOHANG) == inst.pid) {
+            throw std::runtime_error(options.executable + " exited during "
+                                                          "startup");
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    terminate(inst);
+    throw std::runtime_error(options.executable + " did not become ready on " +
+                             inst.url);
+}
+
+void DriverService::terminate(Instance &instance) {
+    if (instance.pid <= 0) {
+        return;
+    }
+
+    kill(instance.pid, SIGTERM);
+
+    int status = 0;
+    for (int i = 0; i < 40; i++) {
+        if (waitpid(instance.pid, &status, WNOHANG) != 0) {
+            instance.pid = -1;
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    kill(instance.pid, SIGKILL);
+    waitpid(instance.pid, &status, 0);
+    instance.pid = -1;
+}
+
+void DriverService::monitorLoop() {
+    std::unique_lock<std::mutex> lck(mtx);
+
+    while (running) {
+        wakeMonitor.wait_for(lck, options.monitorInterval);
+
+        if (!running) {
+            break;
+        }
+
+        std::vector<std::pair<size_t, uint16_t>> toRestart;
+        size_t spares = 0;
+
+        for (size_t i = 0; i < instances.size(); i++) {
+            auto &inst = instances[i];
+            int status = 0;
+
+            if (inst.pid > 0 &&
+                waitpid(inst.pid, &status, WNOHANG) == inst.pid) {
+                std::cerr << options.executable << " on " << inst.url
+                          << " exited, restarting" << std::endl;
+                inst.pid = -1;
+                inst.sessions = 0;
+            }
+
+            if (inst.pid <= 0) {
+                toRestart.emplace_back(i, inst.port);
+            } else if (inst.spare) {
+                spares++;
+            }
+        }
+
+        /*
+        Instances are only appended while the lock is released, so the
+        indexes stay valid. stop() terminates whatever is added here after
+        joining this thread
+        */
+        lck.unlock();
+
+        std::vector<std::pair<size_t, Instance>> restarted;
+        for (const auto &entry : toRestart) {
+            try {
+                restarted.emplace_back(entry.first, spawn(entry.second));
+            } catch (const std::exception &e) {
+                std::cerr << "Fail to restart driver on port " << entry.second
+                          << ": " << e.what() << std::endl;
+            }
+        }
+
+        std::vector<Instance> newSpares;
+        for (; spares < options.warmSpares; spares++) {
+            try {
+                newSpares.push_back(spawn(findFreePort()));
+                newSpares.back().spare = true;
+            } catch (const std::exception &e) {
+                std::cerr << "Fail to start spare driver: " << e.what()
+                          << std::endl;
+                break;
+            }
+        }
+
+        lck.lock();
+
+        for (auto &entry : restarted) {
+            entry.second.spare = instances[entry.first].spare;
+            instances[entry.first] = std::move(entry.second);
+        }
+
+        for (auto &inst : newSpares) {
+            instances.push_back(std::move(inst));
+        }
+    }
+}
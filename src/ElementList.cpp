@@ -0,0 +1,133 @@
+/**
+ *@file ElementList.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief ElementList definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "ElementList.hpp"
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+auto skipSpace(std::string_view json, size_t pos) -> size_t {
+    while (pos < json.size() &&
+           (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' ||
+            json[pos] == '\r')) {
+        ++pos;
+    }
+
+    return pos;
+}
+} // namespace
+
+auto ElementList::parse(std::string_view json) -> ElementList {
+    /*
+     The key is searched with its quotes, ids never hold a quote or a
+     backslash so the match cannot be inside another string
+     */
+    std::string quotedKey = "\"" + std::string(elementKey) + "\"";
+    ElementList list;
+    size_t pos = 0;
+
+    while ((pos = json.find(quotedKey, pos)) != std::string_view::npos) {
+        pos = skipSpace(json, pos + quotedKey.size());
+
+        if (pos >= json.size() || json[pos] != ':') {
+            throw std::invalid_argument("Invalid element reference");
+        }
+
+        pos = skipSpace(json, pos + 1);
+
+        if (pos >= json.size() || json[pos] != '"') {
+            throw std::invalid_argument("Invalid element reference");
+        }
+
+        size_t begin = pos + 1;
+        size_t end = json.find('"', begin);
+
+        if (end == std::string_view::npos) {
+            throw std::invalid_argument("Truncated element reference");
+        }
+
+        auto id = json.substr(begin, end - begin);
+
+        if (id.find('\\') != std::string_view::npos) {
+            throw std::invalid_argument("Escaped element id " +
+                                        std::string(id));
+        }
+
+        list.push_back(id);
+        pos = end + 1;
+    }
+
+    return list;
+}
+
+void ElementList::push_back(std::string_view id) {
+    if (ids.size() + id.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Too many element ids");
+    }
+
+    ids += id;
+    ends.push_back(static_cast<uint32_t>(ids.size()));
+}
+
+void ElementList::append(const ElementList &other) {
+    ids.reserve(ids.size() + other.ids.size());
+    ends.reserve(ends.size() + other.ends.size());
+
+    for (auto id : other) {
+        push_back(id);
+    }
+}
+
+void ElementList::clear() {
+    ids.clear();
+    ends.clear();
+}
+
+auto ElementList::reference(size_t index) const -> Poco::JSON::Object::Ptr {
+    Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+    obj->set(std::string(elementKey), std::string((*this)[index]));
+    return obj;
+}
+
+auto ElementList::toVector() const -> std::vector<std::string> {
+    std::vector<std::string> out;
+    out.reserve(size());
+
+    for (auto id : *this) {
+        out.emplace_back(id);
+    }
+
+    return out;
+}
+
+auto ElementPage::parseTotal(std::string_view json) -> size_t {
+    constexpr std::string_view key = "\"total\"";
+    size_t pos = json.find(key);
+
+    if (pos != std::string_view::npos) {
+        pos = skipSpace(json, pos + key.size());
+    }
+
+    if (pos == std::string_view::npos || pos >= json.size() ||
+        json[pos] != ':') {
+        throw std::invalid_argument("Element page without total");
+    }
+
+    pos = skipSpace(json, pos + 1);
+
+    size_t total = 0;
+    auto [end, ec] =
+        std::from_chars(json.data() + pos, json.data() + json.size(), total);
+
+    if (ec != std::errc()) {
+        throw std::invalid_argument("Invalid element page total");
+    }
+
+    return total;
+}
@@ -0,0 +1,258 @@
+/**
+ *@file FileDownload.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief FileDownload definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "FileDownload.hpp"
+#include <Poco/InflatingStream.h>
+#include <algorithm>
+#include <stdexcept>
+#include <streambuf>
+#include <string_view>
+
+namespace {
+constexpr size_t localHeaderSize = 30;
+constexpr size_t centralHeaderSize = 46;
+constexpr size_t endRecordSize = 22;
+
+/*
+ Enough for the central directory and end record of a one file zip with the
+ longest name, extra field and comment
+ */
+constexpr size_t tailLimit = 256 * 1024;
+
+constexpr uint16_t dataDescriptorFlag = 0x0008;
+constexpr uint16_t storedMethod = 0;
+constexpr uint16_t deflatedMethod = 8;
+
+/*
+ Negative window bits select a raw deflate stream, without zlib header
+ */
+constexpr int rawDeflateWindowBits = -15;
+
+auto le16(const std::string &data, size_t pos) -> uint16_t {
+    return static_cast<uint16_t>(
+        static_cast<unsigned char>(data[pos]) |
+        (static_cast<unsigned char>(data[pos + 1]) << 8));
+}
+
+auto le32(const std::string &data, size_t pos) -> uint32_t {
+    return le16(data, pos) | (uint32_t{le16(data, pos + 2)} << 16);
+}
+} // namespace
+
+/*
+ Output of the inflater, each byte goes through writeFile()
+ */
+class ZipDownloadSink::FileBuf : public std::streambuf {
+  public:
+    explicit FileBuf(ZipDownloadSink &sink) : sink(sink) {}
+
+  protected:
+    auto xsputn(const char *data, std::streamsize len)
+        -> std::streamsize override {
+        sink.writeFile(data, static_cast<size_t>(len));
+        return len;
+    }
+
+    auto overflow(int_type ch) -> int_type override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            char byte = traits_type::to_char_type(ch);
+            sink.writeFile(&byte, 1);
+        }
+
+        return traits_type::not_eof(ch);
+    }
+
+  private:
+    ZipDownloadSink &sink;
+};
+
+ZipDownloadSink::ZipDownloadSink(std::ostream &out)
+    : Base64ResponseSink("contents"), out(out),
+      fileBuf(std::make_unique<FileBuf>(*this)),
+      file(std::make_unique<std::ostream>(fileBuf.get())) {
+    /*
+     Errors of out and of the inflater reach decoded() instead of only
+     setting the stream state
+     */
+    file->exceptions(std::ios::badbit);
+}
+
+ZipDownloadSink::~ZipDownloadSink() = default;
+
+void ZipDownloadSink::decoded(const char *data, size_t len) {
+    auto keepTail = [this](const char *bytes, size_t count) {
+        if (tail.empty()) {
+            tailOffset = zipOffset;
+        }
+
+        tail.append(bytes, count);
+
+        if (tail.size() > 2 * tailLimit) {
+            size_t drop = tail.size() - tailLimit;
+            tail.erase(0, drop);
+            tailOffset += drop;
+        }
+    };
+
+    size_t i = 0;
+
+    while (i < len) {
+        switch (zipState) {
+        case ZipState::LocalHeader: {
+            size_t take = std::min(len - i, localHeaderSize - header.size());
+            header.append(data + i, take);
+            i += take;
+            zipOffset += take;
+
+            if (header.size() < localHeaderSize) {
+                break;
+            }
+
+            if (le32(header, 0) != 0x04034b50) {
+                throw std::runtime_error("Fail to download: not a zip file");
+            }
+
+            flags = le16(header, 6);
+            method = le16(header, 8);
+            sizeKnown = (flags & dataDescriptorFlag) == 0;
+            dataLeft = le32(header, 18);
+
+            if (method != storedMethod && method != deflatedMethod) {
+                throw std::runtime_error(
+                    "Fail to download: unsupported zip method " +
+                    std::to_string(method));
+            }
+
+            /*
+             Only a deflate stream tells where it ends when the size comes
+             after the data
+             */
+            if (method == storedMethod && !sizeKnown) {
+                throw std::runtime_error(
+                    "Fail to download: stored zip entry without size");
+            }
+
+            zipState = ZipState::EntryName;
+            break;
+        }
+
+        case ZipState::EntryName: {
+            size_t nameLength = le16(header, 26);
+            size_t headerEnd =
+                localHeaderSize + nameLength + le16(header, 28);
+            size_t take = std::min(len - i, headerEnd - header.size());
+            header.append(data + i, take);
+            i += take;
+            zipOffset += take;
+
+            if (header.size() < headerEnd) {
+                break;
+            }
+
+            entryName = header.substr(localHeaderSize, nameLength);
+
+            if (method == deflatedMethod) {
+                inflater = std::make_unique<Poco::InflatingOutputStream>(
+                    *file, rawDeflateWindowBits);
+                inflater->exceptions(std::ios::badbit);
+            }
+
+            zipState = ZipState::Data;
+            break;
+        }
+
+        case ZipState::Data: {
+            /*
+             Without a size the whole rest goes to the inflater, which
+             ignores what follows the end of the deflate stream. The tail
+             then holds the central directory
+             */
+            size_t take = sizeKnown ? static_cast<size_t>(std::min<uint64_t>(
+                                          len - i, dataLeft))
+                                    : len - i;
+
+            if (inflater) {
+                inflater->write(data + i, static_cast<std::streamsize>(take));
+            } else {
+                writeFile(data + i, take);
+            }
+
+            if (!sizeKnown) {
+                keepTail(data + i, take);
+            } else {
+                dataLeft -= take;
+            }
+
+            i += take;
+            zipOffset += take;
+
+            if (sizeKnown && dataLeft == 0) {
+                zipState = ZipState::Trailer;
+            }
+            break;
+        }
+
+        case ZipState::Trailer:
+            keepTail(data + i, len - i);
+            zipOffset += len - i;
+            i = len;
+            break;
+        }
+    }
+}
+
+void ZipDownloadSink::writeFile(const char *data, size_t len) {
+    checksum.update(data, static_cast<unsigned>(len));
+    written += len;
+
+    if (!out.write(data, static_cast<std::streamsize>(len))) {
+        throw std::runtime_error("Fail to write the downloaded file");
+    }
+}
+
+void ZipDownloadSink::finish() {
+    if (!complete()) {
+        throw std::runtime_error(
+            "Fail to download: response without file contents");
+    }
+
+    if (inflater) {
+        inflater->close();
+    }
+
+    if (!out.flush()) {
+        throw std::runtime_error("Fail to write the downloaded file");
+    }
+
+    std::string_view view(tail);
+    auto endRecord = view.rfind(std::string_view("PK\x05\x06", 4));
+
+    if (endRecord == std::string_view::npos ||
+        endRecord + endRecordSize > tail.size()) {
+        throw std::runtime_error("Fail to download " + entryName +
+                                 ": truncated zip");
+    }
+
+    uint64_t directory = le32(tail, endRecord + 16);
+
+    if (directory < tailOffset ||
+        directory - tailOffset + centralHeaderSize > tail.size() ||
+        le32(tail, static_cast<size_t>(directory - tailOffset)) !=
+            0x02014b50) {
+        throw std::runtime_error("Fail to download " + entryName +
+                                 ": invalid zip central directory");
+    }
+
+    auto entry = static_cast<size_t>(directory - tailOffset);
+
+    if (le32(tail, entry + 16) != checksum.checksum() ||
+        le32(tail, entry + 24) != written) {
+        throw std::runtime_error("Fail to download " + entryName +
+                                 ": content does not match the zip CRC32");
+    }
+}
@@ -0,0 +1,284 @@
+/**
+ *@file FileUpload.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief FileUpload definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "FileUpload.hpp"
+#include <Poco/Checksum.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+constexpr std::string_view bodyPrefix = "{\"file\":\"";
+constexpr std::string_view bodySuffix = "\"}";
+
+/*
+ Zip bytes encoded per refill, a multiple of 3 so only the last chunk is
+ padded
+ */
+constexpr size_t encodeChunk = 48 * 1024;
+
+constexpr uint32_t localHeaderSize = 30;
+constexpr uint32_t centralHeaderSize = 46;
+constexpr uint32_t endRecordSize = 22;
+
+/*
+ Version 2.0, flag bit 11 marks the entry name as UTF-8. The timestamp does
+ not matter to the driver, 1980-01-01 keeps the body reproducible
+ */
+constexpr uint16_t zipVersion = 20;
+constexpr uint16_t utf8NameFlag = 0x0800;
+constexpr uint16_t dosDate = (1 << 5) | 1;
+
+constexpr std::string_view base64Alphabet =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void appendLe16(std::string &out, uint16_t value) {
+    out.push_back(static_cast<char>(value & 0xFF));
+    out.push_back(static_cast<char>(value >> 8));
+}
+
+void appendLe32(std::string &out, uint32_t value) {
+    appendLe16(out, static_cast<uint16_t>(value & 0xFFFF));
+    appendLe16(out, static_cast<uint16_t>(value >> 16));
+}
+
+/*
+ Fields shared by the local and central headers, from the version needed to
+ the extra field length
+ */
+void appendEntryFields(std::string &out, uint32_t crc, uint32_t size,
+                       uint16_t nameLength) {
+    appendLe16(out, zipVersion);
+    appendLe16(out, utf8NameFlag);
+    appendLe16(out, 0); // stored
+    appendLe16(out, 0);
+    appendLe16(out, dosDate);
+    appendLe32(out, crc);
+    appendLe32(out, size);
+    appendLe32(out, size);
+    appendLe16(out, nameLength);
+    appendLe16(out, 0);
+}
+
+/*
+ Encode data, whole groups of 3 bytes unless pad is set
+ */
+void appendBase64(std::string &out, const unsigned char *data, size_t len,
+                  bool pad) {
+    size_t i = 0;
+
+    for (; i + 3 <= len; i += 3) {
+        uint32_t group = (uint32_t{data[i]} << 16) |
+                         (uint32_t{data[i + 1]} << 8) | data[i + 2];
+        out.push_back(base64Alphabet[(group >> 18) & 0x3F]);
+        out.push_back(base64Alphabet[(group >> 12) & 0x3F]);
+        out.push_back(base64Alphabet[(group >> 6) & 0x3F]);
+        out.push_back(base64Alphabet[group & 0x3F]);
+    }
+
+    if (!pad || i == len) {
+        return;
+    }
+
+    uint32_t group = uint32_t{data[i]} << 16;
+
+    if (i + 1 < len) {
+        group |= uint32_t{data[i + 1]} << 8;
+    }
+
+    out.push_back(base64Alphabet[(group >> 18) & 0x3F]);
+    out.push_back(base64Alphabet[(group >> 12) & 0x3F]);
+    out.push_back(i + 1 < len ? base64Alphabet[(group >> 6) & 0x3F] : '=');
+    out.push_back('=');
+}
+} // namespace
+
+ZipUploadBody::ZipUploadBody(std::filesystem::path file)
+    : path(std::move(file)), file(path, std::ios::binary) {
+    if (!this->file) {
+        throw std::runtime_error("Fail to open " + path.string());
+    }
+
+    fileSize = std::filesystem::file_size(path);
+
+    std::string name = path.filename().string();
+    uint64_t headers = localHeaderSize + centralHeaderSize + endRecordSize +
+                       2 * uint64_t{name.size()};
+
+    if (name.size() > std::numeric_limits<uint16_t>::max() ||
+        fileSize + headers > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Fail to upload " + path.string() +
+                                 ": too big for a zip without zip64");
+    }
+
+    Poco::Checksum checksum(Poco::Checksum::TYPE_CRC32);
+    std::array<char, 64 * 1024> buffer{};
+    uint64_t total = 0;
+
+    while (this->file.read(buffer.data(), buffer.size()) ||
+           this->file.gcount() > 0) {
+        auto got = static_cast<size_t>(this->file.gcount());
+        checksum.update(buffer.data(), static_cast<unsigned>(got));
+        total += got;
+    }
+
+    if (total != fileSize) {
+        throw std::runtime_error("Fail to upload " + path.string() +
+                                 ": file changed while reading");
+    }
+
+    crc = checksum.checksum();
+
+    auto size32 = static_cast<uint32_t>(fileSize);
+    auto nameLength = static_cast<uint16_t>(name.size());
+
+    appendLe32(localHeader, 0x04034b50);
+    appendEntryFields(localHeader, crc, size32, nameLength);
+    localHeader += name;
+
+    appendLe32(trailer, 0x02014b50);
+    appendLe16(trailer, zipVersion); // made by
+    appendEntryFields(trailer, crc, size32, nameLength);
+    appendLe16(trailer, 0); // comment length
+    appendLe16(trailer, 0); // disk number
+    appendLe16(trailer, 0); // internal attributes
+    appendLe32(trailer, 0); // external attributes
+    appendLe32(trailer, 0); // local header offset
+    trailer += name;
+
+    auto directoryOffset =
+        static_cast<uint32_t>(localHeader.size() + fileSize);
+
+    appendLe32(trailer, 0x06054b50);
+    appendLe16(trailer, 0);
+    appendLe16(trailer, 0);
+    appendLe16(trailer, 1);
+    appendLe16(trailer, 1);
+    appendLe32(trailer, centralHeaderSize + nameLength);
+    appendLe32(trailer, directoryOffset);
+    appendLe16(trailer, 0);
+
+    rewind();
+}
+
+auto ZipUploadBody::zipSize() const -> uint64_t {
+    return localHeader.size() + fileSize + trailer.size();
+}
+
+auto ZipUploadBody::size() const -> uint64_t {
+    return bodyPrefix.size() + base64Size(zipSize()) + bodySuffix.size();
+}
+
+void ZipUploadBody::rewind() {
+    file.clear();
+    file.seekg(0);
+    zipOffset = 0;
+    stage = Stage::Prefix;
+    pending.clear();
+    pendingPos = 0;
+    carry.clear();
+}
+
+auto ZipUploadBody::read(char *out, size_t len) -> size_t {
+    size_t written = 0;
+
+    while (written < len) {
+        if (pendingPos == pending.size()) {
+            if (stage == Stage::Done) {
+                break;
+            }
+
+            refill();
+            continue;
+        }
+
+        size_t count = std::min(len - written, pending.size() - pendingPos);
+        std::memcpy(out + written, pending.data() + pendingPos, count);
+        pendingPos += count;
+        written += count;
+    }
+
+    return written;
+}
+
+void ZipUploadBody::refill() {
+    pending.clear();
+    pendingPos = 0;
+
+    switch (stage) {
+    case Stage::Prefix:
+        pending = bodyPrefix;
+        stage = Stage::Data;
+        break;
+
+    case Stage::Data: {
+        std::string chunk = std::move(carry);
+        size_t used = chunk.size();
+        chunk.resize(encodeChunk);
+        used += readZip(chunk.data() + used, encodeChunk - used);
+
+        bool last = zipOffset == zipSize();
+        size_t encoded = last ? used : used - used % 3;
+
+        appendBase64(pending,
+                     reinterpret_cast<const unsigned char *>(chunk.data()),
+                     encoded, last);
+        carry.assign(chunk, encoded, used - encoded);
+
+        if (last) {
+            stage = Stage::Suffix;
+        }
+        break;
+    }
+
+    case Stage::Suffix:
+        pending = bodySuffix;
+        stage = Stage::Done;
+        break;
+
+    case Stage::Done:
+        break;
+    }
+}
+
+auto ZipUploadBody::readZip(char *out, size_t len) -> size_t {
+    size_t written = 0;
+    uint64_t dataEnd = localHeader.size() + fileSize;
+
+    while (written < len && zipOffset < zipSize()) {
+        size_t count = 0;
+
+        if (zipOffset < localHeader.size()) {
+            auto offset = static_cast<size_t>(zipOffset);
+            count = std::min(len - written, localHeader.size() - offset);
+            std::memcpy(out + written, localHeader.data() + offset, count);
+        } else if (zipOffset < dataEnd) {
+            auto want = static_cast<std::streamsize>(
+                std::min<uint64_t>(len - written, dataEnd - zipOffset));
+            file.read(out + written, want);
+            count = static_cast<size_t>(file.gcount());
+
+            if (count == 0) {
+                throw std::runtime_error("Fail to upload " + path.string() +
+                                         ": file changed while sending");
+            }
+        } else {
+            auto offset = static_cast<size_t>(zipOffset - dataEnd);
+            count = std::min(len - written, trailer.size() - offset);
+            std::memcpy(out + written, trailer.data() + offset, count);
+        }
+
+        written += count;
+        zipOffset += count;
+    }
+
+    return written;
+}
@@ -0,0 +1,305 @@
+/**
+ *@file PageText.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief PageText definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "PageText.hpp"
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+/*
+ Visibility and block level ancestor are computed once per element. Each
+ record is "x,y,width,height,length:text", joined into one string so the
+ response holds a single JSON value
+ */
+const std::string extractScript = R"js(/* extractText */
+var root = document.querySelector(arguments[0]), viewportOnly = arguments[1],
+    minLength = Math.max(arguments[2], 1), maxBlocks = arguments[3];
+if (!root) { return null; }
+var skip = {SCRIPT: 1, STYLE: 1, NOSCRIPT: 1, TEMPLATE: 1};
+var shown = new Map(), blockOf = new Map();
+function visible(el) {
+  var v = shown.get(el);
+  if (v === undefined) {
+    v = !skip[el.tagName] && (el.checkVisibility
+      ? el.checkVisibility({opacityProperty: true, visibilityProperty: true})
+      : el.getClientRects().length > 0 &&
+        getComputedStyle(el).visibility !== 'hidden');
+    shown.set(el, v);
+  }
+  return v;
+}
+function block(el) {
+  var b = blockOf.get(el);
+  if (b === undefined) {
+    var d = getComputedStyle(el).display;
+    b = el !== root && el.parentElement &&
+        (d.indexOf('inline') === 0 || d === 'contents')
+      ? block(el.parentElement) : el;
+    blockOf.set(el, b);
+  }
+  return b;
+}
+function utf8Length(s) {
+  var n = s.length;
+  for (var i = 0; i < s.length; i++) {
+    var c = s.charCodeAt(i);
+    if (c < 0x80) { continue; }
+    if (c >= 0xD800 && c <= 0xDBFF && i + 1 < s.length &&
+        (s.charCodeAt(i + 1) & 0xFC00) === 0xDC00) {
+      n += 2; i++;
+    } else {
+      n += c < 0x800 ? 1 : 2;
+    }
+  }
+  return n;
+}
+var out = [], parts = [], current = null, count = 0;
+function flush() {
+  var text = parts.join('').replace(/\s+/g, ' ').trim();
+  parts = [];
+  if (current === null || text.length < minLength) { return; }
+  var r = current.getBoundingClientRect();
+  if (viewportOnly && (r.bottom <= 0 || r.right <= 0 ||
+      r.top >= innerHeight || r.left >= innerWidth)) { return; }
+  out.push(Math.round(r.x) + ',' + Math.round(r.y) + ',' +
+           Math.round(r.width) + ',' + Math.round(r.height) + ',' +
+           utf8Length(text) + ':' + text);
+  count++;
+}
+var walker = document.createTreeWalker(root, NodeFilter.SHOW_TEXT);
+for (var node = walker.nextNode(); node && !(maxBlocks && count >= maxBlocks);
+     node = walker.nextNode()) {
+  var el = node.parentElement;
+  if (!el || !visible(el)) { continue; }
+  var b = block(el);
+  if (b !== current) { flush(); current = b; }
+  parts.push(node.data);
+}
+if (!(maxBlocks && count >= maxBlocks)) { flush(); }
+return out.join('');
+)js";
+
+auto skipSpace(std::string_view json, size_t pos) -> size_t {
+    while (pos < json.size() &&
+           (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' ||
+            json[pos] == '\r')) {
+        ++pos;
+    }
+
+    return pos;
+}
+
+void appendUtf8(std::string &out, uint32_t code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+auto hex4(std::string_view json, size_t pos) -> uint32_t {
+    uint32_t value = 0;
+
+    if (pos + 4 > json.size() ||
+        std::from_chars(json.data() + pos, json.data() + pos + 4, value, 16)
+                .ptr != json.data() + pos + 4) {
+        throw std::runtime_error("Fail to decode page text: bad \\u escape");
+    }
+
+    return value;
+}
+
+/*
+ Unescape the JSON string starting after the opening quote at pos
+ */
+auto unescapeString(std::string_view json, size_t pos) -> std::string {
+    std::string out;
+    out.reserve(json.size() - pos);
+
+    while (true) {
+        size_t special = json.find_first_of("\"\\", pos);
+
+        if (special == std::string_view::npos) {
+            throw std::runtime_error("Fail to decode page text: truncated");
+        }
+
+        out.append(json, pos, special - pos);
+        pos = special + 1;
+
+        if (json[special] == '"') {
+            return out;
+        }
+
+        if (pos >= json.size()) {
+            throw std::runtime_error("Fail to decode page text: truncated");
+        }
+
+        char escaped = json[pos++];
+
+        switch (escaped) {
+        case 'b':
+            out.push_back('\b');
+            break;
+        case 'f':
+            out.push_back('\f');
+            break;
+        case 'n':
+            out.push_back('\n');
+            break;
+        case 'r':
+            out.push_back('\r');
+            break;
+        case 't':
+            out.push_back('\t');
+            break;
+        case 'u': {
+            uint32_t code = hex4(json, pos);
+            pos += 4;
+
+            /*
+             A lone surrogate becomes U+FFFD, as the script counts it
+             */
+            if (code >= 0xD800 && code <= 0xDBFF && pos + 6 <= json.size() &&
+                json[pos] == '\\' && json[pos + 1] == 'u') {
+                uint32_t low = hex4(json, pos + 2);
+
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 6;
+                }
+            }
+
+            if (code >= 0xD800 && code <= 0xDFFF) {
+                code = 0xFFFD;
+            }
+
+            appendUtf8(out, code);
+            break;
+        }
+        default:
+            out.push_back(escaped);
+            break;
+        }
+    }
+}
+
+template <class T>
+auto readNumber(std::string_view str, size_t &pos, char end) -> T {
+    T value{};
+    auto [ptr, ec] =
+        std::from_chars(str.data() + pos, str.data() + str.size(), value);
+
+    if (ec != std::errc() || ptr == str.data() + str.size() || *ptr != end) {
+        throw std::runtime_error("Fail to decode page text: bad record header");
+    }
+
+    pos = static_cast<size_t>(ptr - str.data()) + 1;
+    return value;
+}
+} // namespace
+
+auto TextExtractionOptions::scriptArgs() const -> Poco::JSON::Array::Ptr {
+    Poco::JSON::Array::Ptr args = new Poco::JSON::Array;
+    args->add(root);
+    args->add(viewportOnly);
+    args->add(minLength);
+    args->add(maxBlocks);
+    return args;
+}
+
+auto PageText::script() -> const std::string & { return extractScript; }
+
+auto PageText::decode(std::string encoded) -> PageText {
+    if (encoded.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Fail to decode page text: too large");
+    }
+
+    PageText page;
+    page.buffer = std::move(encoded);
+    std::string_view data(page.buffer);
+    size_t pos = 0;
+
+    while (pos < data.size()) {
+        Rect rect;
+        rect.x = readNumber<int32_t>(data, pos, ',');
+        rect.y = readNumber<int32_t>(data, pos, ',');
+        rect.width = readNumber<int32_t>(data, pos, ',');
+        rect.height = readNumber<int32_t>(data, pos, ',');
+        auto length = readNumber<uint32_t>(data, pos, ':');
+
+        if (length > data.size() - pos) {
+            throw std::runtime_error(
+                "Fail to decode page text: record past the end");
+        }
+
+        page.offsets.push_back(static_cast<uint32_t>(pos));
+        page.lengths.push_back(length);
+        page.rects.push_back(rect);
+        pos += length;
+    }
+
+    return page;
+}
+
+auto PageText::fromResponse(std::string_view body) -> PageText {
+    constexpr std::string_view key = "\"value\"";
+    size_t pos = body.find(key);
+
+    if (pos != std::string_view::npos) {
+        pos = skipSpace(body, pos + key.size());
+    }
+
+    if (pos == std::string_view::npos || pos >= body.size() ||
+        body[pos] != ':') {
+        throw std::runtime_error("Fail to decode page text: no value");
+    }
+
+    pos = skipSpace(body, pos + 1);
+
+    if (body.substr(pos, 4) == "null") {
+        return {};
+    }
+
+    if (pos >= body.size() || body[pos] != '"') {
+        throw std::runtime_error("Fail to decode page text: not a string");
+    }
+
+    return decode(unescapeString(body, pos + 1));
+}
+
+auto PageText::joined(std::string_view separator) const -> std::string {
+    std::string out;
+    size_t total = 0;
+
+    for (auto length : lengths) {
+        total += length + separator.size();
+    }
+
+    out.reserve(total);
+
+    for (size_t i = 0; i < size(); i++) {
+        if (i > 0) {
+            out += separator;
+        }
+
+        out += text(i);
+    }
+
+    return out;
+}
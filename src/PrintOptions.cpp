@@ -0,0 +1,83 @@
+/**
+ *@file PrintOptions.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief PrintOptions definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "PrintOptions.hpp"
+#include <Poco/JSON/Array.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+void setLength(const Poco::JSON::Object::Ptr &obj, const std::string &name,
+               const std::optional<double> &value) {
+    if (!value) {
+        return;
+    }
+
+    if (*value < 0) {
+        throw std::invalid_argument("Print " + name + " must not be negative");
+    }
+
+    obj->set(name, *value);
+}
+} // namespace
+
+auto PrintOptions::margins(double cm) -> PrintOptions & {
+    marginTop = cm;
+    marginBottom = cm;
+    marginLeft = cm;
+    marginRight = cm;
+    return *this;
+}
+
+auto PrintOptions::toJson() const -> Poco::JSON::Object::Ptr {
+    if (scale < 0.1 || scale > 2) {
+        throw std::invalid_argument("Print scale must be between 0.1 and 2");
+    }
+
+    Poco::JSON::Object::Ptr obj = new Poco::JSON::Object();
+    obj->set("orientation", orientation == PrintOrientation::Landscape
+                                ? "landscape"
+                                : "portrait");
+    obj->set("scale", scale);
+    obj->set("background", background);
+    obj->set("shrinkToFit", shrinkToFit);
+
+    if (pageWidth || pageHeight) {
+        Poco::JSON::Object::Ptr page = new Poco::JSON::Object();
+        setLength(page, "width", pageWidth);
+        setLength(page, "height", pageHeight);
+        obj->set("page", page);
+    }
+
+    if (marginTop || marginBottom || marginLeft || marginRight) {
+        Poco::JSON::Object::Ptr margin = new Poco::JSON::Object();
+        setLength(margin, "top", marginTop);
+        setLength(margin, "bottom", marginBottom);
+        setLength(margin, "left", marginLeft);
+        setLength(margin, "right", marginRight);
+        obj->set("margin", margin);
+    }
+
+    if (!pageRanges.empty()) {
+        Poco::JSON::Array::Ptr ranges = new Poco::JSON::Array();
+
+        for (const auto &range : pageRanges) {
+            ranges->add(range);
+        }
+
+        obj->set("pageRanges", ranges);
+    }
+
+    return obj;
+}
+
+auto PrintOptions::serialize() const -> std::string {
+    std::stringstream ss;
+    toJson()->stringify(ss);
+    return ss.str();
+}
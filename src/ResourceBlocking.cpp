@@ -0,0 +1,191 @@
+/**
+ *@file ResourceBlocking.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief ResourceBlockPolicy and ResourceBlockMonitor definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "ResourceBlocking.hpp"
+#include <array>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+constexpr std::array<std::string_view, 9> imageExtensions = {
+    "png", "jpg", "jpeg", "gif", "webp", "svg", "ico", "bmp", "avif"};
+constexpr std::array<std::string_view, 5> fontExtensions = {
+    "woff", "woff2", "ttf", "otf", "eot"};
+constexpr std::array<std::string_view, 7> mediaExtensions = {
+    "mp4", "webm", "mp3", "ogg", "wav", "m4a", "avi"};
+constexpr std::array<std::string_view, 1> stylesheetExtensions = {"css"};
+
+constexpr std::array<std::string_view, 8> trackerPatterns = {
+    "*google-analytics.com*", "*googletagmanager.com*",
+    "*doubleclick.net*",      "*googlesyndication.com*",
+    "*connect.facebook.net*", "*hotjar.com*",
+    "*scorecardresearch.com*", "*clarity.ms*"};
+
+template <size_t N>
+void addExtensions(std::vector<std::string> &out,
+                   const std::array<std::string_view, N> &extensions) {
+    for (const auto &ext : extensions) {
+        std::string pattern = "*.";
+        pattern += ext;
+        out.push_back(pattern);
+        out.push_back(pattern + "?*");
+    }
+}
+} // namespace
+
+auto ResourceBlockPolicy::blockedUrlPatterns() const
+    -> std::vector<std::string> {
+    std::vector<std::string> result;
+
+    if (blockImages) {
+        addExtensions(result, imageExtensions);
+    }
+
+    if (blockFonts) {
+        addExtensions(result, fontExtensions);
+    }
+
+    if (blockMedia) {
+        addExtensions(result, mediaExtensions);
+    }
+
+    if (blockStylesheets) {
+        addExtensions(result, stylesheetExtensions);
+    }
+
+    if (blockTrackers) {
+        result.insert(result.end(), trackerPatterns.begin(),
+                      trackerPatterns.end());
+    }
+
+    result.insert(result.end(), urlPatterns.begin(), urlPatterns.end());
+    return result;
+}
+
+auto ResourceBlockPolicy::toCdpParams() const -> Poco::JSON::Object::Ptr {
+    Poco::JSON::Array::Ptr urls = new Poco::JSON::Array;
+
+    for (const auto &pattern : blockedUrlPatterns()) {
+        urls->add(pattern);
+    }
+
+    Poco::JSON::Object::Ptr params = new Poco::JSON::Object();
+    params->set("urls", urls);
+    return params;
+}
+
+void ResourceBlockPolicy::applyPrefs(
+    const Poco::JSON::Object::Ptr &prefs) const {
+    /*
+    Content setting value 2 means "block", images blocked here are never
+    requested so they do not show up in the Network events
+    */
+    if (blockImages) {
+        prefs->set("profile.managed_default_content_settings.images", 2);
+    }
+}
+
+ResourceBlockMonitor::ResourceBlockMonitor(DevToolsSession &devtools,
+                                           const ResourceBlockPolicy &policy)
+    : devtools(devtools) {
+    auto targets = devtools.call("Target.getTargets")
+                       .extract<Poco::JSON::Object::Ptr>()
+                       ->getArray("targetInfos");
+
+    std::string targetId;
+    for (unsigned int i = 0; i < targets->size(); i++) {
+        auto info = targets->getObject(i);
+
+        if (info->optValue<std::string>("type", "") == "page") {
+            targetId = info->getValue<std::string>("targetId");
+            break;
+        }
+    }
+
+    if (targetId.empty()) {
+        throw std::runtime_error("No page target to monitor");
+    }
+
+    Poco::JSON::Object::Ptr attachParams = new Poco::JSON::Object();
+    attachParams->set("targetId", targetId);
+    attachParams->set("flatten", true);
+
+    targetSessionId = devtools.call("Target.attachToTarget", attachParams)
+                          .extract<Poco::JSON::Object::Ptr>()
+                          ->getValue<std::string>("sessionId");
+
+    /*
+     Subscribed before Network.enable so no event is missed. The handlers
+     capture this, they must not outlive a constructor that throws
+     */
+    try {
+        subscriptions.push_back(devtools.subscribe(
+            "Network.loadingFailed",
+            [this](const Poco::JSON::Object::Ptr &params,
+                   const std::string &sessionId) {
+                if (sessionId != targetSessionId || params.isNull() ||
+                    !params->has("blockedReason")) {
+                    return;
+                }
+
+                blockedRequests++;
+
+                auto type = params->optValue<std::string>("type", "");
+                if (type == "Image") {
+                    blockedImages++;
+                } else if (type == "Font") {
+                    blockedFonts++;
+                } else if (type == "Media") {
+                    blockedMedia++;
+                } else if (type == "Stylesheet") {
+                    blockedStylesheets++;
+                }
+            }));
+
+        subscriptions.push_back(devtools.subscribe(
+            "Network.loadingFinished",
+            [this](const Poco::JSON::Object::Ptr &params,
+                   const std::string &sessionId) {
+                if (sessionId != targetSessionId || params.isNull()) {
+                    return;
+                }
+
+                finishedRequests++;
+                transferredBytes += static_cast<uint64_t>(
+                    params->optValue<double>("encodedDataLength", 0.0));
+            }));
+
+        devtools.call("Network.enable", {}, targetSessionId);
+        devtools.call("Network.setBlockedURLs", policy.toCdpParams(),
+                      targetSessionId);
+    } catch (...) {
+        for (auto id : subscriptions) {
+            devtools.unsubscribe(id);
+        }
+
+        throw;
+    }
+}
+
+ResourceBlockMonitor::~ResourceBlockMonitor() {
+    for (auto id : subscriptions) {
+        devtools.unsubscribe(id);
+    }
+}
+
+auto ResourceBlockMonitor::stats() const -> ResourceBlockStats {
+    ResourceBlockStats result;
+    result.blockedRequests = blockedRequests.load();
+    result.blockedImages = blockedImages.load();
+    result.blockedFonts = blockedFonts.load();
+    result.blockedMedia = blockedMedia.load();
+    result.blockedStylesheets = blockedStylesheets.load();
+    result.finishedRequests = finishedRequests.load();
+    result.transferredBytes = transferredBytes.load();
+    return result;
+}
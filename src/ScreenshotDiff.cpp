@@ -0,0 +1,492 @@
+/**
+ *@file ScreenshotDiff.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Image and ScreenshotDiff definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "ScreenshotDiff.hpp"
+#include <Poco/Base64Decoder.h>
+#include <Poco/InflatingStream.h>
+#include <Poco/MemoryStream.h>
+#include <Poco/StreamCopier.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCREENSHOT_DIFF_SSE2 1
+#endif
+
+namespace {
+constexpr char pngSignature[8] = {'\x89', 'P',  'N',    'G',
+                                  '\r',   '\n', '\x1a', '\n'};
+
+/*
+ Screenshots of a 8K display are below this
+ */
+constexpr uint64_t maxPixels = 1ULL << 28;
+
+auto readBe32(const char *data) -> uint32_t {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    return (static_cast<uint32_t>(bytes[0]) << 24U) |
+           (static_cast<uint32_t>(bytes[1]) << 16U) |
+           (static_cast<uint32_t>(bytes[2]) << 8U) |
+           static_cast<uint32_t>(bytes[3]);
+}
+
+auto paeth(int a, int b, int c) -> uint8_t {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+        return static_cast<uint8_t>(a);
+    }
+
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+/*
+ Undo the filter of one scanline in place, prev is the already unfiltered
+ previous line or zeros for the first one
+ */
+void unfilter(uint8_t filter, uint8_t *line, const uint8_t *prev,
+              size_t length, size_t bpp) {
+    switch (filter) {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = bpp; i < length; i++) {
+            line[i] = static_cast<uint8_t>(line[i] + line[i - bpp]);
+        }
+        break;
+    case 2:
+        for (size_t i = 0; i < length; i++) {
+            line[i] = static_cast<uint8_t>(line[i] + prev[i]);
+        }
+        break;
+    case 3:
+        for (size_t i = 0; i < length; i++) {
+            unsigned left = i >= bpp ? line[i - bpp] : 0U;
+            line[i] = static_cast<uint8_t>(line[i] + ((left + prev[i]) >> 1U));
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < length; i++) {
+            int left = i >= bpp ? line[i - bpp] : 0;
+            int upLeft = i >= bpp ? prev[i - bpp] : 0;
+            line[i] = static_cast<uint8_t>(line[i] +
+                                           paeth(left, prev[i], upLeft));
+        }
+        break;
+    default:
+        throw std::runtime_error("Invalid PNG filter type");
+    }
+}
+
+auto inflate(const std::string &compressed, size_t expected) -> std::string {
+    Poco::MemoryInputStream in(compressed.data(), compressed.size());
+    Poco::InflatingInputStream inflater(in,
+                                        Poco::InflatingStreamBuf::STREAM_ZLIB);
+
+    std::string raw(expected, '\0');
+    inflater.read(raw.data(), static_cast<std::streamsize>(expected));
+
+    if (static_cast<size_t>(inflater.gcount()) != expected) {
+        throw std::runtime_error("PNG image data is truncated");
+    }
+
+    return raw;
+}
+
+/*
+ Differs when (77 |dR| + 150 |dG| + 29 |dB|) > tolerance * 256, alpha is
+ ignored
+ */
+auto countRowScalar(const uint8_t *a, const uint8_t *b, size_t pixels,
+                    uint32_t limit) -> uint64_t {
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < pixels; i++) {
+        const uint8_t *pa = a + i * 4;
+        const uint8_t *pb = b + i * 4;
+
+        auto distance =
+            77U * static_cast<uint32_t>(std::abs(pa[0] - pb[0])) +
+            150U * static_cast<uint32_t>(std::abs(pa[1] - pb[1])) +
+            29U * static_cast<uint32_t>(std::abs(pa[2] - pb[2]));
+
+        count += distance > limit ? 1U : 0U;
+    }
+
+    return count;
+}
+
+#ifdef SCREENSHOT_DIFF_SSE2
+/*
+ 4 pixels per step: absolute byte differences with saturating subtraction,
+ widened to 16 bits and weighted with madd, then the two partial sums of each
+ pixel are added and compared to the limit
+ */
+auto countRowSse2(const uint8_t *a, const uint8_t *b, size_t pixels,
+                  uint32_t limit) -> uint64_t {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+    const __m128i limits = _mm_set1_epi32(static_cast<int>(limit));
+    uint64_t count = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+        __m128i diff =
+            _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+
+        __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(diff, zero), weights);
+        __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(diff, zero), weights);
+
+        __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(low),
+                                     _mm_castsi128_ps(high),
+                                     _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(low),
+                                    _mm_castsi128_ps(high),
+                                    _MM_SHUFFLE(3, 1, 3, 1));
+        __m128i distance =
+            _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+
+        auto mask = static_cast<unsigned>(_mm_movemask_ps(
+            _mm_castsi128_ps(_mm_cmpgt_epi32(distance, limits))));
+        count += static_cast<uint64_t>(std::popcount(mask));
+
+        a += 16;
+        b += 16;
+    }
+
+    return count + countRowScalar(a, b, pixels - i, limit);
+}
+#endif
+
+auto countRow(const uint8_t *a, const uint8_t *b, size_t pixels,
+              uint32_t limit) -> uint64_t {
+#ifdef SCREENSHOT_DIFF_SSE2
+    return countRowSse2(a, b, pixels, limit);
+#else
+    return countRowScalar(a, b, pixels, limit);
+#endif
+}
+
+auto clip(const DiffRegion &region, uint32_t width, uint32_t height)
+    -> DiffRegion {
+    DiffRegion result;
+    result.x = std::min(region.x, width);
+    result.y = std::min(region.y, height);
+    result.width = std::min(region.width, width - result.x);
+    result.height = std::min(region.height, height - result.y);
+    return result;
+}
+
+auto intersects(const DiffRegion &a, const DiffRegion &b) -> bool {
+    return a.x < b.x + b.width && b.x < a.x + a.width &&
+           a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+/*
+ Compare one tile row by row, skipping the spans covered by masks. masks is
+ sorted by x and holds only the masks intersecting the tile
+ */
+void compareTile(const Image &before, const Image &after,
+                 const std::vector<DiffRegion> &masks, uint32_t limit,
+                 TileDiff &tile) {
+    const auto &region = tile.region;
+    const uint32_t x1 = region.x + region.width;
+
+    for (uint32_t y = region.y; y < region.y + region.height; y++) {
+        const uint8_t *rowA = before.row(y);
+        const uint8_t *rowB = after.row(y);
+        uint32_t cursor = region.x;
+
+        auto span = [&](uint32_t end) {
+            tile.differentPixels += countRow(rowA + cursor * 4ULL,
+                                             rowB + cursor * 4ULL,
+                                             end - cursor, limit);
+            tile.comparedPixels += end - cursor;
+        };
+
+        for (const auto &mask : masks) {
+            if (y < mask.y || y >= mask.y + mask.height) {
+                continue;
+            }
+
+            if (mask.x > cursor) {
+                span(std::min(mask.x, x1));
+            }
+
+            cursor = std::max(cursor, mask.x + mask.width);
+
+            if (cursor >= x1) {
+                break;
+            }
+        }
+
+        if (cursor < x1) {
+            span(x1);
+        }
+    }
+}
+} // namespace
+
+auto Image::fromPng(std::string_view png) -> Image {
+    if (png.size() < sizeof(pngSignature) ||
+        std::memcmp(png.data(), pngSignature, sizeof(pngSignature)) != 0) {
+        throw std::runtime_error("Not a PNG image");
+    }
+
+    Image image;
+    uint8_t bitDepth = 0;
+    uint8_t colorType = 0;
+    uint8_t interlace = 0;
+    bool hasHeader = false;
+    std::string idat;
+    std::vector<uint8_t> palette;
+    std::vector<uint8_t> paletteAlpha;
+
+    size_t pos = sizeof(pngSignature);
+
+    while (png.size() - pos >= 12) {
+        uint32_t length = readBe32(png.data() + pos);
+        std::string_view type = png.substr(pos + 4, 4);
+
+        if (png.size() - pos - 12 < length) {
+            throw std::runtime_error("PNG chunk is truncated");
+        }
+
+        std::string_view data = png.substr(pos + 8, length);
+        pos += 12 + static_cast<size_t>(length);
+
+        if (type == "IHDR" && length >= 13) {
+            image.width = readBe32(data.data());
+            image.height = readBe32(data.data() + 4);
+            bitDepth = static_cast<uint8_t>(data[8]);
+            colorType = static_cast<uint8_t>(data[9]);
+            interlace = static_cast<uint8_t>(data[12]);
+            hasHeader = true;
+        } else if (type == "PLTE") {
+            palette.assign(data.begin(), data.end());
+        } else if (type == "tRNS") {
+            paletteAlpha.assign(data.begin(), data.end());
+        } else if (type == "IDAT") {
+            idat.append(data);
+        } else if (type == "IEND") {
+            break;
+        }
+    }
+
+    if (!hasHeader || image.width == 0 || image.height == 0) {
+        throw std::runtime_error("PNG image has no header");
+    }
+
+    if (bitDepth != 8 || interlace != 0) {
+        throw std::runtime_error(
+            "Unsupported PNG, only 8 bit non interlaced images are decoded");
+    }
+
+    if (static_cast<uint64_t>(image.width) * image.height > maxPixels) {
+        throw std::runtime_error("PNG image is too large");
+    }
+
+    size_t channels = 0;
+    switch (colorType) {
+    case 0:
+    case 3:
+        channels = 1;
+        break;
+    case 2:
+        channels = 3;
+        break;
+    case 4:
+        channels = 2;
+        break;
+    case 6:
+        channels = 4;
+        break;
+    default:
+        throw std::runtime_error("Unsupported PNG color type");
+    }
+
+    if (colorType == 3 && palette.empty()) {
+        throw std::runtime_error("PNG palette is missing");
+    }
+
+    const size_t stride = image.width * channels;
+    auto raw = inflate(idat, (stride + 1) * image.height);
+
+    image.rgba.resize(static_cast<size_t>(image.width) * image.height * 4);
+    std::vector<uint8_t> zeros(stride, 0);
+    const uint8_t *prev = zeros.data();
+
+    for (uint32_t y = 0; y < image.height; y++) {
+        auto *line = reinterpret_cast<uint8_t *>(raw.data()) + y * (stride + 1);
+        unfilter(line[0], line + 1, prev, stride, channels);
+        prev = line + 1;
+
+        const uint8_t *src = line + 1;
+        uint8_t *dst = image.rgba.data() + static_cast<size_t>(y) *
+                                               image.width * 4;
+
+        for (uint32_t x = 0; x < image.width; x++, dst += 4) {
+            switch (colorType) {
+            case 0:
+                dst[0] = dst[1] = dst[2] = src[x];
+                dst[3] = 255;
+                break;
+            case 2:
+                std::memcpy(dst, src + x * 3ULL, 3);
+                dst[3] = 255;
+                break;
+            case 3: {
+                size_t idx = src[x];
+                if (idx * 3 + 2 >= palette.size()) {
+                    throw std::runtime_error("PNG palette index out of range");
+                }
+                std::memcpy(dst, palette.data() + idx * 3, 3);
+                dst[3] = idx < paletteAlpha.size() ? paletteAlpha[idx] : 255;
+                break;
+            }
+            case 4:
+                dst[0] = dst[1] = dst[2] = src[x * 2ULL];
+                dst[3] = src[x * 2ULL + 1];
+                break;
+            default:
+                std::memcpy(dst, src + x * 4ULL, 4);
+                break;
+            }
+        }
+    }
+
+    return image;
+}
+
+auto Image::fromBase64Png(const std::string &base64) -> Image {
+    std::istringstream in(base64);
+    Poco::Base64Decoder decoder(in);
+
+    std::string png;
+    png.reserve(base64.size() / 4 * 3);
+    Poco::StreamCopier::copyToString(decoder, png);
+
+    return fromPng(png);
+}
+
+auto ScreenshotDiff::compare(const Image &before, const Image &after,
+                             const DiffOptions &options) -> DiffResult {
+    if (before.width != after.width || before.height != after.height) {
+        throw std::invalid_argument("Fail to diff images of different sizes");
+    }
+
+    const size_t expected =
+        static_cast<size_t>(before.width) * before.height * 4;
+    if (before.rgba.size() != expected || after.rgba.size() != expected) {
+        throw std::invalid_argument("Image pixel buffer has the wrong size");
+    }
+
+    const uint32_t width = before.width;
+    const uint32_t height = before.height;
+    const uint32_t tileSize = std::max(options.tileSize, 1U);
+    const uint32_t limit = options.pixelTolerance * 256U;
+
+    std::vector<DiffRegion> masks;
+    for (const auto &mask : options.masks) {
+        auto clipped = clip(mask, width, height);
+        if (clipped.width != 0 && clipped.height != 0) {
+            masks.push_back(clipped);
+        }
+    }
+
+    std::sort(masks.begin(), masks.end(),
+              [](const DiffRegion &a, const DiffRegion &b) {
+                  return a.x < b.x;
+              });
+
+    const uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (height + tileSize - 1) / tileSize;
+    const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+
+    std::vector<TileDiff> tiles(tileCount);
+    std::atomic<size_t> nextTile{0};
+    std::atomic<uint64_t> different{0};
+    std::atomic<bool> exceeded{false};
+
+    auto worker = [&]() {
+        std::vector<DiffRegion> tileMasks;
+
+        while (!exceeded.load(std::memory_order_relaxed)) {
+            size_t idx = nextTile.fetch_add(1);
+            if (idx >= tileCount) {
+                break;
+            }
+
+            auto &tile = tiles[idx];
+            tile.region.x = static_cast<uint32_t>(idx % tilesX) * tileSize;
+            tile.region.y = static_cast<uint32_t>(idx / tilesX) * tileSize;
+            tile.region.width = std::min(tileSize, width - tile.region.x);
+            tile.region.height = std::min(tileSize, height - tile.region.y);
+
+            tileMasks.clear();
+            for (const auto &mask : masks) {
+                if (intersects(mask, tile.region)) {
+                    tileMasks.push_back(mask);
+                }
+            }
+
+            compareTile(before, after, tileMasks, limit, tile);
+
+            auto total = different.fetch_add(tile.differentPixels) +
+                         tile.differentPixels;
+
+            if (options.maxDifferentPixels != 0 &&
+                total > options.maxDifferentPixels) {
+                exceeded = true;
+            }
+        }
+    };
+
+    unsigned threads = options.threads != 0
+                           ? options.threads
+                           : std::max(std::thread::hardware_concurrency(), 1U);
+    threads = static_cast<unsigned>(
+        std::min<size_t>(threads, std::max<size_t>(tileCount, 1)));
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    DiffResult result;
+    result.thresholdExceeded = exceeded.load();
+
+    for (auto &tile : tiles) {
+        result.differentPixels += tile.differentPixels;
+        result.comparedPixels += tile.comparedPixels;
+
+        if (tile.differentPixels != 0) {
+            result.tiles.push_back(tile);
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,451 @@
+/**
+ *@file SessionPool.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief SessionPool definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "SessionPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <optional>
+
+namespace {
+auto isDownloaded(WebDriver &session, const std::string &fileId) -> bool {
+    auto files = session.getDownloadableFiles()
+                     .extract<Poco::JSON::Object::Ptr>();
+    auto names = files->getArray("names");
+
+    for (unsigned int i = 0; names && i < names->size(); i++) {
+        if (names->getElement<std::string>(i) == fileId) {
+            return true;
+        }
+    }
+
+    return false;
+}
+} // namespace
+
+SessionPool::Lease::Lease(SessionPool *pool,
+                          std::unique_ptr<WebDriver> session)
+    : pool(pool), session(std::move(session)) {}
+
+SessionPool::Lease::Lease(Lease &&other) noexcept
+    : pool(other.pool), session(std::move(other.session)),
+      broken(other.broken) {
+    other.pool = nullptr;
+}
+
+auto SessionPool::Lease::operator=(Lease &&other) noexcept -> Lease & {
+    if (this != &other) {
+        release();
+        pool = other.pool;
+        session = std::move(other.session);
+        broken = other.broken;
+        other.pool = nullptr;
+    }
+
+    return *this;
+}
+
+SessionPool::Lease::~Lease() { release(); }
+
+void SessionPool::Lease::release() {
+    if (pool != nullptr && session) {
+        pool->release(std::move(session), broken);
+    }
+
+    pool = nullptr;
+}
+
+SessionPool::SessionPool(SessionPoolOptions options)
+    : options(std::move(options)) {
+    if (this->options.size == 0) {
+        throw std::invalid_argument("SessionPool size must be at least 1");
+    }
+
+    if (this->options.healthCheckInterval.count() > 0) {
+        monitoring = true;
+        monitor = std::thread(&SessionPool::monitorLoop, this);
+    }
+}
+
+SessionPool::~SessionPool() {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        monitoring = false;
+    }
+
+    wakeMonitor.notify_all();
+
+    if (monitor.joinable()) {
+        monitor.join();
+    }
+
+    std::vector<std::unique_ptr<WebDriver>> sessions;
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        sessions.swap(idle);
+    }
+
+    /*
+     Each WebDriver deletes its session on destruction
+     */
+    sessions.clear();
+}
+
+auto SessionPool::acquire() -> Lease {
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        available.wait(lck, [this]() {
+            return !idle.empty() || open < options.size;
+        });
+
+        counters.leases++;
+
+        if (!idle.empty()) {
+            auto session = std::move(idle.back());
+            idle.pop_back();
+            return Lease(this, std::move(session));
+        }
+
+        open++;
+    }
+
+    /*
+     The browser starts outside the lock, other sessions can be leased and
+     returned meanwhile
+     */
+    try {
+        return Lease(this, startSession());
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            open--;
+        }
+
+        available.notify_one();
+        throw;
+    }
+}
+
+auto SessionPool::warmUp(size_t count) -> size_t {
+    size_t starting = 0;
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        starting = std::min(count, options.size - open);
+        open += starting;
+    }
+
+    std::vector<std::future<std::unique_ptr<WebDriver>>> pending;
+    pending.reserve(starting);
+
+    for (size_t i = 0; i < starting; i++) {
+        pending.push_back(std::async(std::launch::async,
+                                     [this]() { return startSession(); }));
+    }
+
+    size_t started = 0;
+
+    for (auto &session : pending) {
+        try {
+            auto ready = session.get();
+            std::lock_guard<std::mutex> lck(mtx);
+            idle.push_back(std::move(ready));
+            started++;
+        } catch (const std::exception &e) {
+            std::cerr << "Fail to start session: " << e.what() << std::endl;
+            std::lock_guard<std::mutex> lck(mtx);
+            open--;
+        }
+
+        available.notify_one();
+    }
+
+    return started;
+}
+
+auto SessionPool::startSession() -> std::unique_ptr<WebDriver> {
+    auto session = std::make_unique<WebDriver>();
+    session->webDriverUrl = options.webDriverUrl;
+    session->transport = options.transport;
+    session->measureStartup = options.measureStartup;
+    session->recovery = options.recovery;
+    session->recovery.onRecovery =
+        [this, report = options.recovery.onRecovery](
+            const RecoveryEvent &event) {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+
+                if (event.succeeded()) {
+                    counters.recovered++;
+                } else {
+                    counters.recoveryFailures++;
+                }
+            }
+
+            if (report) {
+                report(event);
+            }
+        };
+    session->connect(options.capabilities);
+
+    std::lock_guard<std::mutex> lck(mtx);
+    counters.created++;
+    counters.startupTime += session->startupTimings().total;
+    return session;
+}
+
+void SessionPool::release(std::unique_ptr<WebDriver> session, bool broken) {
+    if (!broken && options.resetOnRelease) {
+        try {
+            resetSession(*session, options.resetUrl);
+        } catch (const std::exception &e) {
+            std::cerr << "Fail to reset session " << session->sessionId()
+                      << ": " << e.what() << std::endl;
+            broken = true;
+        }
+    }
+
+    if (broken) {
+        session.reset();
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (broken) {
+            open--;
+            counters.discarded++;
+        } else {
+            idle.push_back(std::move(session));
+        }
+    }
+
+    available.notify_one();
+}
+
+auto SessionPool::stats() const -> SessionPoolStats {
+    std::lock_guard<std::mutex> lck(mtx);
+    return counters;
+}
+
+auto SessionPool::checkIdleSessions() -> size_t {
+    size_t pending = 0;
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        pending = idle.size();
+    }
+
+    size_t lost = 0;
+
+    /*
+     One session at a time, taken from the least recently used end and
+     returned to the other, so acquire() keeps finding the rest idle
+     */
+    for (; pending > 0; pending--) {
+        std::unique_ptr<WebDriver> session;
+
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            if (idle.empty()) {
+                break;
+            }
+
+            session = std::move(idle.front());
+            idle.erase(idle.begin());
+        }
+
+        auto health = session->checkHealth();
+        bool recovered = false;
+
+        if (health == SessionHealth::SessionLost) {
+            lost++;
+
+            if (options.recovery.enabled) {
+                try {
+                    recovered = session->recoverSession(
+                        "Health check found the session lost");
+                } catch (const std::exception &e) {
+                    std::cerr << "Fail to recover session: " << e.what()
+                              << std::endl;
+                }
+            }
+
+            if (!recovered) {
+                session.reset();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            if (session) {
+                idle.push_back(std::move(session));
+            } else {
+                open--;
+                counters.discarded++;
+            }
+
+            if (health == SessionHealth::SessionLost) {
+                counters.lost++;
+            }
+        }
+
+        available.notify_one();
+
+        /*
+         Every session talks to the same driver, once it is down the rest
+         are kept as they are until the next check
+         */
+        if (health == SessionHealth::DriverDown) {
+            break;
+        }
+    }
+
+    return lost;
+}
+
+void SessionPool::monitorLoop() {
+    std::unique_lock<std::mutex> lck(mtx);
+
+    while (monitoring) {
+        wakeMonitor.wait_for(lck, options.healthCheckInterval,
+                             [this]() { return !monitoring; });
+
+        if (!monitoring) {
+            break;
+        }
+
+        lck.unlock();
+        checkIdleSessions();
+        lck.lock();
+    }
+}
+
+auto SessionPool::printPages(const std::vector<PrintJob> &jobs)
+    -> std::vector<std::string> {
+    return runLeased(jobs.size(), [&jobs](WebDriver &session, size_t i) {
+        session.get(jobs[i].url);
+        session.printPageTo(jobs[i].options, jobs[i].output);
+    });
+}
+
+auto SessionPool::downloadFiles(const std::vector<DownloadJob> &jobs)
+    -> std::vector<std::string> {
+    return runLeased(jobs.size(), [&jobs](WebDriver &session, size_t i) {
+        const auto &job = jobs[i];
+        session.get(job.url);
+
+        auto deadline = std::chrono::steady_clock::now() + job.timeout;
+
+        while (!isDownloaded(session, job.fileId)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                throw std::runtime_error("Timeout waiting for download " +
+                                         job.fileId);
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        session.downloadFileTo(job.fileId, job.output);
+    });
+}
+
+auto SessionPool::runLeased(
+    size_t count, const std::function<void(WebDriver &, size_t)> &job)
+    -> std::vector<std::string> {
+    std::vector<std::string> errors(count);
+    std::atomic<size_t> next{0};
+
+    auto worker = [&]() {
+        std::optional<Lease> lease;
+
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                if (!lease) {
+                    lease.emplace(acquire());
+                }
+
+                job(**lease, i);
+            } catch (const std::exception &e) {
+                errors[i] = e.what();
+
+                /*
+                 The session may be broken, the next job gets another one
+                 */
+                if (lease) {
+                    lease->discard();
+                    lease.reset();
+                }
+            }
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    size_t threads = std::min(options.size, count);
+
+    for (size_t i = 0; i < threads; i++) {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+
+    for (auto &running : workers) {
+        running.get();
+    }
+
+    return errors;
+}
+
+void SessionPool::resetSession(WebDriver &session, const std::string &url) {
+    /*
+     A timeout changed by the last user, or a wait of an ImplicitWaitScope
+     still open, must not reach the next one
+     */
+    session.resetTimeouts();
+    session.tryCallUrlDriver(
+        "POST", session.webDriverUrl + session.sessionPath() + "/alert/dismiss",
+        "{}");
+
+    auto handles = session.w3cGetWindowHandles()
+                       .extract<Poco::JSON::Array::Ptr>();
+
+    for (unsigned int i = 1; i < handles->size(); i++) {
+        session.switchToWindow(handles->getElement<std::string>(i));
+        session.close();
+    }
+
+    if (handles->size() > 0) {
+        session.switchToWindow(handles->getElement<std::string>(0));
+    }
+
+    /*
+     Storage belongs to the loaded origin, cleared before leaving it
+     */
+    session.executeSyncScript("try { window.localStorage.clear(); "
+                              "window.sessionStorage.clear(); } catch (e) {}");
+
+    bool cleared = false;
+
+    if (session.cdpAvailable) {
+        try {
+            session.executeCdpCommand("Network.clearBrowserCookies");
+            cleared = true;
+        } catch (const std::exception &e) {
+            std::cerr << "CDP unavailable, falling back to deleteAllCookies: "
+                      << e.what() << std::endl;
+            session.cdpAvailable = !WebDriver::cdpUnsupported(e);
+        }
+    }
+
+    if (!cleared) {
+        session.deleteAllCookies();
+    }
+
+    session.get(url);
+}
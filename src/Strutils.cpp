@@ -0,0 +1,396 @@
+/**
+ *@file Strutils.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Vectorized Strutils definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "Strutils.hpp"
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STRUTILS_SSE2 1
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define STRUTILS_AVX2 1
+#endif
+#endif
+
+namespace {
+constexpr auto makeHexTable() -> std::array<int8_t, 256> {
+    std::array<int8_t, 256> table{};
+    table.fill(-1);
+
+    for (int i = 0; i < 10; i++) {
+        table[static_cast<size_t>('0' + i)] = static_cast<int8_t>(i);
+    }
+
+    for (int i = 0; i < 6; i++) {
+        table[static_cast<size_t>('a' + i)] = static_cast<int8_t>(10 + i);
+        table[static_cast<size_t>('A' + i)] = static_cast<int8_t>(10 + i);
+    }
+
+    return table;
+}
+
+constexpr auto hexTable = makeHexTable();
+
+inline auto hexValue(char c) -> int {
+    return hexTable[static_cast<unsigned char>(c)];
+}
+
+inline auto isDigit(char c) -> bool { return c >= '0' && c <= '9'; }
+
+void caseScalar(char *data, size_t size, char from, char to) {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] >= from && data[i] <= to) {
+            data[i] = static_cast<char>(data[i] ^ 0x20);
+        }
+    }
+}
+
+#ifdef STRUTILS_AVX2
+auto hasAvx2() -> bool {
+    static const bool supported = __builtin_cpu_supports("avx2") != 0;
+    return supported;
+}
+
+__attribute__((target("avx2"))) auto
+findAvx2(std::string_view str, std::string_view term, size_t pos) -> size_t {
+    const size_t n = term.size();
+    const __m256i first = _mm256_set1_epi8(term.front());
+    const __m256i last = _mm256_set1_epi8(term.back());
+
+    while (pos + n - 1 + 32 <= str.size()) {
+        const char *base = str.data() + pos;
+        __m256i blockFirst =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base));
+        __m256i blockLast =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + n - 1));
+
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                             _mm256_cmpeq_epi8(last, blockLast))));
+
+        while (mask != 0) {
+            auto bit = static_cast<size_t>(std::countr_zero(mask));
+
+            if (n <= 2 ||
+                std::memcmp(base + bit + 1, term.data() + 1, n - 2) == 0) {
+                return pos + bit;
+            }
+
+            mask &= mask - 1;
+        }
+
+        pos += 32;
+    }
+
+    return str.find(term, pos);
+}
+
+__attribute__((target("avx2"))) auto
+caseAvx2(char *data, size_t size, char from, char to) -> size_t {
+    const __m256i lower = _mm256_set1_epi8(static_cast<char>(from - 1));
+    const __m256i upper = _mm256_set1_epi8(static_cast<char>(to + 1));
+    const __m256i flip = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        auto *ptr = reinterpret_cast<__m256i *>(data + i);
+        __m256i block = _mm256_loadu_si256(ptr);
+        __m256i inRange = _mm256_and_si256(_mm256_cmpgt_epi8(block, lower),
+                                           _mm256_cmpgt_epi8(upper, block));
+        block = _mm256_xor_si256(block, _mm256_and_si256(inRange, flip));
+        _mm256_storeu_si256(ptr, block);
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2"))) auto digitsAvx2(std::string_view str,
+                                                 std::string &out) -> size_t {
+    const __m256i belowZero = _mm256_set1_epi8('0' - 1);
+    const __m256i aboveNine = _mm256_set1_epi8('9' + 1);
+    size_t i = 0;
+
+    for (; i + 32 <= str.size(); i += 32) {
+        __m256i block = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(str.data() + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpgt_epi8(block, belowZero),
+                             _mm256_cmpgt_epi8(aboveNine, block))));
+
+        if (mask == UINT32_MAX) {
+            out.append(str.data() + i, 32);
+            continue;
+        }
+
+        while (mask != 0) {
+            out.push_back(str[i + static_cast<size_t>(std::countr_zero(mask))]);
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+#endif
+
+#ifdef STRUTILS_SSE2
+auto findSse2(std::string_view str, std::string_view term, size_t pos)
+    -> size_t {
+    const size_t n = term.size();
+    const __m128i first = _mm_set1_epi8(term.front());
+    const __m128i last = _mm_set1_epi8(term.back());
+
+    while (pos + n - 1 + 16 <= str.size()) {
+        const char *base = str.data() + pos;
+        __m128i blockFirst =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(base));
+        __m128i blockLast =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(base + n - 1));
+
+        auto mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                            _mm_cmpeq_epi8(last, blockLast))));
+
+        while (mask != 0) {
+            auto bit = static_cast<size_t>(std::countr_zero(mask));
+
+            if (n <= 2 ||
+                std::memcmp(base + bit + 1, term.data() + 1, n - 2) == 0) {
+                return pos + bit;
+            }
+
+            mask &= mask - 1;
+        }
+
+        pos += 16;
+    }
+
+    return str.find(term, pos);
+}
+
+auto caseSse2(char *data, size_t size, char from, char to) -> size_t {
+    const __m128i lower = _mm_set1_epi8(static_cast<char>(from - 1));
+    const __m128i upper = _mm_set1_epi8(static_cast<char>(to + 1));
+    const __m128i flip = _mm_set1_epi8(0x20);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        auto *ptr = reinterpret_cast<__m128i *>(data + i);
+        __m128i block = _mm_loadu_si128(ptr);
+        __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(block, lower),
+                                        _mm_cmpgt_epi8(upper, block));
+        block = _mm_xor_si128(block, _mm_and_si128(inRange, flip));
+        _mm_storeu_si128(ptr, block);
+    }
+
+    return i;
+}
+
+auto digitsSse2(std::string_view str, std::string &out) -> size_t {
+    const __m128i belowZero = _mm_set1_epi8('0' - 1);
+    const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+    size_t i = 0;
+
+    for (; i + 16 <= str.size(); i += 16) {
+        __m128i block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(str.data() + i));
+        auto mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(block, belowZero),
+                                            _mm_cmpgt_epi8(aboveNine, block))));
+
+        if (mask == 0xFFFF) {
+            out.append(str.data() + i, 16);
+            continue;
+        }
+
+        while (mask != 0) {
+            out.push_back(str[i + static_cast<size_t>(std::countr_zero(mask))]);
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+
+/*
+ 16 hex digits to 8 bytes, the nibble of each byte is computed in parallel and
+ the pairs are merged in 16 bit lanes
+ */
+auto hexSse2(std::string_view str, char *out) -> std::optional<size_t> {
+    const __m128i belowZero = _mm_set1_epi8('0' - 1);
+    const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+    const __m128i belowA = _mm_set1_epi8('a' - 1);
+    const __m128i aboveF = _mm_set1_epi8('f' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letterBase = _mm_set1_epi8('a' - 10);
+    const __m128i lowByte = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for (; i + 16 <= str.size(); i += 16) {
+        __m128i block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(str.data() + i));
+        __m128i lowered = _mm_or_si128(block, caseBit);
+
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, belowZero),
+                                      _mm_cmpgt_epi8(aboveNine, block));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lowered, belowA),
+                                       _mm_cmpgt_epi8(aboveF, lowered));
+
+        if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xFFFF) {
+            return std::nullopt;
+        }
+
+        __m128i nibbles = _mm_or_si128(
+            _mm_and_si128(digit, _mm_sub_epi8(block, zero)),
+            _mm_and_si128(letter, _mm_sub_epi8(lowered, letterBase)));
+
+        __m128i high = _mm_slli_epi16(_mm_and_si128(nibbles, lowByte), 4);
+        __m128i low = _mm_srli_epi16(nibbles, 8);
+        __m128i bytes = _mm_or_si128(high, low);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i / 2),
+                         _mm_packus_epi16(bytes, bytes));
+    }
+
+    return i;
+}
+#endif
+
+void convertCase(char *data, size_t size, char from, char to) {
+    size_t done = 0;
+
+#ifdef STRUTILS_AVX2
+    if (hasAvx2()) {
+        done = caseAvx2(data, size, from, to);
+    }
+#endif
+
+#ifdef STRUTILS_SSE2
+    done += caseSse2(data + done, size - done, from, to);
+#endif
+
+    caseScalar(data + done, size - done, from, to);
+}
+} // namespace
+
+auto Strutils::find(std::string_view str, std::string_view term, size_t pos)
+    -> size_t {
+    if (term.empty() || pos >= str.size() ||
+        term.size() > str.size() - pos) {
+        return str.find(term, pos);
+    }
+
+#ifdef STRUTILS_AVX2
+    if (hasAvx2()) {
+        return findAvx2(str, term, pos);
+    }
+#endif
+
+#ifdef STRUTILS_SSE2
+    return findSse2(str, term, pos);
+#else
+    return str.find(term, pos);
+#endif
+}
+
+void Strutils::ascii_to_upper(char *data, size_t size) {
+    convertCase(data, size, 'a', 'z');
+}
+
+void Strutils::ascii_to_lower(char *data, size_t size) {
+    convertCase(data, size, 'A', 'Z');
+}
+
+auto Strutils::digits_only(std::string_view str) -> std::string {
+    std::string result;
+    result.reserve(str.size());
+    size_t i = 0;
+
+#ifdef STRUTILS_AVX2
+    if (hasAvx2()) {
+        i = digitsAvx2(str, result);
+    }
+#endif
+
+#ifdef STRUTILS_SSE2
+    i += digitsSse2(str.substr(i), result);
+#endif
+
+    for (; i < str.size(); i++) {
+        if (isDigit(str[i])) {
+            result.push_back(str[i]);
+        }
+    }
+
+    return result;
+}
+
+auto Strutils::hex_decode(std::string_view str) -> std::optional<std::string> {
+    if (str.size() % 2 != 0) {
+        return std::nullopt;
+    }
+
+    std::string result(str.size() / 2, '\0');
+    size_t i = 0;
+
+#ifdef STRUTILS_SSE2
+    auto vectorized = hexSse2(str, result.data());
+    if (!vectorized) {
+        return std::nullopt;
+    }
+    i = *vectorized;
+#endif
+
+    for (; i < str.size(); i += 2) {
+        int high = hexValue(str[i]);
+        int low = hexValue(str[i + 1]);
+
+        if (high < 0 || low < 0) {
+            return std::nullopt;
+        }
+
+        result[i / 2] = static_cast<char>((high << 4) | low);
+    }
+
+    return result;
+}
+
+auto Strutils::url_decode(std::string_view str) -> std::string {
+    std::string result;
+    result.reserve(str.size());
+    size_t pos = 0;
+
+    while (pos < str.size()) {
+        auto escape = find(str, "%", pos);
+
+        if (escape == std::string_view::npos) {
+            result.append(str.substr(pos));
+            break;
+        }
+
+        result.append(str.substr(pos, escape - pos));
+
+        if (escape + 2 < str.size()) {
+            int high = hexValue(str[escape + 1]);
+            int low = hexValue(str[escape + 2]);
+
+            if (high >= 0 && low >= 0) {
+                result.push_back(static_cast<char>((high << 4) | low));
+                pos = escape + 3;
+                continue;
+            }
+        }
+
+        result.push_back('%');
+        pos = escape + 1;
+    }
+
+    return result;
+}
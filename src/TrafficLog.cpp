@@ -0,0 +1,173 @@
+/**
+ *@file TrafficLog.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief TrafficRecorder and TrafficReplayer definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "TrafficLog.hpp"
+#include "LittleEndian.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+constexpr char logMagic[4] = {'W', 'D', 'T', 'L'};
+constexpr uint16_t logVersion = 2;
+
+using little_endian::appendRaw;
+using little_endian::appendString;
+
+auto keyOf(const std::string &verb, const std::string &path) -> std::string {
+    return verb + " " + path;
+}
+} // namespace
+
+TrafficRecorder::TrafficRecorder(const std::filesystem::path &path)
+    : file(path, std::ios::binary | std::ios::trunc),
+      epoch(std::chrono::steady_clock::now()) {
+    if (!file.is_open()) {
+        throw std::runtime_error("Fail to open traffic log " + path.string());
+    }
+
+    std::string header(logMagic, sizeof(logMagic));
+    appendRaw(header, logVersion);
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+}
+
+auto TrafficRecorder::pathOf(const std::string &url) -> std::string {
+    auto scheme = url.find("://");
+
+    if (scheme == std::string::npos) {
+        return url;
+    }
+
+    auto path = url.find('/', scheme + 3);
+    return path == std::string::npos ? "/" : url.substr(path);
+}
+
+void TrafficRecorder::record(TrafficEntry entry,
+                             std::chrono::steady_clock::time_point started) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    auto now = std::chrono::steady_clock::now();
+    entry.startUs = duration_cast<microseconds>(started - epoch).count();
+    entry.durationUs = duration_cast<microseconds>(now - started).count();
+
+    std::string out;
+    out.reserve(entry.path.size() + entry.body.size() +
+                entry.response.size() + 64);
+    appendString(out, entry.verb);
+    appendString(out, entry.path);
+    appendString(out, entry.body);
+    appendString(out, entry.response);
+    appendRaw(out, entry.responseCode);
+    appendRaw(out, entry.transportError);
+    appendRaw(out, entry.startUs);
+    appendRaw(out, entry.durationUs);
+
+    std::lock_guard<std::mutex> lck(mtx);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    entries++;
+}
+
+void TrafficRecorder::flush() {
+    std::lock_guard<std::mutex> lck(mtx);
+    file.flush();
+}
+
+auto TrafficRecorder::count() const -> size_t {
+    std::lock_guard<std::mutex> lck(mtx);
+    return entries;
+}
+
+TrafficReplayer::TrafficReplayer(const std::filesystem::path &path)
+    : log(load(path)) {
+    index();
+}
+
+TrafficReplayer::TrafficReplayer(std::vector<TrafficEntry> entries)
+    : log(std::move(entries)) {
+    index();
+}
+
+void TrafficReplayer::index() {
+    for (size_t i = 0; i < log.size(); i++) {
+        pending[keyOf(log[i].verb, log[i].path)].push_back(i);
+    }
+}
+
+auto TrafficReplayer::load(const std::filesystem::path &path)
+    -> std::vector<TrafficEntry> {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("Fail to open traffic log " + path.string());
+    }
+
+    std::string data(static_cast<size_t>(std::filesystem::file_size(path)),
+                     '\0');
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+    if (data.size() < sizeof(logMagic) ||
+        std::memcmp(data.data(), logMagic, sizeof(logMagic)) != 0) {
+        throw std::runtime_error("Not a traffic log " + path.string());
+    }
+
+    little_endian::Reader reader(
+        std::string_view(data).substr(sizeof(logMagic)),
+        "Traffic log is truncated");
+
+    if (reader.read<uint16_t>() != logVersion) {
+        throw std::runtime_error("Unsupported traffic log version");
+    }
+
+    std::vector<TrafficEntry> result;
+
+    while (!reader.atEnd()) {
+        TrafficEntry entry;
+        entry.verb = reader.readString();
+        entry.path = reader.readString();
+        entry.body = reader.readString();
+        entry.response = reader.readString();
+        entry.responseCode = reader.read<int64_t>();
+        entry.transportError = reader.read<int32_t>();
+        entry.startUs = reader.read<int64_t>();
+        entry.durationUs = reader.read<int64_t>();
+        result.push_back(std::move(entry));
+    }
+
+    return result;
+}
+
+auto TrafficReplayer::next(const std::string &verb, const std::string &url)
+    -> std::optional<TrafficEntry> {
+    std::optional<TrafficEntry> entry;
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        auto it = pending.find(keyOf(verb, TrafficRecorder::pathOf(url)));
+
+        if (it == pending.end() || it->second.empty()) {
+            return std::nullopt;
+        }
+
+        entry = log[it->second.front()];
+        it->second.pop_front();
+        served++;
+    }
+
+    if (simulateLatency) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(entry->durationUs));
+    }
+
+    return entry;
+}
+
+auto TrafficReplayer::remaining() const -> size_t {
+    std::lock_guard<std::mutex> lck(mtx);
+    return log.size() - served;
+}
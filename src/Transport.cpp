@@ -0,0 +1,960 @@
+/**
+ *@file Transport.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Transport definitions
+ * @version 0.1
+ *
+ *
+ */
+#include "Transport.hpp"
+#include "CurlRAII.hpp"
+#include "Strutils.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+class AddrInfoRAII {
+  public:
+    void operator()(addrinfo *info) { freeaddrinfo(info); }
+};
+
+auto failWith(HttpResponse &res, CURLcode error, const std::string &message)
+    -> bool {
+    res.error = error;
+    res.message = message;
+    return false;
+}
+
+auto parseSize(std::string_view str, int base, size_t &out) -> bool {
+    auto result = std::from_chars(str.data(), str.data() + str.size(), out,
+                                  base);
+    return result.ec == std::errc() && result.ptr != str.data();
+}
+
+auto readBody(char *buffer, size_t size, size_t nitems, void *userp)
+    -> size_t {
+    try {
+        return static_cast<RequestBody *>(userp)->read(buffer, size * nitems);
+    } catch (const std::exception &e) {
+        std::cerr << "Fail to read request body: " << e.what() << std::endl;
+        return CURL_READFUNC_ABORT;
+    }
+}
+
+/*
+ curl rewinds the body when it has to send the request again
+ */
+auto seekBody(void *userp, curl_off_t offset, int origin) -> int {
+    if (offset != 0 || origin != SEEK_SET) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+
+    try {
+        static_cast<RequestBody *>(userp)->rewind();
+        return CURL_SEEKFUNC_OK;
+    } catch (const std::exception &) {
+        return CURL_SEEKFUNC_FAIL;
+    }
+}
+
+/*
+ Errors thrown by the sink are kept here, curl only learns that the write
+ failed
+ */
+struct SinkWriter {
+    ResponseSink *sink;
+    std::string error;
+};
+
+/*
+ Passes the response on to the sink and keeps a copy for the traffic log
+ */
+struct TeeSink : public ResponseSink {
+    explicit TeeSink(ResponseSink &sink) : sink(sink) {}
+
+    void write(const char *data, size_t len) override {
+        sink.write(data, len);
+        copy.append(data, len);
+    }
+
+    ResponseSink &sink;
+    std::string copy;
+};
+
+auto writeSink(char *data, size_t size, size_t nmemb, void *userp) -> size_t {
+    auto *writer = static_cast<SinkWriter *>(userp);
+
+    try {
+        writer->sink->write(data, size * nmemb);
+        return size * nmemb;
+    } catch (const std::exception &e) {
+        writer->error = e.what();
+        return 0;
+    }
+}
+
+auto trim(std::string_view str) -> std::string_view {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+
+    return str;
+}
+} // namespace
+
+auto Transport::sendAsync(std::string verb, std::string url, std::string body)
+    -> std::future<HttpResponse> {
+    return std::async(std::launch::async,
+                      [this, verb = std::move(verb), url = std::move(url),
+                       body = std::move(body)]() {
+                          return send(verb, url, body);
+                      });
+}
+
+auto Transport::sendBody(const std::string &verb, const std::string &url,
+                         RequestBody &body) -> HttpResponse {
+    std::string buffered(static_cast<size_t>(body.size()), '\0');
+    size_t filled = 0;
+
+    while (filled < buffered.size()) {
+        auto len =
+            body.read(buffered.data() + filled, buffered.size() - filled);
+
+        if (len == 0) {
+            break;
+        }
+
+        filled += len;
+    }
+
+    buffered.resize(filled);
+    return send(verb, url, buffered);
+}
+
+auto Transport::sendInto(const std::string &verb, const std::string &url,
+                         const std::string &body, ResponseSink &sink)
+    -> HttpResponse {
+    auto res = send(verb, url, body);
+
+    if (res.ok()) {
+        try {
+            sink.write(res.body.data(), res.body.size());
+        } catch (const std::exception &e) {
+            failWith(res, CURLE_WRITE_ERROR, e.what());
+        }
+    }
+
+    res.body.clear();
+    return res;
+}
+
+auto Transport::defaultTransport() -> std::shared_ptr<Transport> {
+    static auto transport = std::make_shared<CurlTransport>();
+    return transport;
+}
+
+auto CurlTransport::send(const std::string &verb, const std::string &url,
+                         const std::string &body) -> HttpResponse {
+    auto &req = CurlRAII::instance();
+
+    /*
+     The verb decides the request, so a DELETE with a body is still a DELETE
+     */
+    auto res = verb == "POST" ? req.postJson(url, body)
+                              : req.request(verb, url, body);
+
+    HttpResponse result;
+    result.body = std::move(res.buffer);
+    result.code = res.response_code;
+    result.error = res.curl_perfm_res;
+    return result;
+}
+
+auto CurlTransport::sendBody(const std::string &verb, const std::string &url,
+                             RequestBody &body) -> HttpResponse {
+    curlCallBack result;
+    CURL *curl = CurlRAII::instance().easyHandle();
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+
+    if (verb != "POST") {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, verb.c_str());
+    }
+
+    /*
+     A known size is sent as Content-Length instead of chunked encoding,
+     which the drivers do not all accept
+     */
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                     static_cast<curl_off_t>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, readBody);
+    curl_easy_setopt(curl, CURLOPT_READDATA, std::addressof(body));
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, seekBody);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, std::addressof(body));
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, std::addressof(result.cb));
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, std::addressof(result));
+
+    /*
+     No "Expect: 100-continue" round trip before large bodies
+     */
+    curlslitraii_t headers;
+    CurlRAII::curl_slist_append_raii(headers, "Content-Type: application/json");
+    CurlRAII::curl_slist_append_raii(headers, "Expect:");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers.get());
+
+    result.curl_perfm_res = curl_easy_perform(curl);
+
+    HttpResponse res;
+
+    if (result.curl_perfm_res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
+                          std::addressof(result.response_code));
+    }
+
+    res.body = std::move(result.buffer);
+    res.code = result.response_code;
+    res.error = result.curl_perfm_res;
+    return res;
+}
+
+auto CurlTransport::sendInto(const std::string &verb, const std::string &url,
+                             const std::string &body, ResponseSink &sink)
+    -> HttpResponse {
+    SinkWriter writer{std::addressof(sink), {}};
+    CURL *curl = CurlRAII::instance().easyHandle();
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+
+    if (verb != "POST") {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, verb.c_str());
+    }
+
+    curlslitraii_t headers;
+
+    if (!body.empty() || verb == "POST") {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+        CurlRAII::curl_slist_append_raii(headers,
+                                         "Content-Type: application/json");
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers.get());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeSink);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, std::addressof(writer));
+
+    HttpResponse res;
+    res.error = curl_easy_perform(curl);
+
+    if (res.error == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
+                          std::addressof(res.code));
+    }
+
+    res.message = std::move(writer.error);
+    return res;
+}
+
+SocketTransport::SocketTransport(std::filesystem::path unixSocket)
+    : unixSocket(std::move(unixSocket)) {}
+
+SocketTransport::~SocketTransport() {
+    for (auto &host : idle) {
+        for (auto fd : host.second) {
+            ::close(fd);
+        }
+    }
+}
+
+auto SocketTransport::parseUrl(const std::string &url) -> Target {
+    constexpr std::string_view scheme = "http://";
+
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        throw std::invalid_argument("Only http:// URLs are supported: " + url);
+    }
+
+    Target target;
+    auto pathStart = url.find('/', scheme.size());
+
+    target.authority = url.substr(scheme.size(), pathStart - scheme.size());
+    target.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+    auto portStart = target.authority.rfind(':');
+    auto ipv6End = target.authority.rfind(']');
+
+    if (portStart != std::string::npos &&
+        (ipv6End == std::string::npos || portStart > ipv6End)) {
+        target.host = target.authority.substr(0, portStart);
+        target.port = target.authority.substr(portStart + 1);
+    } else {
+        target.host = target.authority;
+        target.port = "80";
+    }
+
+    if (target.host.size() > 1 && target.host.front() == '[') {
+        target.host = target.host.substr(1, target.host.size() - 2);
+    }
+
+    return target;
+}
+
+auto SocketTransport::connectTo(const Target &target, HttpResponse &res)
+    -> int {
+    int fd = -1;
+
+    if (!unixSocket.empty()) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+
+        const auto &path = unixSocket.native();
+
+        if (path.size() >= sizeof(addr.sun_path)) {
+            failWith(res, CURLE_COULDNT_CONNECT,
+                     "Unix socket path too long: " + path);
+            return -1;
+        }
+
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                                sizeof(addr)) != 0) {
+            failWith(res, CURLE_COULDNT_CONNECT,
+                     "Fail to connect to " + path + ": " +
+                         std::strerror(errno));
+
+            if (fd >= 0) {
+                ::close(fd);
+            }
+
+            return -1;
+        }
+    } else {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo *found = nullptr;
+        int gai = ::getaddrinfo(target.host.c_str(), target.port.c_str(),
+                                &hints, &found);
+
+        if (gai != 0) {
+            failWith(res, CURLE_COULDNT_RESOLVE_HOST,
+                     "Fail to resolve " + target.host + ": " +
+                         gai_strerror(gai));
+            return -1;
+        }
+
+        std::unique_ptr<addrinfo, AddrInfoRAII> addresses(found);
+        int lastError = 0;
+
+        for (auto *addr = addresses.get(); addr != nullptr;
+             addr = addr->ai_next) {
+            fd = ::socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC,
+                          addr->ai_protocol);
+
+            if (fd < 0) {
+                lastError = errno;
+                continue;
+            }
+
+            if (::connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+                break;
+            }
+
+            lastError = errno;
+            ::close(fd);
+            fd = -1;
+        }
+
+        if (fd < 0) {
+            failWith(res, CURLE_COULDNT_CONNECT,
+                     "Fail to connect to " + target.authority + ": " +
+                         std::strerror(lastError));
+            return -1;
+        }
+
+        int nodelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+    if (timeout.count() > 0) {
+        timeval tv{};
+        tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+        tv.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+
+    return fd;
+}
+
+auto SocketTransport::acquire(const Target &target) -> int {
+    std::lock_guard<std::mutex> lck(mtx);
+    auto it = idle.find(target.authority);
+
+    if (it == idle.end() || it->second.empty()) {
+        return -1;
+    }
+
+    int fd = it->second.back();
+    it->second.pop_back();
+    return fd;
+}
+
+void SocketTransport::release(const std::string &authority, int fd) {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        auto &connections = idle[authority];
+
+        if (connections.size() < maxIdleConnections) {
+            connections.push_back(fd);
+            return;
+        }
+    }
+
+    ::close(fd);
+}
+
+auto SocketTransport::sendAll(int fd, const char *data, size_t len,
+                              HttpResponse &res) -> bool {
+    for (size_t sent = 0; sent < len;) {
+        auto written = ::send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return failWith(res, CURLE_SEND_ERROR,
+                            std::string("Fail to send request: ") +
+                                std::strerror(errno));
+        }
+
+        sent += static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+auto SocketTransport::exchange(int fd, const std::string &request,
+                               RequestBody *stream, ResponseSink *sink,
+                               HttpResponse &res, bool &keepAlive) -> bool {
+    if (!sendAll(fd, request.data(), request.size(), res)) {
+        return false;
+    }
+
+    if (stream != nullptr) {
+        std::vector<char> buffer(65536);
+        uint64_t remaining = stream->size();
+
+        while (remaining > 0) {
+            size_t len = 0;
+
+            /*
+             Reported like the curl read callback does, the caller closes the
+             half sent request
+             */
+            try {
+                len = stream->read(buffer.data(), buffer.size());
+            } catch (const std::exception &e) {
+                return failWith(res, CURLE_READ_ERROR,
+                                std::string("Fail to read request body: ") +
+                                    e.what());
+            }
+
+            /*
+             The body must match the Content-Length already sent
+             */
+            if (len == 0 || len > remaining) {
+                return failWith(res, CURLE_READ_ERROR,
+                                "Request body size changed while sending");
+            }
+
+            if (!sendAll(fd, buffer.data(), len, res)) {
+                return false;
+            }
+
+            remaining -= len;
+        }
+    }
+
+    std::string data;
+    std::array<char, 16384> chunk{};
+    bool eof = false;
+
+    /*
+     Append the next bytes from the socket to data, false on end of stream
+     */
+    auto receive = [&]() -> bool {
+        for (;;) {
+            auto len = ::recv(fd, chunk.data(), chunk.size(), 0);
+
+            if (len > 0) {
+                data.append(chunk.data(), static_cast<size_t>(len));
+                return true;
+            }
+
+            if (len == 0) {
+                eof = true;
+                return false;
+            }
+
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+    };
+
+    size_t headerEnd = std::string::npos;
+
+    while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+        if (!receive()) {
+            if (data.empty() && eof) {
+                return failWith(res, CURLE_GOT_NOTHING,
+                                "Connection closed without response");
+            }
+
+            return failWith(res,
+                            eof ? CURLE_PARTIAL_FILE : CURLE_RECV_ERROR,
+                            "Fail to read the response headers");
+        }
+    }
+
+    std::string_view head(data.data(), headerEnd);
+    bool http10 = head.compare(0, 8, "HTTP/1.0") == 0;
+    size_t status = 0;
+
+    if (head.size() < 12 || head.compare(0, 5, "HTTP/") != 0 ||
+        !parseSize(head.substr(9, 3), 10, status)) {
+        return failWith(res, CURLE_WEIRD_SERVER_REPLY,
+                        "Invalid status line");
+    }
+
+    res.code = static_cast<long>(status);
+    keepAlive = !http10;
+
+    bool chunked = false;
+    bool hasLength = false;
+    size_t contentLength = 0;
+    bool firstLine = true;
+
+    for (auto line : Strutils::split_view(head, "\r\n")) {
+        if (firstLine) {
+            firstLine = false;
+            continue;
+        }
+
+        auto colon = line.find(':');
+
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+
+        std::string name(line.substr(0, colon));
+        std::string value(trim(line.substr(colon + 1)));
+        Strutils::to_lower(name);
+        Strutils::to_lower(value);
+
+        if (name == "content-length") {
+            hasLength = parseSize(value, 10, contentLength);
+        } else if (name == "transfer-encoding") {
+            chunked = value.find("chunked") != std::string::npos;
+        } else if (name == "connection") {
+            if (value.find("close") != std::string::npos) {
+                keepAlive = false;
+            } else if (value.find("keep-alive") != std::string::npos) {
+                keepAlive = true;
+            }
+        }
+    }
+
+    size_t pos = headerEnd + 4;
+
+    if (status == 204 || status == 304 || status < 200) {
+        return true;
+    }
+
+    auto deliver = [&](const char *bytes, size_t len) -> bool {
+        if (sink == nullptr) {
+            res.body.append(bytes, len);
+            return true;
+        }
+
+        try {
+            sink->write(bytes, len);
+            return true;
+        } catch (const std::exception &e) {
+            return failWith(res, CURLE_WRITE_ERROR, e.what());
+        }
+    };
+
+    /*
+     Pass the next count bytes on, reading more as needed. Bytes passed on
+     are dropped from data, so a large body is not held whole
+     */
+    auto forward = [&](size_t count) -> bool {
+        while (count > 0) {
+            if (pos == data.size()) {
+                data.clear();
+                pos = 0;
+
+                if (!receive()) {
+                    return failWith(res, CURLE_PARTIAL_FILE,
+                                    "Truncated response body");
+                }
+            }
+
+            size_t len = std::min(count, data.size() - pos);
+
+            if (!deliver(data.data() + pos, len)) {
+                return false;
+            }
+
+            pos += len;
+            count -= len;
+        }
+
+        return true;
+    };
+
+    if (chunked) {
+        for (;;) {
+            /*
+             Many small chunks arrive in one read, drop the ones passed on
+             */
+            if (pos >= chunk.size()) {
+                data.erase(0, pos);
+                pos = 0;
+            }
+
+            size_t lineEnd = std::string::npos;
+
+            while ((lineEnd = data.find("\r\n", pos)) == std::string::npos) {
+                if (!receive()) {
+                    return failWith(res, CURLE_PARTIAL_FILE,
+                                    "Truncated chunked response");
+                }
+            }
+
+            std::string_view sizeLine(data.data() + pos, lineEnd - pos);
+            size_t chunkSize = 0;
+
+            if (!parseSize(sizeLine.substr(0, sizeLine.find(';')), 16,
+                           chunkSize)) {
+                return failWith(res, CURLE_WEIRD_SERVER_REPLY,
+                                "Invalid chunk size");
+            }
+
+            pos = lineEnd + 2;
+
+            /*
+             The last chunk is followed by optional trailers and an empty line
+             */
+            if (chunkSize == 0) {
+                while (data.find("\r\n\r\n", lineEnd) == std::string::npos) {
+                    if (!receive()) {
+                        return failWith(res, CURLE_PARTIAL_FILE,
+                                        "Truncated chunked response");
+                    }
+                }
+
+                return true;
+            }
+
+            if (!forward(chunkSize)) {
+                return false;
+            }
+
+            while (data.size() < pos + 2) {
+                if (!receive()) {
+                    return failWith(res, CURLE_PARTIAL_FILE,
+                                    "Truncated chunked response");
+                }
+            }
+
+            pos += 2;
+        }
+    }
+
+    if (hasLength) {
+        return forward(contentLength);
+    }
+
+    /*
+     No length, the body ends with the connection
+     */
+    keepAlive = false;
+
+    do {
+        if (!deliver(data.data() + pos, data.size() - pos)) {
+            return false;
+        }
+
+        data.clear();
+        pos = 0;
+    } while (receive());
+
+    if (!eof) {
+        return failWith(res, CURLE_RECV_ERROR, "Fail to read the response");
+    }
+
+    return true;
+}
+
+auto SocketTransport::requestHead(const std::string &verb,
+                                  const Target &target, uint64_t contentLength,
+                                  bool hasBody) -> std::string {
+    std::string head;
+    head.reserve(target.path.size() + target.authority.size() + 128);
+    head += verb;
+    head += ' ';
+    head += target.path;
+    head += " HTTP/1.1\r\nHost: ";
+    head += target.authority;
+    head += "\r\n";
+
+    if (hasBody) {
+        head += "Content-Type: application/json; charset=utf-8\r\n"
+                "Content-Length: ";
+        head += std::to_string(contentLength);
+        head += "\r\n";
+    }
+
+    head += "\r\n";
+    return head;
+}
+
+auto SocketTransport::perform(const std::string &url, const std::string &verb,
+                              const std::string &body, RequestBody *stream,
+                              ResponseSink *sink) -> HttpResponse {
+    HttpResponse res;
+    Target target;
+
+    try {
+        target = parseUrl(url);
+    } catch (const std::exception &e) {
+        failWith(res, CURLE_UNSUPPORTED_PROTOCOL, e.what());
+        return res;
+    }
+
+    auto length = stream != nullptr ? stream->size() : body.size();
+    auto request = requestHead(verb, target, length,
+                               length > 0 || verb == "POST");
+
+    if (stream == nullptr) {
+        request += body;
+    }
+
+    /*
+     A pooled connection may have been closed by the server while idle, the
+     request is sent again on a new connection when nothing was received
+     */
+    for (;;) {
+        int fd = acquire(target);
+        bool reused = fd >= 0;
+
+        if (!reused) {
+            fd = connectTo(target, res);
+
+            if (fd < 0) {
+                return res;
+            }
+        }
+
+        HttpResponse attempt;
+        bool keepAlive = false;
+
+        if (!exchange(fd, request, stream, sink, attempt, keepAlive)) {
+            ::close(fd);
+
+            if (reused && (attempt.error == CURLE_SEND_ERROR ||
+                           attempt.error == CURLE_GOT_NOTHING)) {
+                try {
+                    if (stream != nullptr) {
+                        stream->rewind();
+                    }
+                } catch (const std::exception &e) {
+                    failWith(attempt, CURLE_READ_ERROR,
+                             std::string("Fail to rewind request body: ") +
+                                 e.what());
+                    return attempt;
+                }
+
+                continue;
+            }
+
+            return attempt;
+        }
+
+        if (keepAlive) {
+            release(target.authority, fd);
+        } else {
+            ::close(fd);
+        }
+
+        return attempt;
+    }
+}
+
+auto SocketTransport::send(const std::string &verb, const std::string &url,
+                           const std::string &body) -> HttpResponse {
+    return perform(url, verb, body, nullptr, nullptr);
+}
+
+auto SocketTransport::sendBody(const std::string &verb, const std::string &url,
+                               RequestBody &body) -> HttpResponse {
+    return perform(url, verb, {}, &body, nullptr);
+}
+
+auto SocketTransport::sendInto(const std::string &verb, const std::string &url,
+                               const std::string &body, ResponseSink &sink)
+    -> HttpResponse {
+    return perform(url, verb, body, nullptr, &sink);
+}
+
+MockTransport::MockTransport(handler_t handler) : handler(std::move(handler)) {}
+
+auto MockTransport::send(const std::string &verb, const std::string &url,
+                         const std::string &body) -> HttpResponse {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        requests++;
+    }
+
+    if (!handler) {
+        HttpResponse res;
+        res.code = 200;
+        res.body = R"({"value":null})";
+        return res;
+    }
+
+    return handler(verb, url, body);
+}
+
+auto MockTransport::always(HttpResponse response)
+    -> std::shared_ptr<MockTransport> {
+    return std::make_shared<MockTransport>(
+        [response = std::move(response)](const std::string &,
+                                         const std::string &,
+                                         const std::string &) {
+            return response;
+        });
+}
+
+auto MockTransport::requestCount() const -> size_t {
+    std::lock_guard<std::mutex> lck(mtx);
+    return requests;
+}
+
+RecordingTransport::RecordingTransport(
+    std::shared_ptr<Transport> inner, std::shared_ptr<TrafficRecorder> recorder)
+    : inner(std::move(inner)), recorder(std::move(recorder)) {}
+
+auto RecordingTransport::send(const std::string &verb, const std::string &url,
+                              const std::string &body) -> HttpResponse {
+    auto started = std::chrono::steady_clock::now();
+    auto res = inner->send(verb, url, body);
+    record(verb, url, body, res, started);
+    return res;
+}
+
+void RecordingTransport::record(const std::string &verb,
+                                const std::string &url,
+                                const std::string &body,
+                                const HttpResponse &res,
+                                std::chrono::steady_clock::time_point started) {
+    TrafficEntry entry;
+    entry.verb = verb;
+    entry.path = TrafficRecorder::pathOf(url);
+    entry.body = body;
+    entry.response = res.body;
+    entry.responseCode = res.code;
+    entry.transportError = static_cast<int32_t>(res.error);
+    recorder->record(std::move(entry), started);
+}
+
+auto RecordingTransport::sendBody(const std::string &verb,
+                                  const std::string &url, RequestBody &body)
+    -> HttpResponse {
+    auto started = std::chrono::steady_clock::now();
+    auto res = inner->sendBody(verb, url, body);
+    record(verb, url, {}, res, started);
+    return res;
+}
+
+auto RecordingTransport::sendInto(const std::string &verb,
+                                  const std::string &url,
+                                  const std::string &body, ResponseSink &sink)
+    -> HttpResponse {
+    TeeSink tee(sink);
+    auto started = std::chrono::steady_clock::now();
+    auto res = inner->sendInto(verb, url, body, tee);
+
+    res.body = std::move(tee.copy);
+    record(verb, url, body, res, started);
+    res.body.clear();
+    return res;
+}
+
+ReplayTransport::ReplayTransport(std::shared_ptr<TrafficReplayer> replayer)
+    : replayer(std::move(replayer)) {}
+
+auto ReplayTransport::send(const std::string &verb, const std::string &url,
+                           const std::string & /*body*/) -> HttpResponse {
+    return replay(verb, url);
+}
+
+auto ReplayTransport::sendBody(const std::string &verb, const std::string &url,
+                               RequestBody & /*body*/) -> HttpResponse {
+    return replay(verb, url);
+}
+
+auto ReplayTransport::sendInto(const std::string &verb, const std::string &url,
+                               const std::string & /*body*/,
+                               ResponseSink &sink) -> HttpResponse {
+    auto res = replay(verb, url);
+
+    if (res.ok()) {
+        try {
+            sink.write(res.body.data(), res.body.size());
+        } catch (const std::exception &e) {
+            failWith(res, CURLE_WRITE_ERROR, e.what());
+        }
+    }
+
+    res.body.clear();
+    return res;
+}
+
+auto ReplayTransport::replay(const std::string &verb, const std::string &url)
+    -> HttpResponse {
+    HttpResponse res;
+    auto entry = replayer->next(verb, url);
+
+    if (!entry) {
+        res.error = CURLE_COULDNT_CONNECT;
+        res.message = "No recorded response for " + verb + " " + url;
+        return res;
+    }
+
+    res.body = std::move(entry->response);
+    res.code = static_cast<long>(entry->responseCode);
+    res.error = static_cast<CURLcode>(entry->transportError);
+    return res;
+}
@@ -0,0 +1,86 @@
+/**
+ *@file WebDriverError.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief W3C error code mapping
+ * @version 0.1
+ *
+ *
+ */
+#include "WebDriverError.hpp"
+#include <array>
+#include <utility>
+
+namespace {
+constexpr std::array<std::pair<std::string_view, ErrorCode>, 28> errorNames = {
+    {{"detached shadow root", ErrorCode::DetachedShadowRoot},
+     {"element click intercepted", ErrorCode::ElementClickIntercepted},
+     {"element not interactable", ErrorCode::ElementNotInteractable},
+     {"insecure certificate", ErrorCode::InsecureCertificate},
+     {"invalid argument", ErrorCode::InvalidArgument},
+     {"invalid cookie domain", ErrorCode::InvalidCookieDomain},
+     {"invalid element state", ErrorCode::InvalidElementState},
+     {"invalid selector", ErrorCode::InvalidSelector},
+     {"invalid session id", ErrorCode::InvalidSessionId},
+     {"javascript error", ErrorCode::JavascriptError},
+     {"move target out of bounds", ErrorCode::MoveTargetOutOfBounds},
+     {"no such alert", ErrorCode::NoSuchAlert},
+     {"no such cookie", ErrorCode::NoSuchCookie},
+     {"no such element", ErrorCode::NoSuchElement},
+     {"no such frame", ErrorCode::NoSuchFrame},
+     {"no such shadow root", ErrorCode::NoSuchShadowRoot},
+     {"no such window", ErrorCode::NoSuchWindow},
+     {"script timeout", ErrorCode::ScriptTimeout},
+     {"session not created", ErrorCode::SessionNotCreated},
+     {"stale element reference", ErrorCode::StaleElementReference},
+     {"timeout", ErrorCode::Timeout},
+     {"unable to capture screen", ErrorCode::UnableToCaptureScreen},
+     {"unable to set cookie", ErrorCode::UnableToSetCookie},
+     {"unexpected alert open", ErrorCode::UnexpectedAlertOpen},
+     {"unknown command", ErrorCode::UnknownCommand},
+     {"unknown error", ErrorCode::UnknownError},
+     {"unknown method", ErrorCode::UnknownMethod},
+     {"unsupported operation", ErrorCode::UnsupportedOperation}}};
+} // namespace
+
+auto errorCodeFromString(std::string_view error) -> ErrorCode {
+    for (const auto &entry : errorNames) {
+        if (entry.first == error) {
+            return entry.second;
+        }
+    }
+
+    return ErrorCode::UnknownError;
+}
+
+auto errorCodeName(ErrorCode code) -> std::string_view {
+    if (code == ErrorCode::None) {
+        return "success";
+    }
+
+    if (code == ErrorCode::Transport) {
+        return {};
+    }
+
+    for (const auto &entry : errorNames) {
+        if (entry.second == code) {
+            return entry.first;
+        }
+    }
+
+    return "unknown error";
+}
+
+auto WebDriverError::describe(ErrorCode code, const std::string &message,
+                              const std::string &errorString) -> std::string {
+    if (code == ErrorCode::Transport) {
+        return "Transport error: " + message;
+    }
+
+    /*
+     The server string, an error this client does not know maps to
+     UnknownError but its name is still worth reporting
+     */
+    auto name = errorString.empty() ? std::string(errorCodeName(code))
+                                    : errorString;
+    return "Error: " + name + "\n" + message;
+}
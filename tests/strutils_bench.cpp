@@ -0,0 +1,193 @@
+/**
+ *@file strutils_bench.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Compares the vectorized Strutils with the previous implementations
+ * @version 0.1
+ *
+ *
+ */
+#include "Strutils.hpp"
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <unordered_map>
+
+namespace legacy {
+auto split(std::string_view strview, std::string_view term)
+    -> std::vector<std::string> {
+    size_t current = 0;
+    std::vector<std::string> result;
+
+    if (strview.empty()) {
+        return result;
+    }
+
+    if (term.empty()) {
+        result.emplace_back(strview);
+        return result;
+    }
+
+    do {
+        auto sep = strview.find(term, current);
+
+        result.emplace_back(strview.substr(
+            current, (sep == std::string_view::npos) ? sep : (sep - current)));
+
+        if (sep == std::string_view::npos) {
+            break;
+        }
+
+        current = sep + term.size();
+    } while (current < strview.size());
+
+    return result;
+}
+
+auto url_decode(const std::string &str) -> std::string {
+    std::string result;
+    result.reserve(str.size());
+
+    std::unordered_map<char, int> arrmap = {
+        {'0', 0},   {'1', 1},   {'2', 2},   {'3', 3},   {'4', 4},   {'5', 5},
+        {'6', 6},   {'7', 7},   {'8', 8},   {'9', 9},   {'A', 0xA}, {'B', 0xB},
+        {'C', 0xC}, {'D', 0xD}, {'E', 0xE}, {'F', 0xF},
+    };
+
+    int chrsize = 0;
+    unsigned int tempchchr = 0;
+    bool inchr = false;
+
+    for (const auto &c : str) {
+        if (chrsize == 2) {
+            result.append(1U, static_cast<char>(tempchchr));
+            inchr = false;
+            chrsize = 0;
+            tempchchr = 0;
+        }
+
+        if (c == '%') {
+            inchr = true;
+            chrsize = 0;
+            tempchchr = 0;
+            continue;
+        }
+
+        if (inchr) {
+            tempchchr |= static_cast<unsigned>(arrmap[c])
+                         << (chrsize == 0 ? 4U : 0U);
+            ++chrsize;
+        } else {
+            result.append(1U, c);
+        }
+    }
+
+    if (chrsize == 2) {
+        result.append(1U, static_cast<char>(tempchchr));
+    }
+
+    return result;
+}
+
+auto getCNPJNumbers(const std::string &cnpj) -> std::string {
+    return std::regex_replace(cnpj, std::regex("[^0-9]*"), std::string("$1"));
+}
+
+void to_upper(std::string &str) {
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) -> unsigned char {
+                       return static_cast<unsigned char>(std::toupper(c));
+                   });
+}
+} // namespace legacy
+
+namespace {
+/*
+ Keeps the optimizer from dropping the benchmarked calls
+ */
+size_t sink = 0;
+
+template <class Fn> void bench(const char *name, size_t bytes, Fn &&fn) {
+    constexpr int iterations = 200;
+    fn();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    double mbps = static_cast<double>(bytes) * iterations / elapsed / 1e6;
+    std::printf("%-28s %10.3f ms/iter %10.1f MB/s\n", name,
+                elapsed * 1000.0 / iterations, mbps);
+}
+
+auto makeText(size_t size) -> std::string {
+    std::mt19937 rng(42);
+    const std::string_view alphabet =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+    std::string text;
+    text.reserve(size);
+
+    while (text.size() < size) {
+        text.push_back(alphabet[rng() % alphabet.size()]);
+
+        if (rng() % 40 == 0) {
+            text += "\n";
+        } else if (rng() % 60 == 0) {
+            text += "%2F";
+        }
+    }
+
+    return text;
+}
+} // namespace
+
+auto main() -> int {
+    auto text = makeText(1 << 20);
+    auto cnpjs = makeText(1 << 16);
+
+    bench("legacy split", text.size(),
+          [&]() { sink += legacy::split(text, "\n").size(); });
+    bench("split", text.size(),
+          [&]() { sink += Strutils::split(text, "\n").size(); });
+    bench("split_view", text.size(), [&]() {
+        for (auto piece : Strutils::split_view(text, "\n")) {
+            sink += piece.size();
+        }
+    });
+    bench("legacy split (multi byte)", text.size(),
+          [&]() { sink += legacy::split(text, "%2F").size(); });
+    bench("split_view (multi byte)", text.size(), [&]() {
+        for (auto piece : Strutils::split_view(text, "%2F")) {
+            sink += piece.size();
+        }
+    });
+
+    bench("legacy url_decode", text.size(),
+          [&]() { sink += legacy::url_decode(text).size(); });
+    bench("url_decode", text.size(),
+          [&]() { sink += Strutils::url_decode(text).size(); });
+
+    bench("legacy getCNPJNumbers", cnpjs.size(),
+          [&]() { sink += legacy::getCNPJNumbers(cnpjs).size(); });
+    bench("getCNPJNumbers", cnpjs.size(),
+          [&]() { sink += Strutils::getCNPJNumbers(cnpjs).size(); });
+
+    bench("legacy to_upper", text.size(), [&]() {
+        auto copy = text;
+        legacy::to_upper(copy);
+        sink += copy.size();
+    });
+    bench("to_upper", text.size(), [&]() {
+        auto copy = text;
+        Strutils::to_upper(copy);
+        sink += copy.size();
+    });
+
+    std::printf("checksum %zu\n", sink);
+    return 0;
+}
@@ -1,30 +1,291 @@
+#include "ArtifactStore.hpp"
+#include "CrawlScheduler.hpp"
+#include "DriverService.hpp"
+#include "ScreenshotDiff.hpp"
+#include "SessionPool.hpp"
+#include "Strutils.hpp"
 #include "WebDriverClient.hpp"
+#include <Poco/Base64Decoder.h>
+#include <Poco/Base64Encoder.h>
+#include <Poco/Buffer.h>
+#include <Poco/Checksum.h>
+#include <Poco/DeflatingStream.h>
 #include <Poco/JSON/Array.h>
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/WebSocket.h>
+#include <Poco/StreamCopier.h>
+#include <Poco/ThreadPool.h>
+#include <atomic>
+#include <fstream>
+#include <functional>
 #include <gtest/gtest.h>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
 static const char *serverUrl = "http://localhost:8080";
 
-/*static auto startWebDriver() {
-    std::string cmd = "chromedriver --port=9515 --url-base=/wd/hub";
-    std::system(cmd.c_str());
-}*/
+/*
+ WDC_RECORD_DIR records the driver traffic of every session a test opens,
+ WDC_REPLAY_DIR serves it back so the flows run without chromedriver
+ */
+static void attachTrafficLog(WebDriver &browser) {
+    static std::unordered_map<std::string, int> sessionsPerTest;
 
-static auto initWebDriverClient() -> WebDriver {
-    WebDriver browser;
+    const auto *info = ::testing::UnitTest::GetInstance()->current_test_info();
+    if (info == nullptr) {
+        return;
+    }
+
+    std::string name =
+        std::string(info->test_suite_name()) + "." + info->name();
+    name += "-" + std::to_string(sessionsPerTest[name]++) + ".wdtl";
+
+    if (const char *dir = std::getenv("WDC_REPLAY_DIR")) {
+        auto path = std::filesystem::path(dir) / name;
+        browser.transport = std::make_shared<ReplayTransport>(
+            std::make_shared<TrafficReplayer>(path));
+    } else if (const char *dir = std::getenv("WDC_RECORD_DIR")) {
+        std::filesystem::create_directories(dir);
+        auto path = std::filesystem::path(dir) / name;
+        browser.transport = std::make_shared<RecordingTransport>(
+            browser.activeTransport(),
+            std::make_shared<TrafficRecorder>(path));
+    }
+}
 
+static auto testBrowserArgs() -> Poco::JSON::Array::Ptr {
     Poco::JSON::Array::Ptr args = new Poco::JSON::Array;
     args->add("--headless");
     args->add("--disable-gpu");
     args->add("--no-sandbox");
     args->add("--disable-dev-shm-usage");
+    return args;
+}
+
+static auto initWebDriverClient() -> WebDriver {
+    WebDriver browser;
+    attachTrafficLog(browser);
 
-    browser.connect(args);
+    browser.connect(testBrowserArgs());
 
     return browser;
 }
 
+/*
+ Sessions shared by the tests of this process, WDC_SESSION_POOL browsers at
+ most. Configure with -DTEST_SHARDS=n so ctest runs the suite in n processes
+ instead of one per test and the browsers are reused
+ */
+static std::unique_ptr<SessionPool> sharedSessions;
+
+class SessionPoolEnvironment : public ::testing::Environment {
+  public:
+    void TearDown() override { sharedSessions.reset(); }
+};
+
+[[maybe_unused]] static auto *const sessionPoolEnvironment =
+    ::testing::AddGlobalTestEnvironment(new SessionPoolEnvironment);
+
+/*
+ Session for one test, leased from the shared pool and reset when the test
+ ends. Recorded and replayed tests get their own session instead, so every
+ log holds a whole session
+ */
+class TestSession {
+  public:
+    TestSession() {
+        if (std::getenv("WDC_REPLAY_DIR") != nullptr ||
+            std::getenv("WDC_RECORD_DIR") != nullptr) {
+            owned = std::make_unique<WebDriver>();
+            attachTrafficLog(*owned);
+            owned->connect(testBrowserArgs());
+            return;
+        }
+
+        if (!sharedSessions) {
+            SessionPoolOptions options;
+            options.size = 1;
+            options.capabilities.args(testBrowserArgs()).leanHeadless();
+
+            if (const char *size = std::getenv("WDC_SESSION_POOL")) {
+                options.size = std::max(1UL, std::strtoul(size, nullptr, 10));
+            }
+
+            sharedSessions = std::make_unique<SessionPool>(options);
+        }
+
+        lease.emplace(sharedSessions->acquire());
+    }
+
+    auto operator*() -> WebDriver & { return owned ? *owned : **lease; }
+
+  private:
+    std::unique_ptr<WebDriver> owned;
+    std::optional<SessionPool::Lease> lease;
+};
+
+/*
+ Fake driver behind a MockTransport for the tests without a browser. POST
+ /session starts session "<prefix><n>", any other request goes to the first
+ route matching its verb and URL suffix and gets {"value":null} when no route
+ answers. Requests are handled one at a time, lock() guards the state the
+ routes share with the test
+ */
+class MockDriver {
+  public:
+    struct Request {
+        std::string verb;
+        std::string url;
+        std::string body;
+        /*
+         Empty outside of a session, command is the path after the id
+         */
+        std::string session;
+        std::string command;
+    };
+
+    using route_t =
+        std::function<std::optional<HttpResponse>(const Request &request)>;
+
+    explicit MockDriver(std::string prefix = "s",
+                        std::string capabilities = "{}")
+        : transport(std::make_shared<MockTransport>(
+              [this](const std::string &verb, const std::string &url,
+                     const std::string &body) {
+                  return handle(verb, url, body);
+              })),
+          prefix(std::move(prefix)), capabilities(std::move(capabilities)) {}
+
+    MockDriver(const MockDriver &) = delete;
+    auto operator=(const MockDriver &) -> MockDriver & = delete;
+
+    /*
+     An empty verb matches any, a route answering nothing passes the request
+     to the next one
+     */
+    auto on(std::string verb, std::string suffix, route_t route)
+        -> MockDriver & {
+        routes.push_back(
+            {std::move(verb), std::move(suffix), std::move(route)});
+        return *this;
+    }
+
+    auto on(std::string suffix, route_t route) -> MockDriver & {
+        return on("", std::move(suffix), std::move(route));
+    }
+
+    auto lock() -> std::unique_lock<std::mutex> {
+        return std::unique_lock<std::mutex>(mtx);
+    }
+
+    auto sessions() -> int {
+        std::lock_guard<std::mutex> lck(mtx);
+        return created;
+    }
+
+    auto lastSession() -> std::string {
+        std::lock_guard<std::mutex> lck(mtx);
+        return prefix + std::to_string(created);
+    }
+
+    static auto value(const std::string &json) -> HttpResponse {
+        HttpResponse res;
+        res.code = 200;
+        res.body = R"({"value":)" + json + "}";
+        return res;
+    }
+
+    static auto error(int code, const std::string &error,
+                      const std::string &message) -> HttpResponse {
+        HttpResponse res;
+        res.code = code;
+        res.body = R"({"value":{"error":")" + error + R"(","message":")" +
+                   message + R"(","stacktrace":""}})";
+        return res;
+    }
+
+    std::shared_ptr<MockTransport> transport;
+    /*
+     Sees every request before it is routed, session creation included
+     */
+    std::function<void(const Request &request)> onRequest;
+    /*
+     Time POST /session takes, spent outside of the lock so sessions can start
+     concurrently
+     */
+    std::chrono::milliseconds createDelay{0};
+
+  private:
+    struct Route {
+        std::string verb;
+        std::string suffix;
+        route_t handler;
+    };
+
+    auto handle(const std::string &verb, const std::string &url,
+                const std::string &body) -> HttpResponse {
+        Request request{verb, url, body, {}, {}};
+        bool creating = verb == "POST" && url.ends_with("/session");
+
+        if (auto start = url.find("/session/"); start != std::string::npos) {
+            start += 9;
+            auto end = url.find('/', start);
+            request.session = url.substr(start, end - start);
+
+            if (end != std::string::npos) {
+                request.command = url.substr(end + 1);
+            }
+        }
+
+        if (creating) {
+            std::this_thread::sleep_for(createDelay);
+        }
+
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (onRequest) {
+            onRequest(request);
+        }
+
+        if (creating) {
+            return value(R"({"sessionId":")" + prefix +
+                         std::to_string(++created) + R"(","capabilities":)" +
+                         capabilities + "}");
+        }
+
+        for (const auto &route : routes) {
+            if ((route.verb.empty() || route.verb == verb) &&
+                url.ends_with(route.suffix)) {
+                if (auto res = route.handler(request)) {
+                    return *res;
+                }
+            }
+        }
+
+        return value("null");
+    }
+
+    std::string prefix;
+    std::string capabilities;
+    std::vector<Route> routes;
+    std::mutex mtx;
+    int created{0};
+};
+
 TEST(SampleTest, Test1) {
-    WebDriver browser = initWebDriverClient();
+    TestSession session;
+    WebDriver &browser = *session;
 
     browser.get(serverUrl);
 
@@ -34,7 +295,8 @@ TEST(SampleTest, Test1) {
 }
 
 TEST(SampleTest, LocateClickMeButton) {
-    WebDriver browser = initWebDriverClient();
+    TestSession session;
+    WebDriver &browser = *session;
 
     browser.get(serverUrl);
 
@@ -45,7 +307,8 @@ TEST(SampleTest, LocateClickMeButton) {
 }
 
 TEST(SampleTest, LocateMultipleElements) {
-    WebDriver browser = initWebDriverClient();
+    TestSession session;
+    WebDriver &browser = *session;
 
     browser.get(serverUrl);
 
@@ -67,3 +330,2234 @@ TEST(SampleTest, LocateMultipleElements) {
     */
     EXPECT_EQ(arrayVal->size(), 4);
 }
+
+TEST(CookieJarTest, BinaryRoundTrip) {
+    std::vector<Cookie> cookies(2);
+    cookies[0].name = "session";
+    cookies[0].value = "abc123";
+    cookies[0].domain = "localhost";
+    cookies[0].path = "/";
+    cookies[0].httpOnly = true;
+    cookies[1].name = "pref";
+    cookies[1].value = "";
+    cookies[1].sameSite = "Lax";
+    cookies[1].expiry = 4102444800;
+    cookies[1].secure = true;
+
+    auto path = std::filesystem::temp_directory_path() / "wdc_cookies.jar";
+    CookieJar::save(path, cookies);
+    auto loaded = CookieJar::load(path);
+    std::filesystem::remove(path);
+
+    ASSERT_EQ(loaded.size(), 2);
+    EXPECT_EQ(loaded[0].name, "session");
+    EXPECT_EQ(loaded[0].value, "abc123");
+    EXPECT_EQ(loaded[0].domain, "localhost");
+    EXPECT_TRUE(loaded[0].httpOnly);
+    EXPECT_FALSE(loaded[0].expiry.has_value());
+    EXPECT_EQ(loaded[1].sameSite, "Lax");
+    EXPECT_EQ(loaded[1].expiry.value_or(0), 4102444800);
+    EXPECT_TRUE(loaded[1].secure);
+
+    EXPECT_THROW(CookieJar::deserialize("WDCJ"), std::runtime_error);
+
+    auto data = CookieJar::serialize(cookies);
+    EXPECT_EQ(data.substr(4, 6), std::string("\x01\x00\x02\x00\x00\x00", 6));
+
+    /*
+     A count the remaining bytes cannot hold is rejected before reserving
+     */
+    EXPECT_THROW(CookieJar::deserialize(
+                     std::string("WDCJ\x01\x00\xFF\xFF\xFF\xFF", 10)),
+                 std::runtime_error);
+}
+
+TEST(CookieJarTest, DisablesCdpOnlyWhenTheDriverLacksIt) {
+    std::string cdpError = "unknown error";
+    size_t added = 0;
+
+    MockDriver driver("k");
+    driver
+        .on("/goog/cdp/execute",
+            [&](const MockDriver::Request &) {
+                return MockDriver::error(500, cdpError, "cdp");
+            })
+        .on("/cookie", [&](const MockDriver::Request &) {
+            added++;
+            return MockDriver::value("null");
+        });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    std::vector<Cookie> cookies(3);
+    for (size_t i = 0; i < cookies.size(); i++) {
+        cookies[i].name = "c" + std::to_string(i);
+        cookies[i].domain = "localhost";
+    }
+
+    browser.setCookies(cookies);
+    EXPECT_EQ(added, 3);
+    EXPECT_TRUE(browser.cdpAvailable);
+
+    cdpError = "unknown command";
+    browser.setCookies(cookies);
+    EXPECT_EQ(added, 6);
+    EXPECT_FALSE(browser.cdpAvailable);
+}
+
+TEST(SampleTest, SetAndExportCookies) {
+    TestSession session;
+    WebDriver &browser = *session;
+
+    browser.get(serverUrl);
+
+    std::vector<Cookie> cookies(3);
+    for (size_t i = 0; i < cookies.size(); i++) {
+        cookies[i].name = "bulk" + std::to_string(i);
+        cookies[i].value = std::to_string(i);
+        cookies[i].domain = "localhost";
+    }
+
+    browser.setCookies(cookies);
+
+    auto exported = browser.exportCookies();
+
+    size_t found = 0;
+    for (const auto &cookie : exported) {
+        if (cookie.name.starts_with("bulk")) {
+            found++;
+        }
+    }
+
+    EXPECT_EQ(found, cookies.size());
+}
+
+/*
+Mock DevTools endpoint: every command gets a "Mock.echoed" event followed by
+its response, "Mock.fail" answers with a CDP error and "Mock.malformed" is
+preceded by a frame that is not JSON
+*/
+class MockDevToolsHandler : public Poco::Net::HTTPRequestHandler {
+  public:
+    void handleRequest(Poco::Net::HTTPServerRequest &request,
+                       Poco::Net::HTTPServerResponse &response) override {
+        Poco::Net::WebSocket ws(request, response);
+        Poco::Buffer<char> buffer(0);
+
+        while (true) {
+            int flags = 0;
+            buffer.resize(0);
+
+            auto len = ws.receiveFrame(buffer, flags);
+            if (len <= 0 || (flags & Poco::Net::WebSocket::FRAME_OP_BITMASK) ==
+                                Poco::Net::WebSocket::FRAME_OP_CLOSE) {
+                break;
+            }
+
+            auto msg = Poco::JSON::Parser()
+                           .parse(std::string(buffer.begin(), buffer.size()))
+                           .extract<Poco::JSON::Object::Ptr>();
+            auto id = std::to_string(msg->getValue<int64_t>("id"));
+            auto method = msg->getValue<std::string>("method");
+
+            if (method == "Mock.malformed") {
+                std::string garbage = R"({"method":)";
+                ws.sendFrame(garbage.data(), static_cast<int>(garbage.size()));
+            }
+
+            std::string event =
+                R"({"method":"Mock.echoed","params":{"method":")" + method +
+                R"("}})";
+            ws.sendFrame(event.data(), static_cast<int>(event.size()));
+
+            std::string reply =
+                method == "Mock.fail"
+                    ? R"({"id":)" + id +
+                          R"(,"error":{"code":-32601,"message":"fail"}})"
+                    : R"({"id":)" + id + R"(,"result":{"echo":")" + method +
+                          R"("}})";
+            ws.sendFrame(reply.data(), static_cast<int>(reply.size()));
+        }
+    }
+};
+
+class MockDevToolsFactory : public Poco::Net::HTTPRequestHandlerFactory {
+  public:
+    Poco::Net::HTTPRequestHandler *
+    createRequestHandler(const Poco::Net::HTTPServerRequest &) override {
+        return new MockDevToolsHandler;
+    }
+};
+
+TEST(DevToolsSessionTest, MultiplexesCommandsAndEvents) {
+    Poco::Net::ServerSocket socket(Poco::Net::SocketAddress("127.0.0.1", 0));
+    Poco::Net::HTTPServer server(new MockDevToolsFactory, socket,
+                                 new Poco::Net::HTTPServerParams);
+    server.start();
+
+    auto url = "ws://127.0.0.1:" + std::to_string(socket.address().port()) +
+               "/devtools/browser/mock";
+
+    {
+        DevToolsSession devtools(url);
+        std::atomic<int> events{0};
+
+        devtools.subscribe("Mock.echoed",
+                           [&events](const Poco::JSON::Object::Ptr &,
+                                     const std::string &) { events++; });
+
+        auto first = devtools.send("Mock.first");
+        auto second = devtools.send("Mock.second");
+
+        EXPECT_EQ(second.get()
+                      .extract<Poco::JSON::Object::Ptr>()
+                      ->getValue<std::string>("echo"),
+                  "Mock.second");
+        EXPECT_EQ(first.get()
+                      .extract<Poco::JSON::Object::Ptr>()
+                      ->getValue<std::string>("echo"),
+                  "Mock.first");
+        EXPECT_THROW(devtools.call("Mock.fail"), DevToolsError);
+        EXPECT_EQ(events.load(), 3);
+
+        /*
+         The reader skips a bad frame, and refuses to block on a call made
+         from its own handler
+         */
+        std::atomic<bool> refused{false};
+        devtools.subscribe("Mock.echoed",
+                           [&](const Poco::JSON::Object::Ptr &,
+                               const std::string &) {
+                               try {
+                                   devtools.call("Mock.nested");
+                               } catch (const std::logic_error &) {
+                                   refused = true;
+                               }
+                           });
+
+        EXPECT_NO_THROW(devtools.call("Mock.malformed"));
+        EXPECT_TRUE(refused.load());
+        EXPECT_EQ(events.load(), 4);
+        EXPECT_TRUE(devtools.isOpen());
+    }
+
+    server.stop();
+}
+
+TEST(ResourceBlockPolicyTest, TranslatesTypesToPatterns) {
+    ResourceBlockPolicy policy;
+    EXPECT_TRUE(policy.empty());
+
+    policy.blockFonts = true;
+    policy.urlPatterns.emplace_back("*tracker.local*");
+
+    auto patterns = policy.blockedUrlPatterns();
+    EXPECT_NE(std::find(patterns.begin(), patterns.end(), "*.woff2"),
+              patterns.end());
+    EXPECT_NE(std::find(patterns.begin(), patterns.end(), "*.woff2?*"),
+              patterns.end());
+    EXPECT_EQ(patterns.back(), "*tracker.local*");
+    EXPECT_EQ(std::find(patterns.begin(), patterns.end(), "*.png"),
+              patterns.end());
+}
+
+TEST(CapabilitiesTest, SerializesTypedOptions) {
+    Capabilities caps;
+    caps.pageLoadStrategy(PageLoadStrategy::Eager)
+        .pageLoadTimeout(15000)
+        .arg("--headless")
+        .excludeSwitch("enable-automation")
+        .pref("intl.accept_languages", "en-US")
+        .proxy("127.0.0.1:3128");
+
+    const auto &body = caps.serialize();
+    EXPECT_NE(body.find(R"("pageLoadStrategy":"eager")"), std::string::npos);
+    EXPECT_NE(body.find(R"("pageLoad":15000)"), std::string::npos);
+    EXPECT_NE(body.find("enable-automation"), std::string::npos);
+    EXPECT_NE(body.find("intl.accept_languages"), std::string::npos);
+    EXPECT_NE(body.find(R"("httpProxy":"127.0.0.1:3128")"),
+              std::string::npos);
+
+    auto copy = caps;
+    copy.arg("--disable-gpu");
+    EXPECT_EQ(caps.serialize().find("--disable-gpu"), std::string::npos);
+    EXPECT_NE(copy.serialize().find("--disable-gpu"), std::string::npos);
+}
+
+TEST(SampleTest, EagerPageLoadStrategy) {
+    Capabilities caps;
+    caps.pageLoadStrategy(PageLoadStrategy::Eager)
+        .arg("--headless")
+        .arg("--disable-gpu")
+        .arg("--no-sandbox")
+        .arg("--disable-dev-shm-usage");
+
+    WebDriver browser;
+    browser.connect(caps);
+
+    browser.get(serverUrl);
+
+    EXPECT_EQ(browser.getTitle().toString(), "Sample Test Page");
+}
+
+TEST(DriverServiceTest, SpawnsAndShardsDrivers) {
+    DriverServiceOptions options;
+    options.instances = 1;
+    options.warmSpares = 1;
+    options.maxSessionsPerDriver = 1;
+
+    DriverService service(options);
+    service.start();
+    service.start();
+    EXPECT_EQ(service.driverUrls().size(), 1);
+
+    auto first = service.acquire();
+    auto second = service.acquire();
+
+    EXPECT_NE(first, second);
+    EXPECT_TRUE(DriverService::isReady(first));
+    EXPECT_TRUE(DriverService::isReady(second));
+
+    service.release(first);
+    service.release(second);
+    service.stop();
+
+    EXPECT_FALSE(DriverService::isReady(first));
+}
+
+TEST(WebDriverErrorTest, MapsW3CErrorCodes) {
+    EXPECT_EQ(errorCodeFromString("no such element"), ErrorCode::NoSuchElement);
+    EXPECT_EQ(errorCodeFromString("stale element reference"),
+              ErrorCode::StaleElementReference);
+    EXPECT_EQ(errorCodeFromString("something new"), ErrorCode::UnknownError);
+    EXPECT_EQ(errorCodeName(ErrorCode::InvalidSessionId), "invalid session id");
+    EXPECT_EQ(errorCodeFromString("transport error"), ErrorCode::UnknownError);
+
+    WebDriverError unknown(ErrorCode::UnknownError, "detail", "something new");
+    EXPECT_STREQ(unknown.what(), "Error: something new\ndetail");
+    WebDriverError transport(ErrorCode::Transport, "Couldn't connect");
+    EXPECT_STREQ(transport.what(), "Transport error: Couldn't connect");
+
+    RetryPolicy policy;
+    policy.maxAttempts = 3;
+    EXPECT_TRUE(policy.shouldRetry("GET", ErrorCode::Transport));
+    EXPECT_FALSE(policy.shouldRetry("POST", ErrorCode::Transport));
+    EXPECT_FALSE(policy.shouldRetry("GET", ErrorCode::NoSuchElement));
+    EXPECT_LE(policy.delayFor(10), policy.maxDelay);
+
+    RetryBudget budget;
+    EXPECT_TRUE(budget.tryConsume(1));
+    EXPECT_FALSE(budget.tryConsume(1));
+}
+
+TEST(SampleTest, MissingElementWithoutException) {
+    TestSession session;
+    WebDriver &browser = *session;
+
+    browser.get(serverUrl);
+
+    auto result = browser.tryFindElement("css selector", "#does-not-exist");
+    EXPECT_FALSE(result);
+    EXPECT_EQ(result.error, ErrorCode::NoSuchElement);
+
+    EXPECT_TRUE(browser.tryFindElement("css selector", "#click-me-button"));
+
+    try {
+        browser.findElement("css selector", "#does-not-exist");
+        FAIL() << "findElement should throw";
+    } catch (const WebDriverError &e) {
+        EXPECT_EQ(e.code, ErrorCode::NoSuchElement);
+    }
+}
+
+/*
+Mock HTTP endpoint answering every request with its verb, path and body
+*/
+class MockEchoHandler : public Poco::Net::HTTPRequestHandler {
+  public:
+    void handleRequest(Poco::Net::HTTPServerRequest &request,
+                       Poco::Net::HTTPServerResponse &response) override {
+        std::string body;
+        Poco::StreamCopier::copyToString(request.stream(), body);
+
+        std::string reply = request.getMethod() + " " + request.getURI() +
+                            " " + body;
+
+        response.setContentType("text/plain");
+        response.setContentLength(static_cast<std::streamsize>(reply.size()));
+        response.send() << reply;
+    }
+};
+
+class MockEchoFactory : public Poco::Net::HTTPRequestHandlerFactory {
+  public:
+    Poco::Net::HTTPRequestHandler *
+    createRequestHandler(const Poco::Net::HTTPServerRequest &) override {
+        return new MockEchoHandler;
+    }
+};
+
+/*
+Run with -DENABLE_SANITIZERS=OFF -DENABLE_TSAN=ON to check for data races
+*/
+TEST(CurlRAIITest, ConcurrentRequestsFrom64Threads) {
+    constexpr int threadCount = 64;
+    constexpr int requestsPerThread = 50;
+
+    Poco::ThreadPool pool(2, threadCount + 8);
+    Poco::Net::ServerSocket socket(Poco::Net::SocketAddress("127.0.0.1", 0));
+    Poco::Net::HTTPServer server(new MockEchoFactory, pool, socket,
+                                 new Poco::Net::HTTPServerParams);
+    server.start();
+
+    auto baseUrl =
+        "http://127.0.0.1:" + std::to_string(socket.address().port());
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            auto &curl = CurlRAII::instance();
+
+            for (int i = 0; i < requestsPerThread; i++) {
+                auto path = "/t" + std::to_string(t) + "/" + std::to_string(i);
+                auto json = R"({"n":)" + std::to_string(i) + "}";
+
+                auto get = curl.request("GET", baseUrl + path);
+                auto post = curl.postJson(baseUrl + path, json);
+
+                if (get.curl_perfm_res != CURLE_OK ||
+                    get.buffer != "GET " + path + " " ||
+                    post.curl_perfm_res != CURLE_OK ||
+                    post.buffer != "POST " + path + " " + json) {
+                    failures++;
+                }
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    server.stop();
+
+    EXPECT_EQ(failures.load(), 0);
+}
+
+TEST(CrawlSchedulerTest, CrawlsLocalPagesAcrossSessions) {
+    WebDriver first = initWebDriverClient();
+    WebDriver second = initWebDriverClient();
+
+    std::vector<std::string> urls;
+    for (int i = 0; i < 6; i++) {
+        urls.push_back(std::string(serverUrl) + "/?page=" + std::to_string(i));
+    }
+
+    std::mutex mtx;
+    std::vector<CrawlResult> results;
+    CallbackCrawlSink sink([&](CrawlResult &&result) {
+        std::lock_guard<std::mutex> lck(mtx);
+        results.push_back(std::move(result));
+    });
+
+    CrawlOptions options;
+    options.perHostConcurrency = 2;
+
+    CrawlScheduler scheduler({&first, &second}, sink, options);
+    auto stats = scheduler.run(urls);
+
+    EXPECT_EQ(stats.pages, urls.size());
+    EXPECT_EQ(stats.failures, 0);
+    EXPECT_GT(stats.pagesPerSecond(), 0.0);
+
+    ASSERT_EQ(results.size(), urls.size());
+    for (const auto &result : results) {
+        EXPECT_TRUE(result.error.empty()) << result.error;
+        EXPECT_EQ(result.title, "Sample Test Page");
+    }
+
+    EXPECT_EQ(CrawlScheduler::hostOf("http://localhost:8080/x"), "localhost");
+}
+
+TEST(CrawlSchedulerTest, StopsAndRethrowsWhenTheSourceThrows) {
+    HttpResponse res;
+    res.code = 200;
+    res.body = R"({"value":{"sessionId":"c1","capabilities":{}}})";
+
+    WebDriver browser;
+    browser.transport = MockTransport::always(res);
+    browser.connect();
+
+    std::atomic<size_t> consumed{0};
+    CallbackCrawlSink sink([&](CrawlResult &&) { consumed++; });
+    CrawlScheduler scheduler({&browser}, sink);
+    size_t read = 0;
+
+    CrawlScheduler::UrlSource source = [&read]() -> std::optional<std::string> {
+        if (read == 3) {
+            throw std::runtime_error("URL feed closed");
+        }
+
+        return "http://host" + std::to_string(read++) + ".test/";
+    };
+
+    EXPECT_THROW(scheduler.run(source), std::runtime_error);
+    EXPECT_EQ(consumed, 3);
+    EXPECT_EQ(scheduler.stats().pages, 3);
+}
+
+TEST(DomSnapshotTest, DecodesAndQueriesSelectors) {
+    /*
+     <html><body><form id="f" class="a b"><select name="s">
+     <option value="x"></option><option value="y"></option></select></form>
+     <p class="b"></p></body></html>
+     */
+    auto encoded = Poco::JSON::Parser().parse(R"({
+        "strings": ["html", "body", "form", "id", "f", "class", "a b",
+                    "select", "name", "s", "option", "value", "x", "y",
+                    "p", "b"],
+        "tag": "0,1,2,7,10,10,14",
+        "parent": "-1,0,1,2,3,3,1",
+        "attrOffsets": "0,0,0,4,6,8,10,12",
+        "attrs": "3,4,5,6,8,9,11,12,11,13,5,15",
+        "visible": "1111101",
+        "rect": "0,0,800,600,0,0,800,600,8,8,100,20,8,8,50,20,)"
+                                              R"(0,0,0,0,0,0,0,0,8,40,100,20"
+    })");
+
+    auto snapshot = DomSnapshot::decode(encoded);
+
+    ASSERT_EQ(snapshot.size(), 7);
+    EXPECT_EQ(snapshot.tag(2), "form");
+    EXPECT_EQ(snapshot.parent(4), 3);
+    EXPECT_EQ(snapshot.parent(0), DomSnapshot::npos);
+    EXPECT_EQ(snapshot.attribute(4, "value").value_or(""), "x");
+    EXPECT_FALSE(snapshot.isVisible(5));
+    EXPECT_EQ(snapshot.rect(6).y, 40);
+
+    EXPECT_EQ(snapshot.querySelectorAll("option").size(), 2);
+    EXPECT_EQ(snapshot.querySelectorAll("#f option").size(), 2);
+    EXPECT_EQ(snapshot.querySelectorAll("form > option").size(), 0);
+    EXPECT_EQ(snapshot.querySelectorAll("select > option[value=y]"),
+              std::vector<uint32_t>{5});
+    EXPECT_EQ(snapshot.querySelectorAll(".b"),
+              (std::vector<uint32_t>{2, 6}));
+    EXPECT_EQ(snapshot.querySelectorAll("form.a.b[id='f']").size(), 1);
+    EXPECT_EQ(snapshot.querySelector("body > p").value_or(0), 6);
+    EXPECT_FALSE(snapshot.querySelector("#missing"));
+    EXPECT_FALSE(snapshot.querySelector("table"));
+    EXPECT_THROW(snapshot.querySelectorAll("form >"), std::invalid_argument);
+
+    /*
+     <svg viewBox="0 0 1 1"><linearGradient></linearGradient></svg>, SVG
+     names keep their case
+     */
+    auto svg = DomSnapshot::decode(Poco::JSON::Parser().parse(R"({
+        "strings": ["svg", "viewBox", "0 0 1 1", "linearGradient"],
+        "tag": "0,3",
+        "parent": "-1,0",
+        "attrOffsets": "0,2,2",
+        "attrs": "1,2",
+        "visible": "11",
+        "rect": "0,0,10,10,0,0,10,10"
+    })"));
+
+    EXPECT_EQ(svg.querySelectorAll("svg > linearGradient"),
+              std::vector<uint32_t>{1});
+    EXPECT_EQ(svg.querySelectorAll("SVG[viewBox='0 0 1 1']"),
+              std::vector<uint32_t>{0});
+    EXPECT_FALSE(svg.querySelector("lineargradient"));
+}
+
+TEST(SampleTest, SnapshotDom) {
+    TestSession session;
+    WebDriver &browser = *session;
+
+    browser.get(serverUrl);
+
+    auto snapshot = browser.snapshotDom();
+
+    EXPECT_EQ(snapshot.querySelectorAll("#gender > option").size(), 4);
+
+    auto button = snapshot.querySelector("#click-me-button");
+    ASSERT_TRUE(button);
+    EXPECT_TRUE(snapshot.isVisible(*button));
+    EXPECT_GT(snapshot.rect(*button).width, 0);
+
+    auto element = browser.snapshotElement(*button);
+    EXPECT_EQ(browser.getElementText(element).toString(), "Click Me");
+}
+
+TEST(StrutilsTest, VectorizedMatchesScalarResults) {
+    /*
+     Longer than one AVX2 block so the vector and the scalar tails both run
+     */
+    std::string text = "key=value;;other=Some Text With%20Escapes%2f and "
+                       "MORE text;trailing;";
+
+    auto pieces = Strutils::split(text, ";");
+    ASSERT_EQ(pieces.size(), 4);
+    EXPECT_EQ(pieces[1], "");
+    EXPECT_EQ(pieces[3], "trailing");
+
+    size_t count = 0;
+    for (auto piece : Strutils::split_view(text, "=")) {
+        EXPECT_FALSE(piece.empty());
+        count++;
+    }
+    EXPECT_EQ(count, 3);
+
+    EXPECT_EQ(Strutils::find(text, "MORE"), text.find("MORE"));
+    EXPECT_EQ(Strutils::find(text, "absent"), std::string::npos);
+
+    EXPECT_EQ(Strutils::url_decode(text).find("With Escapes/ and"),
+              text.find("With%20"));
+    EXPECT_EQ(Strutils::url_decode("100%"), "100%");
+
+    EXPECT_EQ(Strutils::getCNPJNumbers("11.222.333/0001-81 and 45.6"),
+              "11222333000181456");
+
+    auto upper = text;
+    Strutils::to_upper(upper);
+    EXPECT_EQ(upper.find("KEY=VALUE"), 0);
+    Strutils::to_lower(upper);
+    EXPECT_EQ(upper.find("more text"), text.find("MORE text"));
+
+    EXPECT_EQ(Strutils::hex_decode("48656C6C6f2C20776f726c6421").value_or(""),
+              "Hello, world!");
+    EXPECT_FALSE(Strutils::hex_decode("4x"));
+}
+
+TEST(ArtifactStoreTest, AppendsAcrossSegmentsAndReadsBack) {
+    auto dir = std::filesystem::temp_directory_path() /
+               ("wdc-artifacts-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(dir);
+
+    ArtifactStoreOptions options;
+    options.segmentSize = 64 * 1024;
+    options.compress = true;
+    options.compressMinSize = 1024;
+
+    std::string page(20000, 'x');
+    std::string small = "<html>small</html>";
+
+    {
+        ArtifactStore store(dir, options);
+
+        for (int i = 0; i < 100; i++) {
+            auto record =
+                store.append("session", "http://localhost/" + std::to_string(i),
+                             ArtifactType::PageSource, i % 2 ? page : small);
+            EXPECT_EQ(record.compressed, i % 2 == 1);
+        }
+
+        auto png = store.appendBase64("session", "http://localhost/shot",
+                                      ArtifactType::Screenshot, "iVBORw0KGgo=");
+        EXPECT_EQ(store.read(png), "\x89PNG\r\n\x1a\n");
+        store.flush();
+    }
+
+    ArtifactReader reader(dir);
+    ASSERT_EQ(reader.records().size(), 101);
+
+    const auto &first = reader.records()[0];
+    EXPECT_EQ(first.url, "http://localhost/0");
+    EXPECT_EQ(reader.view(first), small);
+    EXPECT_EQ(reader.read(reader.records()[1]), page);
+    EXPECT_LT(reader.view(reader.records()[1]).size(), page.size());
+
+    {
+        ArtifactStore store(dir, options);
+        EXPECT_EQ(store.records().size(), 101);
+        store.append("other", "http://localhost/more", ArtifactType::Other,
+                     "appended after reopening");
+    }
+
+    EXPECT_EQ(reader.refresh(), 1);
+    EXPECT_EQ(reader.read(reader.records().back()), "appended after reopening");
+
+    std::filesystem::remove_all(dir);
+}
+
+/*
+ Minimal RGBA PNG encoder for the decoder test, every scanline uses the Up
+ filter and the chunk CRCs are left as zero
+ */
+static auto encodePng(const Image &image) -> std::string {
+    auto be32 = [](std::string &out, uint32_t val) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>((val >> shift) & 0xFFU));
+        }
+    };
+
+    auto chunk = [&be32](std::string &out, const char *type,
+                         const std::string &data) {
+        be32(out, static_cast<uint32_t>(data.size()));
+        out.append(type, 4);
+        out.append(data);
+        be32(out, 0);
+    };
+
+    std::string header;
+    be32(header, image.width);
+    be32(header, image.height);
+    header.append({8, 6, 0, 0, 0});
+
+    std::ostringstream compressed;
+    {
+        Poco::DeflatingOutputStream deflater(
+            compressed, Poco::DeflatingStreamBuf::STREAM_ZLIB);
+        const size_t stride = image.width * 4ULL;
+
+        for (uint32_t y = 0; y < image.height; y++) {
+            deflater.put(2);
+            for (size_t i = 0; i < stride; i++) {
+                auto up = y == 0 ? 0 : image.row(y - 1)[i];
+                deflater.put(static_cast<char>(image.row(y)[i] - up));
+            }
+        }
+        deflater.close();
+    }
+
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    chunk(png, "IHDR", header);
+    chunk(png, "IDAT", compressed.str());
+    chunk(png, "IEND", "");
+    return png;
+}
+
+TEST(ScreenshotDiffTest, DecodesPngAndComparesTiles) {
+    Image before;
+    before.width = 200;
+    before.height = 150;
+    before.rgba.resize(200 * 150 * 4);
+
+    for (size_t i = 0; i < before.rgba.size(); i++) {
+        before.rgba[i] = static_cast<uint8_t>(i % 4 == 3 ? 255 : i * 7 % 251);
+    }
+
+    auto decoded = Image::fromPng(encodePng(before));
+    ASSERT_EQ(decoded.width, 200);
+    ASSERT_EQ(decoded.height, 150);
+    EXPECT_EQ(decoded.rgba, before.rgba);
+
+    Image after = before;
+    /*
+     A 10x10 changed block inside the tile at (64, 64) and a one step change
+     everywhere in the first row, under the tolerance
+     */
+    for (uint32_t y = 70; y < 80; y++) {
+        for (uint32_t x = 70; x < 80; x++) {
+            auto &red = after.rgba[(y * 200 + x) * 4];
+            red = static_cast<uint8_t>(red + 128);
+        }
+    }
+    for (uint32_t x = 0; x < 200; x++) {
+        after.rgba[x * 4 + 1] = static_cast<uint8_t>(after.rgba[x * 4 + 1] ^ 1);
+    }
+
+    DiffOptions options;
+    options.tileSize = 64;
+    options.threads = 4;
+
+    auto result = ScreenshotDiff::compare(before, after, options);
+    EXPECT_EQ(result.differentPixels, 100);
+    EXPECT_EQ(result.comparedPixels, 200 * 150);
+    ASSERT_EQ(result.tiles.size(), 1);
+    EXPECT_EQ(result.tiles[0].region.x, 64);
+    EXPECT_EQ(result.tiles[0].region.y, 64);
+
+    options.masks.push_back({72, 72, 100, 100});
+    auto masked = ScreenshotDiff::compare(before, after, options);
+    EXPECT_EQ(masked.differentPixels, 100 - 64);
+
+    options.masks.clear();
+    options.pixelTolerance = 0;
+    options.maxDifferentPixels = 50;
+    options.threads = 1;
+    auto stopped = ScreenshotDiff::compare(before, after, options);
+    EXPECT_TRUE(stopped.thresholdExceeded);
+    EXPECT_LT(stopped.comparedPixels, 200 * 150);
+}
+
+TEST(SampleTest, ScreenshotOfUnchangedPageIsIdentical) {
+    TestSession session;
+    WebDriver &browser = *session;
+
+    browser.get(serverUrl);
+
+    auto first = browser.screenshotImage();
+    auto second = browser.screenshotImage();
+
+    EXPECT_GT(first.width, 0);
+    EXPECT_TRUE(ScreenshotDiff::compare(first, second).identical());
+}
+
+TEST(TrafficLogTest, ReplaysRecordedSessionWithoutDriver) {
+    auto dir = std::filesystem::temp_directory_path();
+    auto recorded = dir / ("wdc-recorded-" + std::to_string(::getpid()));
+    auto rerecorded = dir / ("wdc-rerecorded-" + std::to_string(::getpid()));
+
+    {
+        TrafficRecorder recorder(recorded);
+        auto now = std::chrono::steady_clock::now();
+
+        TrafficEntry create;
+        create.verb = "POST";
+        create.path = TrafficRecorder::pathOf("http://127.0.0.1:9515/session");
+        create.response =
+            R"({"value":{"sessionId":"abc","capabilities":{}}})";
+        create.responseCode = 200;
+        recorder.record(create, now);
+
+        TrafficEntry title;
+        title.verb = "GET";
+        title.path = "/session/abc/title";
+        title.response = R"({"value":"Sample Test Page"})";
+        title.responseCode = 200;
+        recorder.record(title, now);
+
+        TrafficEntry remove;
+        remove.verb = "DELETE";
+        remove.path = "/session/abc";
+        remove.response = R"({"value":null})";
+        remove.responseCode = 200;
+        recorder.record(remove, now);
+
+        EXPECT_EQ(recorder.count(), 3);
+    }
+
+    EXPECT_EQ(TrafficRecorder::pathOf("http://localhost:9515/session/x?y=1"),
+              "/session/x?y=1");
+
+    auto replayer = std::make_shared<TrafficReplayer>(recorded);
+    ASSERT_EQ(replayer->entries().size(), 3);
+    EXPECT_EQ(replayer->entries()[0].path, "/session");
+
+    {
+        WebDriver browser;
+        browser.webDriverUrl = "http://localhost:1";
+        browser.transport = std::make_shared<RecordingTransport>(
+            std::make_shared<ReplayTransport>(replayer),
+            std::make_shared<TrafficRecorder>(rerecorded));
+
+        browser.connect();
+        EXPECT_EQ(browser.sessionId(), "abc");
+        EXPECT_EQ(browser.getTitle().toString(), "Sample Test Page");
+
+        auto missing = browser.tryCallUrlDriver(
+            "GET", browser.webDriverUrl + "/session/abc/url");
+        EXPECT_EQ(missing.error, ErrorCode::Transport);
+    }
+
+    EXPECT_EQ(replayer->remaining(), 0);
+
+    auto copy = TrafficReplayer::load(rerecorded);
+    ASSERT_EQ(copy.size(), 4);
+    EXPECT_EQ(copy[1].response, R"({"value":"Sample Test Page"})");
+    EXPECT_EQ(copy[2].transportError, CURLE_COULDNT_CONNECT);
+    EXPECT_EQ(copy[3].verb, "DELETE");
+
+    std::filesystem::remove(recorded);
+    std::filesystem::remove(rerecorded);
+}
+
+TEST(TransportTest, SocketAndCurlTransportsAgree) {
+    Poco::ThreadPool pool(2, 16);
+    Poco::Net::ServerSocket socket(Poco::Net::SocketAddress("127.0.0.1", 0));
+    Poco::Net::HTTPServer server(new MockEchoFactory, pool, socket,
+                                 new Poco::Net::HTTPServerParams);
+    server.start();
+
+    auto baseUrl =
+        "http://127.0.0.1:" + std::to_string(socket.address().port());
+
+    std::vector<std::shared_ptr<Transport>> transports{
+        std::make_shared<CurlTransport>(),
+        std::make_shared<SocketTransport>()};
+
+    for (const auto &transport : transports) {
+        auto get = transport->send("GET", baseUrl + "/status", "");
+        ASSERT_TRUE(get.ok()) << get.message;
+        EXPECT_EQ(get.code, 200);
+        EXPECT_EQ(get.body, "GET /status ");
+
+        auto post = transport->send("POST", baseUrl + "/session", "{}");
+        EXPECT_EQ(post.body, "POST /session {}");
+
+        auto remove = transport->send("DELETE", baseUrl + "/session/a", "{}");
+        EXPECT_EQ(remove.body, "DELETE /session/a {}");
+
+        auto async =
+            transport->sendAsync("GET", baseUrl + "/async", "").get();
+        EXPECT_EQ(async.body, "GET /async ");
+    }
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 20; i++) {
+                auto path = "/t" + std::to_string(t) + "/" + std::to_string(i);
+                auto res = transports[1]->send("POST", baseUrl + path, "[]");
+
+                if (!res.ok() || res.body != "POST " + path + " []") {
+                    failures++;
+                }
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures.load(), 0);
+
+    server.stop();
+
+    auto refused = transports[1]->send("GET", baseUrl + "/status", "");
+    EXPECT_FALSE(refused.ok());
+}
+
+TEST(TransportTest, WebDriverRunsOverMockTransport) {
+    MockDriver driver("m");
+    driver.on("/title", [](const MockDriver::Request &) {
+        return MockDriver::value(R"("Mocked")");
+    });
+
+    {
+        WebDriver browser;
+        browser.transport = driver.transport;
+        browser.connect();
+
+        EXPECT_EQ(browser.sessionId(), "m1");
+        EXPECT_EQ(browser.getTitle().toString(), "Mocked");
+    }
+
+    EXPECT_EQ(driver.transport->requestCount(), 3);
+}
+
+TEST(TransportTest, StreamsZippedFileUploads) {
+    auto file = std::filesystem::temp_directory_path() /
+                ("wdc-upload-" + std::to_string(::getpid()) + ".bin");
+    std::string content;
+
+    for (int i = 0; i < 200001; i++) {
+        content.push_back(static_cast<char>((i * 31) % 251));
+    }
+
+    std::ofstream(file, std::ios::binary) << content;
+
+    ZipUploadBody body(file);
+    auto name = file.filename().string();
+
+    auto readAll = [&body]() {
+        std::string out;
+        std::vector<char> chunk(7777);
+
+        while (auto len = body.read(chunk.data(), chunk.size())) {
+            out.append(chunk.data(), len);
+        }
+
+        return out;
+    };
+
+    auto sent = readAll();
+    ASSERT_EQ(sent.size(), body.size());
+    ASSERT_TRUE(sent.starts_with("{\"file\":\""));
+    ASSERT_TRUE(sent.ends_with("\"}"));
+
+    std::istringstream encoded(sent.substr(9, sent.size() - 11));
+    Poco::Base64Decoder decoder(encoded);
+    std::string zip;
+    Poco::StreamCopier::copyToString(decoder, zip);
+
+    ASSERT_EQ(zip.size(), body.zipSize());
+    EXPECT_EQ(zip.substr(0, 4), std::string("PK\x03\x04"));
+    EXPECT_EQ(zip.substr(30, name.size()), name);
+    EXPECT_EQ(zip.substr(30 + name.size(), content.size()), content);
+
+    Poco::Checksum crc(Poco::Checksum::TYPE_CRC32);
+    crc.update(content.data(), static_cast<unsigned>(content.size()));
+    EXPECT_EQ(body.crc32(), crc.checksum());
+
+    body.rewind();
+    EXPECT_EQ(readAll(), sent);
+
+    Poco::ThreadPool pool(2, 16);
+    Poco::Net::ServerSocket socket(Poco::Net::SocketAddress("127.0.0.1", 0));
+    Poco::Net::HTTPServer server(new MockEchoFactory, pool, socket,
+                                 new Poco::Net::HTTPServerParams);
+    server.start();
+
+    auto baseUrl =
+        "http://127.0.0.1:" + std::to_string(socket.address().port());
+
+    std::vector<std::shared_ptr<Transport>> transports{
+        std::make_shared<CurlTransport>(),
+        std::make_shared<SocketTransport>(),
+        std::make_shared<MockTransport>(
+            [](const std::string &verb, const std::string &url,
+               const std::string &body) {
+                HttpResponse res;
+                res.code = 200;
+                res.body = verb + " " + TrafficRecorder::pathOf(url) + " " +
+                           body;
+                return res;
+            })};
+
+    for (const auto &transport : transports) {
+        body.rewind();
+        auto res = transport->sendBody("POST", baseUrl + "/se/file", body);
+        ASSERT_TRUE(res.ok()) << res.message;
+        EXPECT_EQ(res.body, "POST /se/file " + sent);
+    }
+
+    /*
+     A body failing halfway fails the request instead of throwing
+     */
+    class FailingBody : public RequestBody {
+      public:
+        auto size() const -> uint64_t override { return 100; }
+
+        auto read(char *out, size_t len) -> size_t override {
+            if (started) {
+                throw std::runtime_error("file changed while sending");
+            }
+
+            started = true;
+            len = std::min<size_t>(len, 10);
+            std::fill_n(out, len, 'x');
+            return len;
+        }
+
+        void rewind() override { started = false; }
+
+      private:
+        bool started{false};
+    };
+
+    for (size_t i = 0; i < 2; i++) {
+        FailingBody failing;
+        auto res = transports[i]->sendBody("POST", baseUrl + "/se/file",
+                                           failing);
+        EXPECT_FALSE(res.ok());
+    }
+
+    server.stop();
+
+    std::string uploaded;
+    MockDriver driver("u");
+    driver.on("/se/file", [&uploaded](const MockDriver::Request &request) {
+        uploaded = request.body;
+        return MockDriver::value(R"("/tmp/remote/upload.bin")");
+    });
+
+    {
+        WebDriver browser;
+        browser.transport = driver.transport;
+        browser.connect();
+
+        EXPECT_EQ(browser.uploadFileStreamed(file), "/tmp/remote/upload.bin");
+        EXPECT_EQ(uploaded, sent);
+        EXPECT_THROW(browser.uploadFileStreamed(file.string() + ".missing"),
+                     std::runtime_error);
+    }
+
+    std::filesystem::remove(file);
+}
+
+/*
+ Base64 on one line, as the drivers send it
+ */
+static auto base64Of(const std::string &data) -> std::string {
+    std::ostringstream out;
+    {
+        Poco::Base64Encoder encoder(out);
+        encoder << data;
+        encoder.close();
+    }
+
+    auto encoded = out.str();
+    std::erase_if(encoded, [](char c) { return c == '\r' || c == '\n'; });
+    return encoded;
+}
+
+/*
+ Zip of one deflated file with the sizes in a data descriptor, as written by
+ the Java ZipOutputStream of Selenium
+ */
+static auto deflatedZip(const std::string &name, const std::string &content)
+    -> std::string {
+    auto le16 = [](std::string &out, uint32_t value) {
+        out.push_back(static_cast<char>(value & 0xFF));
+        out.push_back(static_cast<char>((value >> 8) & 0xFF));
+    };
+    auto le32 = [&le16](std::string &out, uint32_t value) {
+        le16(out, value & 0xFFFF);
+        le16(out, value >> 16);
+    };
+
+    std::ostringstream compressed;
+    {
+        Poco::DeflatingOutputStream deflater(compressed, -15, 9);
+        deflater << content;
+        deflater.close();
+    }
+
+    auto data = compressed.str();
+    Poco::Checksum crc(Poco::Checksum::TYPE_CRC32);
+    crc.update(content.data(), static_cast<unsigned>(content.size()));
+
+    auto entry = [&](std::string &out, bool central) {
+        le16(out, 20);
+        le16(out, 8);
+        le16(out, 8);
+        le32(out, 0);
+        le32(out, central ? crc.checksum() : 0);
+        le32(out, central ? static_cast<uint32_t>(data.size()) : 0);
+        le32(out, central ? static_cast<uint32_t>(content.size()) : 0);
+        le16(out, static_cast<uint32_t>(name.size()));
+        le16(out, 0);
+    };
+
+    std::string zip;
+    le32(zip, 0x04034b50);
+    entry(zip, false);
+    zip += name + data;
+    le32(zip, 0x08074b50);
+    le32(zip, crc.checksum());
+    le32(zip, static_cast<uint32_t>(data.size()));
+    le32(zip, static_cast<uint32_t>(content.size()));
+
+    auto directory = static_cast<uint32_t>(zip.size());
+    le32(zip, 0x02014b50);
+    le16(zip, 20);
+    entry(zip, true);
+    le16(zip, 0);
+    le16(zip, 0);
+    le16(zip, 0);
+    le32(zip, 0);
+    le32(zip, 0);
+    zip += name;
+
+    le32(zip, 0x06054b50);
+    le32(zip, 0);
+    le16(zip, 1);
+    le16(zip, 1);
+    le32(zip, static_cast<uint32_t>(zip.size()) - directory);
+    le32(zip, directory);
+    le16(zip, 0);
+    return zip;
+}
+
+TEST(TransportTest, StreamsZippedFileDownloads) {
+    std::string content;
+
+    for (int i = 0; i < 300000; i++) {
+        content += std::to_string(i % 977) + ",";
+    }
+
+    std::unordered_map<std::string, std::string> responses;
+    responses["report.csv"] = base64Of(deflatedZip("report.csv", content));
+    responses["empty.txt"] = base64Of(deflatedZip("empty.txt", ""));
+
+    auto stored = std::filesystem::temp_directory_path() /
+                  ("stored-" + std::to_string(::getpid()) + ".bin");
+    std::ofstream(stored, std::ios::binary) << content.substr(0, 100001);
+    {
+        ZipUploadBody body(stored);
+        std::string sent(body.size(), '\0');
+        sent.resize(body.read(sent.data(), sent.size()));
+        responses["stored.bin"] = sent.substr(9, sent.size() - 11);
+    }
+
+    /*
+     CRC32 of the central directory entry, before the name and end record
+     */
+    auto corrupt = deflatedZip("corrupt.csv", content);
+    corrupt[corrupt.size() - 22 - 11 - 46 + 16] ^= 1;
+    responses["corrupt.csv"] = base64Of(corrupt);
+
+    MockDriver driver("d");
+    driver
+        .on("GET", "/se/files",
+            [](const MockDriver::Request &) {
+                return MockDriver::value(
+                    R"({"names":["report.csv","empty.txt","stored.bin"]})");
+            })
+        .on("POST", "/se/files", [&responses](const MockDriver::Request &req) {
+            auto fileId = Poco::JSON::Parser()
+                              .parse(req.body)
+                              .extract<Poco::JSON::Object::Ptr>()
+                              ->getValue<std::string>("fileId");
+            auto found = responses.find(fileId);
+
+            if (found == responses.end()) {
+                return MockDriver::error(404, "unknown error", "no such file");
+            }
+
+            return MockDriver::value(R"({"filename":")" + fileId +
+                                     R"(","contents":")" + found->second +
+                                     "\"}");
+        });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    std::ostringstream report;
+    EXPECT_EQ(browser.downloadFileTo("report.csv", report), "report.csv");
+    EXPECT_EQ(report.str(), content);
+
+    auto directory = std::filesystem::temp_directory_path() /
+                     ("wdc-downloads-" + std::to_string(::getpid()));
+    std::filesystem::create_directories(directory);
+
+    auto paths = browser.downloadFilesTo(directory);
+    ASSERT_EQ(paths.size(), 3);
+    EXPECT_EQ(std::filesystem::file_size(paths[0]), content.size());
+    EXPECT_EQ(std::filesystem::file_size(paths[1]), 0);
+    EXPECT_EQ(std::filesystem::file_size(paths[2]), 100001);
+
+    std::ostringstream ignored;
+    EXPECT_THROW(browser.downloadFileTo("corrupt.csv", ignored),
+                 std::runtime_error);
+    EXPECT_THROW(browser.downloadFileTo("missing.csv", directory / "missing"),
+                 WebDriverError);
+    EXPECT_FALSE(std::filesystem::exists(directory / "missing"));
+
+    SessionPoolOptions options;
+    options.webDriverUrl = "http://localhost:1";
+    options.transport = driver.transport;
+    options.resetOnRelease = false;
+
+    std::vector<DownloadJob> jobs(3);
+    jobs[0] = {"http://pages/report", "report.csv", directory / "a.csv"};
+    jobs[1] = {"http://pages/stored", "stored.bin", directory / "b.bin"};
+    jobs[2] = {"http://pages/late", "late.csv", directory / "c.csv",
+               std::chrono::milliseconds(0)};
+
+    {
+        SessionPool pool(options);
+        auto errors = pool.downloadFiles(jobs);
+        ASSERT_EQ(errors.size(), 3);
+        EXPECT_EQ(errors[0], "");
+        EXPECT_EQ(errors[1], "");
+        EXPECT_NE(errors[2].find("late.csv"), std::string::npos);
+        EXPECT_EQ(std::filesystem::file_size(jobs[0].output), content.size());
+        EXPECT_EQ(std::filesystem::file_size(jobs[1].output), 100001);
+        EXPECT_FALSE(std::filesystem::exists(jobs[2].output));
+    }
+
+    /*
+     Streamed responses are recorded whole, so the download replays offline
+     */
+    auto log = directory / "download.wdtl";
+    {
+        WebDriver recorded;
+        recorded.transport = std::make_shared<RecordingTransport>(
+            driver.transport, std::make_shared<TrafficRecorder>(log));
+        recorded.connect();
+
+        std::ostringstream out;
+        recorded.downloadFileTo("report.csv", out);
+    }
+    {
+        WebDriver replayed;
+        replayed.webDriverUrl = "http://localhost:1";
+        replayed.transport = std::make_shared<ReplayTransport>(
+            std::make_shared<TrafficReplayer>(log));
+        replayed.connect();
+
+        std::ostringstream out;
+        EXPECT_EQ(replayed.downloadFileTo("report.csv", out), "report.csv");
+        EXPECT_EQ(out.str(), content);
+    }
+
+    std::filesystem::remove_all(directory);
+    std::filesystem::remove(stored);
+}
+
+TEST(BrowsingContextTest, SkipsSwitchesThatChangeNothing) {
+    std::vector<std::string> sent;
+
+    MockDriver driver("c");
+    driver.onRequest = [&sent](const MockDriver::Request &request) {
+        if (!request.session.empty()) {
+            sent.push_back(request.verb + " " + request.command + " " +
+                           request.body);
+        }
+    };
+    driver
+        .on("POST", "/frame",
+            [](const MockDriver::Request &request)
+                -> std::optional<HttpResponse> {
+                if (request.body.find("\"id\":9") != std::string::npos) {
+                    return MockDriver::error(404, "no such frame", "missing");
+                }
+
+                return std::nullopt;
+            })
+        .on("GET", "/window", [](const MockDriver::Request &) {
+            return MockDriver::value(R"("w1")");
+        });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    auto count = [&sent]() {
+        auto total = sent.size();
+        sent.clear();
+        return total;
+    };
+
+    browser.switchToDefaultContent();
+    browser.switchToParentFrame();
+    EXPECT_EQ(count(), 0);
+
+    browser.switchToFrame(0);
+    EXPECT_EQ(count(), 1);
+
+    browser.switchToFramePath({0, 1});
+    EXPECT_EQ(count(), 1);
+
+    browser.switchToFramePath({0, 2});
+    ASSERT_EQ(sent.size(), 2);
+    EXPECT_EQ(sent[0], "POST frame/parent {}");
+    EXPECT_EQ(count(), 2);
+
+    browser.switchToFramePath({});
+    EXPECT_EQ(count(), 1);
+    EXPECT_TRUE(browser.browsingContext.atTopLevel());
+
+    EXPECT_EQ(browser.currentWindowHandle(), "w1");
+    EXPECT_EQ(browser.currentWindowHandle(), "w1");
+    EXPECT_EQ(count(), 1);
+
+    browser.switchToWindow("w1");
+    EXPECT_EQ(count(), 0);
+
+    {
+        FrameScope frame(browser, Poco::Dynamic::Var(3));
+        EXPECT_EQ(count(), 1);
+        EXPECT_EQ(browser.browsingContext.framePath()->size(), 1);
+    }
+
+    EXPECT_EQ(count(), 1);
+    EXPECT_TRUE(browser.browsingContext.atTopLevel());
+
+    {
+        WindowScope window(browser, "w2");
+        EXPECT_EQ(browser.browsingContext.windowHandle(), "w2");
+    }
+
+    EXPECT_EQ(count(), 2);
+    EXPECT_EQ(browser.browsingContext.windowHandle(), "w1");
+
+    /*
+     A scope on the top level document returns to the frame it left
+     */
+    browser.switchToFrame(1);
+
+    {
+        FrameScope top(browser, Poco::Dynamic::Var());
+        EXPECT_TRUE(browser.browsingContext.atTopLevel());
+    }
+
+    EXPECT_EQ(count(), 3);
+    EXPECT_EQ(browser.browsingContext.framePath()->size(), 1);
+
+    browser.gotoUrl("http://localhost/other");
+    EXPECT_TRUE(browser.browsingContext.atTopLevel());
+    EXPECT_EQ(browser.checkpoint.url(), "http://localhost/other");
+    EXPECT_EQ(count(), 1);
+
+    browser.switchToFrame(0);
+    browser.get("http://localhost/");
+    browser.switchToDefaultContent();
+    EXPECT_EQ(count(), 2);
+
+    EXPECT_THROW(browser.switchToFrame(9), WebDriverError);
+    EXPECT_FALSE(browser.browsingContext.framePath());
+    count();
+
+    browser.switchToDefaultContent();
+    EXPECT_EQ(count(), 1);
+}
+
+TEST(SessionPoolTest, ReusesAndResetsSessions) {
+    std::vector<std::string> sent;
+
+    MockDriver driver;
+    driver.onRequest = [&sent](const MockDriver::Request &request) {
+        sent.push_back(request.verb + " " +
+                       request.url.substr(request.url.find("/session")) +
+                       " " + request.body);
+    };
+    driver.on("/window/handles", [](const MockDriver::Request &) {
+        return MockDriver::value(R"(["w1","w2"])");
+    });
+
+    auto countSent = [&](const std::string &prefix) {
+        auto lck = driver.lock();
+        return std::count_if(
+            sent.begin(), sent.end(),
+            [&](const std::string &req) { return req.starts_with(prefix); });
+    };
+
+    {
+        SessionPoolOptions options;
+        options.size = 2;
+        options.webDriverUrl = "http://localhost:1";
+        options.transport = driver.transport;
+
+        SessionPool pool(options);
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < 6; t++) {
+            threads.emplace_back([&pool]() {
+                auto lease = pool.acquire();
+                lease->get("http://localhost/");
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            });
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        auto stats = pool.stats();
+        EXPECT_LE(stats.created, 2);
+        EXPECT_EQ(stats.leases, 6);
+        EXPECT_EQ(countSent("POST /session "), stats.created);
+        std::string blank = R"(/url {"url":"about:blank"})";
+        EXPECT_EQ(countSent("POST /session/s1" + blank) +
+                      countSent("POST /session/s2" + blank),
+                  6);
+        EXPECT_EQ(countSent("DELETE /session/s1/window") +
+                      countSent("DELETE /session/s2/window"),
+                  6);
+
+        {
+            auto lease = pool.acquire();
+            lease.discard();
+        }
+
+        EXPECT_EQ(pool.stats().discarded, 1);
+
+        auto first = pool.acquire();
+        auto second = pool.acquire();
+        EXPECT_NE(first->sessionId(), second->sessionId());
+        EXPECT_EQ(pool.stats().created, 3);
+    }
+
+    /*
+     The discarded session and the two left in the pool are deleted
+     */
+    EXPECT_EQ(driver.sessions(), 3);
+    for (int i = 1; i <= 3; i++) {
+        EXPECT_EQ(countSent("DELETE /session/s" + std::to_string(i) + " "), 1);
+    }
+}
+
+TEST(PrintTest, StreamsPdfsWithTypedOptions) {
+    std::unordered_map<std::string, std::string> pages;
+    std::vector<std::string> printBodies;
+
+    auto pdfOf = [](const std::string &page) {
+        std::string pdf = "%PDF-1.7\n";
+
+        for (int i = 0; i < 20000; i++) {
+            pdf += page + "\n";
+        }
+
+        return pdf;
+    };
+
+    MockDriver driver("p");
+    driver
+        .on("POST", "/url",
+            [&pages](const MockDriver::Request &request)
+                -> std::optional<HttpResponse> {
+                pages[request.session] = Poco::JSON::Parser()
+                                             .parse(request.body)
+                                             .extract<Poco::JSON::Object::Ptr>()
+                                             ->getValue<std::string>("url");
+                return std::nullopt;
+            })
+        .on("/window/handles",
+            [](const MockDriver::Request &) {
+                return MockDriver::value(R"(["w1"])");
+            })
+        .on("/print", [&](const MockDriver::Request &request) {
+            printBodies.push_back(request.body);
+
+            if (pages[request.session].ends_with("broken")) {
+                return MockDriver::error(500, "unknown error", "print failed");
+            }
+
+            return MockDriver::value(
+                "\"" + base64Of(pdfOf(pages[request.session])) + "\"");
+        });
+
+    PrintOptions options;
+    options.orientation = PrintOrientation::Landscape;
+    options.scale = 0.5;
+    options.background = true;
+    options.pageWidth = 21.0;
+    options.pageHeight = 29.7;
+    options.pageRanges = {"1-2", "4"};
+    options.margins(0.5);
+
+    auto json = options.toJson();
+    EXPECT_EQ(json->getValue<std::string>("orientation"), "landscape");
+    EXPECT_DOUBLE_EQ(json->getValue<double>("scale"), 0.5);
+    EXPECT_TRUE(json->getValue<bool>("background"));
+    EXPECT_DOUBLE_EQ(json->getObject("page")->getValue<double>("height"),
+                     29.7);
+    EXPECT_DOUBLE_EQ(json->getObject("margin")->getValue<double>("left"), 0.5);
+    EXPECT_EQ(json->getArray("pageRanges")->size(), 2);
+
+    PrintOptions invalid;
+    invalid.scale = 3;
+    EXPECT_THROW(invalid.toJson(), std::invalid_argument);
+
+    {
+        WebDriver browser;
+        browser.transport = driver.transport;
+        browser.connect();
+        browser.get("http://pages/single");
+
+        std::ostringstream pdf;
+        EXPECT_EQ(browser.printPageTo(options, pdf),
+                  pdfOf("http://pages/single").size());
+        EXPECT_EQ(pdf.str(), pdfOf("http://pages/single"));
+        EXPECT_EQ(printBodies.back(), options.serialize());
+    }
+
+    auto directory = std::filesystem::temp_directory_path() /
+                     ("wdc-print-" + std::to_string(::getpid()));
+    std::filesystem::create_directories(directory);
+
+    std::vector<PrintJob> jobs;
+
+    for (int i = 0; i < 6; i++) {
+        auto page = i == 3 ? std::string("broken") : std::to_string(i);
+        jobs.push_back({"http://pages/" + page,
+                        directory / (std::to_string(i) + ".pdf"), options});
+    }
+
+    SessionPoolOptions poolOptions;
+    poolOptions.size = 2;
+    poolOptions.webDriverUrl = "http://localhost:1";
+    poolOptions.transport = driver.transport;
+
+    {
+        SessionPool pool(poolOptions);
+        auto errors = pool.printPages(jobs);
+        ASSERT_EQ(errors.size(), jobs.size());
+
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (i == 3) {
+                EXPECT_NE(errors[i].find("print failed"), std::string::npos);
+                EXPECT_FALSE(std::filesystem::exists(jobs[i].output));
+                continue;
+            }
+
+            EXPECT_EQ(errors[i], "");
+            std::ifstream printed(jobs[i].output, std::ios::binary);
+            std::stringstream content;
+            content << printed.rdbuf();
+            EXPECT_EQ(content.str(), pdfOf(jobs[i].url));
+        }
+
+        EXPECT_EQ(pool.stats().discarded, 1);
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(StartupTest, LeanCapabilitiesAndTimedPhases) {
+    Capabilities caps;
+    caps.arg("--disable-sync")
+        .arg("--headless")
+        .arg("--disable-features=Translate,Prerender2")
+        .leanHeadless()
+        .leanHeadless();
+
+    const auto &body = caps.serialize();
+    EXPECT_NE(body.find("--disable-extensions"), std::string::npos);
+    EXPECT_NE(body.find("--disable-component-update"), std::string::npos);
+    EXPECT_EQ(body.find("--disable-sync"), body.rfind("--disable-sync"));
+    EXPECT_EQ(body.find("--headless=new"), std::string::npos);
+    EXPECT_NE(body.find("--disable-features=Translate,Prerender2,MediaRouter,"
+                        "OptimizationHints\""),
+              std::string::npos);
+    EXPECT_EQ(body.find("--disable-features"),
+              body.rfind("--disable-features"));
+
+    std::vector<std::string> sent;
+
+    MockDriver driver;
+    driver.createDelay = std::chrono::milliseconds(20);
+    driver.onRequest = [&](const MockDriver::Request &request) {
+        if (request.verb == "POST" && request.url.ends_with("/session")) {
+            EXPECT_EQ(request.body, body);
+        }
+
+        sent.push_back(request.verb + " " +
+                       request.url.substr(request.url.find(":1/") + 2));
+    };
+
+    {
+        WebDriver browser;
+        browser.webDriverUrl = "http://localhost:1";
+        browser.transport = driver.transport;
+        browser.measureStartup = true;
+        browser.connectSerialized(body);
+
+        ASSERT_EQ(sent.size(), 3);
+        EXPECT_EQ(sent[0], "GET /status");
+        EXPECT_EQ(sent[1], "POST /session");
+        EXPECT_EQ(sent[2], "POST /session/s1/url");
+
+        const auto &timings = browser.startupTimings();
+        EXPECT_GE(timings.sessionCreated, std::chrono::milliseconds(20));
+        EXPECT_GE(timings.total, timings.driverReady +
+                                     timings.sessionCreated +
+                                     timings.firstNavigation);
+    }
+
+    SessionPoolOptions options;
+    options.size = 3;
+    options.webDriverUrl = "http://localhost:1";
+    options.capabilities = caps;
+    options.transport = driver.transport;
+    options.resetOnRelease = false;
+
+    SessionPool pool(options);
+
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_EQ(pool.warmUp(5), 3);
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    /*
+     The sessions start concurrently, not one after the other
+     */
+    EXPECT_LT(elapsed, std::chrono::milliseconds(20 * 3));
+    EXPECT_EQ(pool.stats().created, 3);
+    EXPECT_EQ(pool.warmUp(1), 0);
+
+    {
+        auto lease = pool.acquire();
+        EXPECT_EQ(pool.stats().created, 3);
+    }
+}
+
+TEST(ElementListTest, ParsesIdsAndPagesThroughMatches) {
+    std::string many = "{\"value\": [";
+
+    for (int i = 0; i < 10000; ++i) {
+        many += (i == 0 ? "\n  {" : ",\n  {");
+        many += "\"element-6066-11e4-a52e-4f735466cecf\" : \"f.1.e." +
+                std::to_string(i) + "\"}";
+    }
+
+    many += "\n]}";
+
+    auto list = ElementList::parse(many);
+    ASSERT_EQ(list.size(), 10000);
+    EXPECT_EQ(list.front(), "f.1.e.0");
+    EXPECT_EQ(list[1234], "f.1.e.1234");
+    EXPECT_EQ(list.back(), "f.1.e.9999");
+    EXPECT_EQ(std::distance(list.begin(), list.end()), 10000);
+    EXPECT_EQ(list.toVector()[42], "f.1.e.42");
+    EXPECT_EQ(WebDriver::getIdFromElement(list.reference(7)), "f.1.e.7");
+    EXPECT_THROW(
+        ElementList::parse(
+            R"({"value":[{"element-6066-11e4-a52e-4f735466cecf":1}]})"),
+        std::invalid_argument);
+
+    /*
+     A document with 25 matching elements, pages are cut from the script
+     arguments
+     */
+    constexpr size_t matches = 25;
+    std::vector<std::pair<size_t, size_t>> pages;
+    bool failNextScript = false;
+
+    MockDriver driver("e");
+    driver
+        .on("/session/e1/elements",
+            [&many](const MockDriver::Request &) {
+                HttpResponse res;
+                res.code = 200;
+                res.body = many;
+                return res;
+            })
+        .on("/element/missing/elements",
+            [](const MockDriver::Request &) {
+                return MockDriver::error(404, "no such element", "gone");
+            })
+        .on("/execute/sync", [&](const MockDriver::Request &request) {
+            if (failNextScript) {
+                failNextScript = false;
+                return MockDriver::error(500, "unknown error", "busy");
+            }
+
+            auto args = Poco::JSON::Parser()
+                            .parse(request.body)
+                            .extract<Poco::JSON::Object::Ptr>()
+                            ->getArray("args");
+            auto offset = args->getElement<size_t>(1);
+            auto limit = args->getElement<size_t>(2);
+            pages.emplace_back(offset, limit);
+
+            std::string value = R"({"total":)" + std::to_string(matches) +
+                                R"(,"elements":[)";
+
+            for (size_t i = offset; i < std::min(matches, offset + limit);
+                 ++i) {
+                value += (i == offset ? "" : ",");
+                value += R"({"element-6066-11e4-a52e-4f735466cecf":"p)" +
+                         std::to_string(i) + "\"}";
+            }
+
+            return MockDriver::value(value + "]}");
+        });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    auto found = browser.findElementList("css selector", "div");
+    EXPECT_EQ(found.size(), 10000);
+    EXPECT_EQ(found[9999], "f.1.e.9999");
+
+    EXPECT_TRUE(browser.findChildElementList("e", "css selector", "a").empty());
+
+    try {
+        browser.findChildElementList("missing", "css selector", "a");
+        ADD_FAILURE() << "error response accepted";
+    } catch (const WebDriverError &e) {
+        EXPECT_EQ(e.code, ErrorCode::NoSuchElement);
+    }
+
+    auto page = browser.findElementPage("li", 20, 10);
+    EXPECT_EQ(page.total, matches);
+    EXPECT_EQ(page.offset, 20);
+    ASSERT_EQ(page.elements.size(), 5);
+    EXPECT_EQ(page.elements[0], "p20");
+    EXPECT_FALSE(page.hasMore());
+
+    pages.clear();
+    ElementList all;
+    auto seen =
+        browser.forEachElementPage("li", 10, [&](const ElementPage &chunk) {
+            all.append(chunk.elements);
+        });
+
+    EXPECT_EQ(seen, matches);
+    ASSERT_EQ(all.size(), matches);
+    EXPECT_EQ(all[24], "p24");
+    EXPECT_EQ(pages, (std::vector<std::pair<size_t, size_t>>{
+                         {0, 10}, {10, 10}, {20, 10}}));
+
+    pages.clear();
+    seen = browser.forEachElementPage("li", 10, [](const ElementPage &) {
+        return false;
+    });
+    EXPECT_EQ(seen, 10);
+    EXPECT_EQ(pages.size(), 1);
+
+    /*
+     Retried like every other command
+     */
+    browser.retryPolicy.maxAttempts = 2;
+    browser.retryPolicy.idempotentOnly = false;
+    browser.retryPolicy.baseDelay = std::chrono::milliseconds(0);
+    failNextScript = true;
+    EXPECT_EQ(browser.findElementPage("li", 0, 5).elements.size(), 5);
+    EXPECT_FALSE(failNextScript);
+}
+
+TEST(SessionTimeoutsTest, SkipsRedundantUpdatesAndRestoresLazily) {
+    std::vector<std::string> sent;
+    bool refuseTimeouts = false;
+
+    MockDriver driver("t", R"({"timeouts":{"implicit":0,"pageLoad":300000,)"
+                           R"("script":30000}})");
+    driver.onRequest = [&sent](const MockDriver::Request &request) {
+        if (!request.session.empty()) {
+            sent.push_back(request.verb + " " + request.command +
+                           (request.verb == "POST" ? " " + request.body : ""));
+        }
+    };
+    driver
+        .on("/timeouts",
+            [&refuseTimeouts](const MockDriver::Request &)
+                -> std::optional<HttpResponse> {
+                if (refuseTimeouts) {
+                    return MockDriver::error(400, "invalid argument",
+                                             "refused");
+                }
+
+                return std::nullopt;
+            })
+        .on("POST", "/element", [](const MockDriver::Request &) {
+            return MockDriver::value(
+                R"({"element-6066-11e4-a52e-4f735466cecf":"e1"})");
+        });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    /*
+     The session reported its timeouts, nothing to send or ask
+     */
+    browser.setTimeouts(0, 300000, 30000);
+    auto timeouts = browser.getTimeouts().extract<Poco::JSON::Object::Ptr>();
+    EXPECT_EQ(timeouts->getValue<int>("pageLoad"), 300000);
+    EXPECT_TRUE(sent.empty());
+
+    browser.setTimeouts(500, 300000, 30000);
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0], R"(POST timeouts {"implicit":500})");
+    EXPECT_EQ(browser.implicitWait(), std::chrono::milliseconds(500));
+
+    sent.clear();
+
+    for (int i = 0; i < 5; ++i) {
+        ImplicitWaitScope noWait(browser, std::chrono::milliseconds(0));
+        browser.findElement("css selector", "#poll");
+        browser.getTitle();
+    }
+
+    ASSERT_EQ(sent.size(), 11);
+    EXPECT_EQ(sent[0], R"(POST timeouts {"implicit":0})");
+    EXPECT_EQ(std::count_if(sent.begin(), sent.end(),
+                            [](const std::string &line) {
+                                return line.starts_with("POST timeouts");
+                            }),
+              1);
+
+    /*
+     The previous wait is only sent back before the next lookup
+     */
+    sent.clear();
+    browser.getTitle();
+    EXPECT_EQ(browser.implicitWait(), std::chrono::milliseconds(500));
+    browser.findElement("css selector", "#poll");
+    ASSERT_EQ(sent.size(), 3);
+    EXPECT_EQ(sent[1], R"(POST timeouts {"implicit":500})");
+    EXPECT_TRUE(sent[2].starts_with("POST element "));
+
+    /*
+     A refused update fails the lookup and leaves the timeouts unknown
+     */
+    sent.clear();
+    refuseTimeouts = true;
+    browser.setImplicitWait(std::chrono::milliseconds(100));
+    EXPECT_THROW(browser.findElement("css selector", "#poll"), WebDriverError);
+    EXPECT_EQ(sent.size(), 1);
+
+    refuseTimeouts = false;
+    sent.clear();
+    browser.findElement("css selector", "#poll");
+    browser.setTimeouts(100, 300000, 30000);
+    ASSERT_EQ(sent.size(), 3);
+    EXPECT_EQ(sent[0], R"(POST timeouts {"implicit":100})");
+    EXPECT_EQ(sent[2], R"(POST timeouts {"pageLoad":300000,"script":30000})");
+
+    /*
+     Back to the timeouts of the session start, as between two leases of a
+     pool, the implicit wait not sent yet is dropped
+     */
+    browser.setPageLoadTimeout(std::chrono::milliseconds(5000));
+    browser.setImplicitWait(std::chrono::milliseconds(2000));
+    sent.clear();
+    browser.resetTimeouts();
+    browser.findElement("css selector", "#poll");
+    ASSERT_EQ(sent.size(), 2);
+    EXPECT_EQ(sent[0], R"(POST timeouts {"implicit":0,"pageLoad":300000})");
+    EXPECT_TRUE(sent[1].starts_with("POST element "));
+    EXPECT_EQ(browser.implicitWait(), std::chrono::milliseconds(0));
+}
+
+TEST(SessionRecoveryTest, RecreatesLostSessionsAndRestoresState) {
+    std::vector<std::string> log;
+    std::unordered_map<std::string, std::string> pages;
+    std::vector<std::string> dead;
+    std::vector<std::string> timeouts;
+    bool driverDown = false;
+
+    MockDriver driver;
+    driver.onRequest = [&log](const MockDriver::Request &request) {
+        if (!request.session.empty()) {
+            log.push_back(request.verb + " " + request.session + " " +
+                          request.command);
+        }
+    };
+    driver
+        .on("GET", "/status",
+            [&driverDown](const MockDriver::Request &) {
+                HttpResponse res;
+
+                if (driverDown) {
+                    res.error = CURLE_COULDNT_CONNECT;
+                    return res;
+                }
+
+                return MockDriver::value(R"({"ready":true})");
+            })
+        .on("",
+            [&dead](const MockDriver::Request &request)
+                -> std::optional<HttpResponse> {
+                if (request.verb == "DELETE" ||
+                    std::find(dead.begin(), dead.end(), request.session) ==
+                        dead.end()) {
+                    return std::nullopt;
+                }
+
+                return MockDriver::error(
+                    404, "invalid session id",
+                    "session deleted because of page crash");
+            })
+        .on("/url",
+            [&pages](const MockDriver::Request &request) {
+                if (request.verb == "GET") {
+                    return MockDriver::value("\"" + pages[request.session] +
+                                             "\"");
+                }
+
+                pages[request.session] = Poco::JSON::Parser()
+                                             .parse(request.body)
+                                             .extract<Poco::JSON::Object::Ptr>()
+                                             ->getValue<std::string>("url");
+                return MockDriver::value("null");
+            })
+        .on("/title",
+            [](const MockDriver::Request &request) {
+                return MockDriver::value("\"Title of " + request.session +
+                                         "\"");
+            })
+        .on("/timeouts",
+            [&timeouts](const MockDriver::Request &request) {
+                timeouts.push_back(request.session + " " + request.body);
+                return MockDriver::value("null");
+            })
+        .on("/goog/cdp/execute",
+            [](const MockDriver::Request &request)
+                -> std::optional<HttpResponse> {
+                if (request.body.find("Network.getAllCookies") !=
+                    std::string::npos) {
+                    return MockDriver::value(
+                        R"({"cookies":[{"name":"sid","value":"42",)"
+                        R"("domain":"example.test","path":"/",)"
+                        R"("session":true}]})");
+                }
+
+                if (request.body.find("Network.setCookies") !=
+                    std::string::npos) {
+                    EXPECT_NE(request.body.find("\"sid\""),
+                              std::string::npos);
+                    return MockDriver::value("{}");
+                }
+
+                return std::nullopt;
+            });
+
+    auto kill = [&](const std::string &id) {
+        auto lck = driver.lock();
+        dead.push_back(id);
+    };
+
+    std::vector<RecoveryEvent> events;
+
+    {
+        WebDriver browser;
+        browser.transport = driver.transport;
+        browser.recovery.enabled = true;
+        browser.recovery.restoreCookies = true;
+        browser.recovery.restoreUrl = true;
+        browser.recovery.retryDelay = std::chrono::milliseconds(1);
+        browser.recovery.onRecovery = [&](const RecoveryEvent &event) {
+            events.push_back(event);
+        };
+        browser.connect();
+
+        browser.get("http://example.test/cart");
+        browser.setPageLoadTimeout(std::chrono::milliseconds(12000));
+        browser.setImplicitWait(std::chrono::milliseconds(2500));
+        browser.saveCheckpoint();
+        EXPECT_EQ(browser.checkHealth(), SessionHealth::Alive);
+
+        kill("s1");
+        EXPECT_EQ(browser.checkHealth(), SessionHealth::SessionLost);
+
+        log.clear();
+        EXPECT_EQ(browser.getTitle().toString(), "Title of s2");
+
+        ASSERT_EQ(events.size(), 1);
+        EXPECT_TRUE(events[0].succeeded());
+        EXPECT_EQ(events[0].previousSessionId, "s1");
+        EXPECT_EQ(events[0].sessionId, "s2");
+        EXPECT_EQ(events[0].cookiesRestored, 1);
+        EXPECT_EQ(events[0].url, "http://example.test/cart");
+        EXPECT_TRUE(events[0].restoreError.empty());
+
+        /*
+         The failed command, the old session deleted, its timeouts and the
+         cookies set before the page loads and the command sent again. The
+         implicit wait waits for the next element lookup
+         */
+        ASSERT_EQ(log.size(), 6);
+        EXPECT_EQ(log[0], "GET s1 title");
+        EXPECT_EQ(log[1], "DELETE s1 ");
+        EXPECT_EQ(log[2], "POST s2 timeouts");
+        EXPECT_EQ(log[3], "POST s2 goog/cdp/execute");
+        EXPECT_EQ(log[4], "POST s2 url");
+        EXPECT_EQ(log[5], "GET s2 title");
+        EXPECT_EQ(pages["s2"], "http://example.test/cart");
+        ASSERT_EQ(timeouts.size(), 2);
+        EXPECT_EQ(timeouts[1], R"(s2 {"pageLoad":12000})");
+        EXPECT_EQ(browser.implicitWait(), std::chrono::milliseconds(2500));
+
+        driverDown = true;
+        EXPECT_EQ(browser.checkHealth(), SessionHealth::DriverDown);
+        driverDown = false;
+
+        /*
+         Without recovery the error reaches the caller
+         */
+        browser.recovery.enabled = false;
+        kill("s2");
+
+        try {
+            browser.getTitle();
+            ADD_FAILURE() << "lost session answered";
+        } catch (const WebDriverError &e) {
+            EXPECT_EQ(e.code, ErrorCode::InvalidSessionId);
+        }
+
+        EXPECT_EQ(events.size(), 1);
+    }
+
+    SessionPoolOptions options;
+    options.size = 2;
+    options.webDriverUrl = "http://localhost:1";
+    options.transport = driver.transport;
+    options.resetOnRelease = false;
+    options.recovery.enabled = true;
+    options.recovery.retryDelay = std::chrono::milliseconds(1);
+    SessionPool *checkedPool = nullptr;
+    std::string leasedDuringRecovery;
+    options.recovery.onRecovery = [&](const RecoveryEvent &event) {
+        events.push_back(event);
+
+        /*
+         The session being checked is the only one out of the pool
+         */
+        if (checkedPool != nullptr) {
+            leasedDuringRecovery = checkedPool->acquire()->sessionId();
+        }
+    };
+
+    {
+        SessionPool pool(options);
+        EXPECT_EQ(pool.warmUp(2), 2);
+
+        auto killed = driver.lastSession();
+        kill(killed);
+        checkedPool = &pool;
+        EXPECT_EQ(pool.checkIdleSessions(), 1);
+        checkedPool = nullptr;
+        EXPECT_EQ(pool.checkIdleSessions(), 0);
+        EXPECT_FALSE(leasedDuringRecovery.empty());
+        EXPECT_NE(leasedDuringRecovery, killed);
+
+        auto stats = pool.stats();
+        EXPECT_EQ(stats.lost, 1);
+        EXPECT_EQ(stats.recovered, 1);
+        EXPECT_EQ(stats.discarded, 0);
+        ASSERT_EQ(events.size(), 2);
+        EXPECT_EQ(events[1].sessionId, driver.lastSession());
+    }
+
+    /*
+     Lost sessions are quit when recovery is off, the background checks find
+     them without any call
+     */
+    options.recovery.enabled = false;
+    options.healthCheckInterval = std::chrono::milliseconds(5);
+
+    {
+        SessionPool pool(options);
+        EXPECT_EQ(pool.warmUp(1), 1);
+        kill(driver.lastSession());
+
+        auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+        while (pool.stats().discarded == 0 &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        EXPECT_EQ(pool.stats().lost, 1);
+        EXPECT_EQ(pool.stats().discarded, 1);
+
+        auto lease = pool.acquire();
+        EXPECT_EQ(lease->sessionId(), driver.lastSession());
+        EXPECT_EQ(pool.stats().created, 2);
+    }
+}
+
+TEST(DeepQueryTest, ResolvesShadowChainsInOneScriptCall) {
+    auto parts = WebDriver::splitDeepSelector(
+        "app-shell >>> nav-menu>>>\n button.open[data-x='>'] ");
+    ASSERT_EQ(parts.size(), 3);
+    EXPECT_EQ(parts[0], "app-shell");
+    EXPECT_EQ(parts[1], "nav-menu");
+    EXPECT_EQ(parts[2], "button.open[data-x='>']");
+    EXPECT_THROW(WebDriver::splitDeepSelector("a >>>  >>> b"),
+                 std::invalid_argument);
+
+    const std::string elementKey = "element-6066-11e4-a52e-4f735466cecf";
+    std::string scriptValue;
+    std::vector<std::string> sent;
+
+    MockDriver driver("d");
+    driver.onRequest = [&sent](const MockDriver::Request &request) {
+        if (!request.session.empty()) {
+            sent.push_back(request.verb + " " + request.command);
+        }
+    };
+    driver
+        .on("/execute/sync",
+            [&scriptValue](const MockDriver::Request &request) {
+                auto args = Poco::JSON::Parser()
+                                .parse(request.body)
+                                .extract<Poco::JSON::Object::Ptr>()
+                                ->getArray("args");
+                EXPECT_EQ(args->getArray(0)->size(), 2);
+                return MockDriver::value(scriptValue);
+            })
+        .on("/d1/elements",
+            [&elementKey](const MockDriver::Request &) {
+                return MockDriver::value(R"([{")" + elementKey +
+                                         R"(":"h1"},{")" + elementKey +
+                                         R"(":"h2"}])");
+            })
+        .on("/element/h1/shadow",
+            [](const MockDriver::Request &) {
+                return MockDriver::error(404, "no such shadow root", "none");
+            })
+        .on("/element/h2/shadow",
+            [](const MockDriver::Request &) {
+                return MockDriver::value(
+                    R"({"shadow-6066-11e4-a52e-4f735466cecf":"r2"})");
+            })
+        .on("/shadow/r2/elements", [&elementKey](const MockDriver::Request &) {
+            return MockDriver::value(R"([{")" + elementKey + R"(":"in2"}])");
+        });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    /*
+     Open shadow roots: the whole chain in one request
+     */
+    scriptValue = R"([{")" + elementKey + R"(":"b1"},{")" + elementKey +
+                  R"(":"b2"}])";
+    auto found = browser.findDeepElements("my-app >>> button");
+    ASSERT_EQ(found.size(), 2);
+    EXPECT_EQ(found[1], "b2");
+    EXPECT_EQ(WebDriver::getIdFromElement(
+                  browser.findDeepElement("my-app >>> button")),
+              "b1");
+    EXPECT_EQ(sent.size(), 2);
+
+    scriptValue = "[]";
+    EXPECT_THROW(browser.findDeepElement("my-app >>> a"), WebDriverError);
+
+    /*
+     A closed shadow root on the way: each level through the endpoints
+     */
+    sent.clear();
+    scriptValue = "null";
+    auto element = browser.findDeepElement("closed-host >>> input");
+    EXPECT_EQ(WebDriver::getIdFromElement(element), "in2");
+    EXPECT_EQ(sent, (std::vector<std::string>{
+                        "POST execute/sync", "POST elements",
+                        "GET element/h1/shadow", "GET element/h2/shadow",
+                        "POST shadow/r2/elements"}));
+}
+
+TEST(PageTextTest, DecodesCompactTextBlocks) {
+    auto page = PageText::fromResponse(
+        R"({ "value" : "1,-3,100,20,13:Hello wörld!)"
+        R"(0,0,10,10,13:para 😀 \"q\"" })");
+    ASSERT_EQ(page.size(), 2);
+    EXPECT_EQ(page.text(0), "Hello w\xC3\xB6rld!");
+    EXPECT_EQ(page.text(1), "para \xF0\x9F\x98\x80 \"q\"");
+    EXPECT_EQ(page.rect(0).y, -3);
+    EXPECT_EQ(page.rect(0).width, 100);
+    EXPECT_EQ(page.joined(" | "),
+              "Hello w\xC3\xB6rld! | para \xF0\x9F\x98\x80 \"q\"");
+    EXPECT_TRUE(PageText::fromResponse(R"({"value":null})").empty());
+    EXPECT_TRUE(PageText::fromResponse(R"({"value":""})").empty());
+    EXPECT_THROW(PageText::decode("0,0,1,1,9:short"), std::runtime_error);
+    EXPECT_THROW(PageText::decode("0,0,1:x"), std::runtime_error);
+
+    std::string scriptValue;
+    MockDriver driver("t");
+    driver.on("/execute/sync",
+              [&scriptValue](const MockDriver::Request &request) {
+                  auto args = Poco::JSON::Parser()
+                                  .parse(request.body)
+                                  .extract<Poco::JSON::Object::Ptr>()
+                                  ->getArray("args");
+                  EXPECT_EQ(args->getElement<std::string>(0), "main");
+                  EXPECT_TRUE(args->getElement<bool>(1));
+                  EXPECT_EQ(args->getElement<uint32_t>(3), 5);
+
+                  if (scriptValue.empty()) {
+                      return MockDriver::error(500, "javascript error",
+                                               "boom");
+                  }
+
+                  return MockDriver::value("\"" + scriptValue + "\"");
+              });
+
+    WebDriver browser;
+    browser.transport = driver.transport;
+    browser.connect();
+
+    TextExtractionOptions options;
+    options.root = "main";
+    options.viewportOnly = true;
+    options.maxBlocks = 5;
+
+    scriptValue = "4,8,60,12,5:Title";
+    auto text = browser.extractText(options);
+    ASSERT_EQ(text.size(), 1);
+    EXPECT_EQ(text.text(0), "Title");
+    EXPECT_EQ(text.rect(0).x, 4);
+
+    scriptValue = "4,8,60,12,50:Title";
+    EXPECT_THROW(browser.extractText(options), WebDriverError);
+
+    scriptValue.clear();
+    EXPECT_THROW(browser.extractText(options), WebDriverError);
+}
@@ -0,0 +1,224 @@
+/**
+ *@file transport_bench.cpp
+ * @author Fabio Rossini Sluzala ()
+ * @brief Compares the request latency of the WebDriver transports
+ * @version 0.1
+ *
+ * Usage: transport_bench [requests] [driver url]
+ *
+ * Without a driver URL the requests go to an in-process keep-alive HTTP
+ * server over TCP loopback and a Unix socket, answering like chromedriver
+ * does to GET /status. With a URL, e.g. http://localhost:9515, the curl and
+ * socket transports are measured against the real driver as well.
+ */
+#include "Transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr std::string_view statusJson =
+    R"({"value":{"build":{"version":"bench"},"message":"ChromeDriver ready )"
+    R"(for new sessions.","os":{"arch":"x86_64","name":"Linux"},)"
+    R"("ready":true}})";
+
+/*
+ Answers every request on a connection until the client closes it, bodies
+ are read by Content-Length
+ */
+void serveConnection(int fd) {
+    std::string data;
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json"
+                           "; charset=utf-8\r\nContent-Length: " +
+                           std::to_string(statusJson.size()) + "\r\n\r\n" +
+                           std::string(statusJson);
+    char chunk[16384];
+
+    for (;;) {
+        auto headerEnd = data.find("\r\n\r\n");
+
+        if (headerEnd == std::string::npos) {
+            auto len = ::recv(fd, chunk, sizeof(chunk), 0);
+
+            if (len <= 0) {
+                break;
+            }
+
+            data.append(chunk, static_cast<size_t>(len));
+            continue;
+        }
+
+        size_t bodyLength = 0;
+        auto lengthPos = data.find("Content-Length: ");
+
+        if (lengthPos != std::string::npos && lengthPos < headerEnd) {
+            bodyLength = std::strtoul(data.c_str() + lengthPos + 16, nullptr,
+                                      10);
+        }
+
+        auto requestEnd = headerEnd + 4 + bodyLength;
+
+        if (data.size() < requestEnd) {
+            auto len = ::recv(fd, chunk, sizeof(chunk), 0);
+
+            if (len <= 0) {
+                break;
+            }
+
+            data.append(chunk, static_cast<size_t>(len));
+            continue;
+        }
+
+        data.erase(0, requestEnd);
+
+        if (::send(fd, response.data(), response.size(), MSG_NOSIGNAL) < 0) {
+            break;
+        }
+    }
+
+    ::close(fd);
+}
+
+class BenchServer {
+  public:
+    BenchServer(int family, const sockaddr *addr, socklen_t addrlen)
+        : listenFd(::socket(family, SOCK_STREAM, 0)) {
+        int reuse = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                     sizeof(reuse));
+
+        if (::bind(listenFd, addr, addrlen) != 0 ||
+            ::listen(listenFd, 64) != 0) {
+            std::perror("Fail to start the bench server");
+            std::exit(EXIT_FAILURE);
+        }
+
+        acceptor = std::thread([this]() {
+            for (;;) {
+                int fd = ::accept(listenFd, nullptr, nullptr);
+
+                if (fd < 0) {
+                    break;
+                }
+
+                std::thread(serveConnection, fd).detach();
+            }
+        });
+    }
+
+    ~BenchServer() {
+        ::shutdown(listenFd, SHUT_RDWR);
+        ::close(listenFd);
+        acceptor.join();
+    }
+
+    BenchServer(const BenchServer &) = delete;
+    auto operator=(const BenchServer &) -> BenchServer & = delete;
+
+    auto port() const -> int {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+  private:
+    int listenFd;
+    std::thread acceptor;
+};
+
+void bench(const char *name, Transport &transport, const std::string &url,
+           size_t requests) {
+    /*
+     Warm up, so connection setup is not measured
+     */
+    for (size_t i = 0; i < 16; i++) {
+        transport.send("GET", url, "");
+    }
+
+    size_t failures = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < requests; i++) {
+        auto res = transport.send(i % 2 == 0 ? "GET" : "POST", url,
+                                  i % 2 == 0 ? "" : "{}");
+
+        if (!res.ok() || res.code != 200) {
+            failures++;
+        }
+    }
+
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::printf("%-28s %10.2f us/request %10.0f requests/s %zu failures\n",
+                name, elapsed.count() / static_cast<double>(requests),
+                static_cast<double>(requests) * 1e6 / elapsed.count(),
+                failures);
+}
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    size_t requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+
+    sockaddr_in tcpAddr{};
+    tcpAddr.sin_family = AF_INET;
+    tcpAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    BenchServer tcpServer(AF_INET, reinterpret_cast<sockaddr *>(&tcpAddr),
+                          sizeof(tcpAddr));
+
+    auto socketPath = "/tmp/transport_bench-" + std::to_string(::getpid());
+    sockaddr_un unixAddr{};
+    unixAddr.sun_family = AF_UNIX;
+    std::strncpy(unixAddr.sun_path, socketPath.c_str(),
+                 sizeof(unixAddr.sun_path) - 1);
+    BenchServer unixServer(AF_UNIX, reinterpret_cast<sockaddr *>(&unixAddr),
+                           sizeof(unixAddr));
+
+    auto url = "http://127.0.0.1:" + std::to_string(tcpServer.port()) +
+               "/status";
+
+    CurlTransport curl;
+    SocketTransport tcp;
+    SocketTransport unixSocket(socketPath);
+
+    HttpResponse canned;
+    canned.code = 200;
+    canned.body = statusJson;
+    auto mock = MockTransport::always(canned);
+
+    std::vector<TrafficEntry> log(requests + 16);
+
+    for (size_t i = 0; i < log.size(); i++) {
+        log[i].verb = i < 16 || i % 2 == 0 ? "GET" : "POST";
+        log[i].path = "/status";
+        log[i].response = statusJson;
+        log[i].responseCode = 200;
+    }
+
+    ReplayTransport replay(std::make_shared<TrafficReplayer>(std::move(log)));
+
+    bench("curl (tcp loopback)", curl, url, requests);
+    bench("socket (tcp loopback)", tcp, url, requests);
+    bench("socket (unix)", unixSocket, "http://localhost/status", requests);
+    bench("mock (in memory)", *mock, url, requests);
+    bench("replay (in memory)", replay, url, requests);
+
+    if (argc > 2) {
+        std::string driverUrl = std::string(argv[2]) + "/status";
+        bench("curl (driver)", curl, driverUrl, requests);
+        bench("socket (driver)", tcp, driverUrl, requests);
+    }
+
+    ::unlink(socketPath.c_str());
+    return 0;
+}